@@ -136,6 +136,8 @@
 #define KRB5_DB_ITER_WRITE      0x00000001
 #define KRB5_DB_ITER_REV        0x00000002
 #define KRB5_DB_ITER_RECURSE    0x00000004
+#define KRB5_DB_ITER_NAMES_ONLY 0x00000008
+#define KRB5_DB_ITER_PREFIX     0x00000010
 
 /* String attribute names recognized by krb5 */
 #define KRB5_KDB_SK_SESSION_ENCTYPES            "session_enctypes"
@@ -1072,8 +1074,15 @@ typedef struct _kdb_vftabl {
     /*
      * Optional: For each principal entry in the database, invoke func with the
      * argments func_arg and the entry data.  If match_entry is specified, the
-     * module may narrow the iteration to principal names matching that regular
-     * expression; a module may alternatively ignore match_entry.
+     * module may narrow the iteration to principal names matching that
+     * shell-style glob; a module may alternatively ignore match_entry, or pass
+     * a superset of the matching entries, so the caller must still filter
+     * the results.  If iterflags contains KRB5_DB_ITER_NAMES_ONLY, the module
+     * may set only the princ field of the entries passed to func.  If
+     * iterflags contains KRB5_DB_ITER_PREFIX, the caller relies on the module
+     * to narrow the iteration using the literal prefix of match_entry; a
+     * module which would visit every entry must return KRB5_PLUGIN_OP_NOTSUPP
+     * instead.
      */
     krb5_error_code (*iterate)(krb5_context kcontext,
                                char *match_entry,
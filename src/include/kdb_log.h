@@ -20,15 +20,25 @@ extern "C" {
 
 /*
  * DB macros
+ *
+ * The header is followed by an index of ulogentries file offsets, one per
+ * serial number slot, and then by the data area holding variable-length
+ * update records.
  */
+#define ULOG_RECALIGN   8
+#define ULOG_ROUNDUP(n) (((n) + ULOG_RECALIGN - 1) & ~(ULOG_RECALIGN - 1))
+#define ULOG_OFFSETS(ulog) ((uint32_t *)((char *)(ulog) +                \
+                                         ULOG_ROUNDUP(sizeof(kdb_hlog_t))))
 #define INDEX(ulog, i) (kdb_ent_header_t *)((char *)(ulog) +            \
-                                            sizeof(kdb_hlog_t) +        \
-                                            (i) * ulog->kdb_block)
+                                            ULOG_OFFSETS(ulog)[i])
+#define ULOG_DATA_OFFSET(ulogentries)                                   \
+    (ULOG_ROUNDUP(sizeof(kdb_hlog_t)) +                                 \
+     ULOG_ROUNDUP((ulogentries) * sizeof(uint32_t)))
 
 /*
  * Current DB version #
  */
-#define KDB_VERSION     1
+#define KDB_VERSION     2
 
 /*
  * DB log states
@@ -49,13 +59,22 @@ extern "C" {
 #define DEF_ULOGENTRIES 1000
 #define ULOG_IDLE_TIME  10              /* in seconds */
 /*
- * Max size of update entry + update header
- * We make this large since resizing can be costly.
+ * Data area space budgeted per log entry when the log is created.  Update
+ * records are stored at their actual size, so this only bounds how much
+ * history fits when updates are unusually large.
  */
-#define ULOG_BLOCK      2048            /* Default size of principal record */
+#define ULOG_BLOCK      2048
 
 #define MAXLOGLEN       0x10000000      /* 256 MB log file */
 
+/*
+ * Update notification datagram sent by kadmind to the kprop port of
+ * subscribed slaves: a four-byte magic number followed by the new last
+ * serial number, both big-endian.
+ */
+#define IPROP_NOTIFY_MAGIC      0x6663434
+#define IPROP_NOTIFY_LEN        8
+
 /*
  * Prototype declarations
  */
@@ -75,10 +94,16 @@ void ulog_free_entries(kdb_incr_update_t *updates, int no_of_updates);
 krb5_error_code ulog_set_role(krb5_context ctx, iprop_role role);
 update_status_t ulog_get_sno_status(krb5_context context,
                                     const kdb_last_t *last);
+krb5_error_code ulog_get_first(krb5_context context, kdb_last_t *first_out);
 krb5_error_code ulog_get_last(krb5_context context, kdb_last_t *last_out);
 krb5_error_code ulog_set_last(krb5_context context, const kdb_last_t *last);
 void ulog_fini(krb5_context context);
 
+typedef void (*ulog_notify_fn)(krb5_context context, kdb_sno_t sno,
+                               void *data);
+krb5_error_code ulog_set_notify(krb5_context context, ulog_notify_fn fn,
+                                void *data);
+
 typedef struct kdb_hlog {
     uint32_t        kdb_hmagic;     /* Log header magic # */
     uint16_t        db_version_num; /* Kerberos database version no. */
@@ -88,7 +113,8 @@ typedef struct kdb_hlog {
     kdb_sno_t       kdb_first_sno;  /* First serial # in the update log */
     kdb_sno_t       kdb_last_sno;   /* Last serial # in the update log */
     uint16_t        kdb_state;      /* State of update log */
-    uint16_t        kdb_block;      /* Block size of each element */
+    uint32_t        kdb_data_off;   /* File offset of the data area */
+    uint32_t        kdb_data_size;  /* Size of the data area */
 } kdb_hlog_t;
 
 typedef struct kdb_ent_header {
@@ -105,6 +131,8 @@ typedef struct _kdb_log_context {
     kdb_hlog_t      *ulog;
     uint32_t        ulogentries;
     int             ulogfd;
+    ulog_notify_fn  notify;         /* Called after each committed update */
+    void            *notify_data;
 } kdb_log_context;
 
 #ifdef  __cplusplus
@@ -73,6 +73,15 @@ krb5_error_code loop_setup_signals(verto_ctx *ctx, void *handle,
                                    void (*reset)());
 void loop_free(verto_ctx *ctx);
 
+/*
+ * Set a function to be called with the descriptor of an RPC connection before
+ * the loop reads another request from it or closes it.  RPC transports hold
+ * the state of one call at a time, so a server which sends some RPC replies
+ * after its dispatch function returns must send any reply still pending on the
+ * connection at this point.
+ */
+void loop_set_rpc_flush(void (*flush)(int fd));
+
 /* to be supplied by the server application */
 
 /*
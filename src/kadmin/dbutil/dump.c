@@ -29,11 +29,14 @@
  */
 
 #include <k5-int.h>
+#include <k5-input.h>
 #include <kadm5/admin.h>
 #include <kadm5/server_internal.h>
 #include <kdb.h>
 #include <com_err.h>
 #include "kdb5_util.h"
+#include <poll.h>
+#include <sys/wait.h>
 #if defined(HAVE_REGEX_H) && defined(HAVE_REGCOMP)
 #include <regex.h>
 #endif  /* HAVE_REGEX_H */
@@ -43,6 +46,25 @@ static krb5_boolean mkey_convert;
 krb5_keyblock new_master_keyblock;
 krb5_kvno new_mkvno;
 
+/*
+ * During a full load, principal entries are collected into batches and stored
+ * in name order.  Sorted insertion lets the btree module append to its last
+ * leaf page instead of searching and splitting pages in the middle of the
+ * tree, and serial dumps arrive sorted already, so consecutive batches extend
+ * the same sequence.
+ */
+#define LOAD_BATCH_SIZE 16384
+
+struct bulk_entry {
+    char *name;
+    size_t seq;                 /* keeps later duplicates after earlier ones */
+    int lineno;                 /* dump line of the record, for errors */
+    krb5_db_entry *entry;
+};
+
+static struct bulk_entry *bulk_entries;
+static size_t bulk_count;
+
 #define K5Q1(x) #x
 #define K5Q(x) K5Q1(x)
 #define K5CONST_WIDTH_SCANF_STR(x) "%" K5Q(x) "s"
@@ -85,8 +107,25 @@ struct dump_args {
     krb5_boolean verbose;
     krb5_boolean omit_nra;      /* omit non-replicated attributes */
     dump_version *dump;
+    unsigned long nrecords;     /* principal and policy records written */
+    int nworkers;               /* number of parallel dump processes */
+    int worker;                 /* index of this dump process */
+    int lead;                   /* leading name byte being dumped, or 0 */
 };
 
+/*
+ * A binary dump consists of the header line followed by records.  Each record
+ * is a one-byte type, a four-byte payload length, the payload, and a CRC-32
+ * of the type, length, and payload.  Integers are big-endian.  The last
+ * record is an end record containing the number of records before it, so
+ * that a truncated dump is detected.
+ */
+#define BINREC_PRINC    1
+#define BINREC_POLICY   2
+#define BINREC_END      3
+#define BINREC_HDRLEN   5
+#define BINREC_MAXLEN   (16 * 1024 * 1024)
+
 /* External data */
 extern krb5_db_entry *master_entry;
 
@@ -541,6 +580,196 @@ dump_ov_princ(krb5_context context, krb5_db_entry *entry, const char *name,
     return 0;
 }
 
+/* Return the CRC-32 (as used by zlib and Ethernet) of len bytes at data,
+ * continuing from crc. */
+static uint32_t
+crc32_update(uint32_t crc, const unsigned char *data, size_t len)
+{
+    static uint32_t table[256];
+    uint32_t c;
+    int i, j;
+
+    if (table[1] == 0) {
+        for (i = 0; i < 256; i++) {
+            c = i;
+            for (j = 0; j < 8; j++)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+
+    crc = ~crc;
+    while (len-- > 0)
+        crc = table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void
+bin_add_16(struct k5buf *buf, unsigned int val)
+{
+    void *p = k5_buf_get_space(buf, 2);
+
+    if (p != NULL)
+        store_16_be(val, p);
+}
+
+static void
+bin_add_32(struct k5buf *buf, uint32_t val)
+{
+    void *p = k5_buf_get_space(buf, 4);
+
+    if (p != NULL)
+        store_32_be(val, p);
+}
+
+/* Add a four-byte length followed by len bytes of data. */
+static void
+bin_add_data(struct k5buf *buf, const void *data, size_t len)
+{
+    bin_add_32(buf, len);
+    k5_buf_add_len(buf, data, len);
+}
+
+/* Add a count of the TL data in tl and each element. */
+static void
+bin_add_tl_data(struct k5buf *buf, krb5_tl_data *tl)
+{
+    krb5_tl_data *tlp;
+    unsigned int count = 0;
+
+    for (tlp = tl; tlp != NULL; tlp = tlp->tl_data_next)
+        count++;
+    bin_add_16(buf, count);
+    for (tlp = tl; tlp != NULL; tlp = tlp->tl_data_next) {
+        bin_add_16(buf, (uint16_t)tlp->tl_data_type);
+        bin_add_16(buf, tlp->tl_data_length);
+        k5_buf_add_len(buf, tlp->tl_data_contents, tlp->tl_data_length);
+    }
+}
+
+/* Begin a binary record of type rectype in buf. */
+static void
+bin_start_record(struct k5buf *buf, int rectype)
+{
+    unsigned char type = rectype;
+
+    k5_buf_init_dynamic(buf);
+    k5_buf_add_len(buf, &type, 1);
+    bin_add_32(buf, 0);
+}
+
+/* Fill in the length of the record in buf, add its checksum, write it to fp,
+ * and free buf. */
+static krb5_error_code
+bin_write_record(struct k5buf *buf, FILE *fp)
+{
+    krb5_error_code ret;
+    size_t len = buf->len;
+
+    if (k5_buf_status(buf) != 0)
+        return ENOMEM;
+    if (len - BINREC_HDRLEN > BINREC_MAXLEN) {
+        k5_buf_free(buf);
+        return EOVERFLOW;
+    }
+    store_32_be(len - BINREC_HDRLEN, (unsigned char *)buf->data + 1);
+    bin_add_32(buf, crc32_update(0, buf->data, len));
+    ret = k5_buf_status(buf);
+    if (!ret && fwrite(buf->data, 1, buf->len, fp) != buf->len)
+        ret = errno ? errno : EIO;
+    k5_buf_free(buf);
+    return ret;
+}
+
+/* Output a principal record in binary format. */
+static krb5_error_code
+dump_binary_princ(krb5_context context, krb5_db_entry *entry,
+                  const char *name, FILE *fp, krb5_boolean verbose,
+                  krb5_boolean omit_nra)
+{
+    krb5_error_code ret;
+    struct k5buf buf;
+    krb5_key_data *kd;
+    int i, j;
+
+    bin_start_record(&buf, BINREC_PRINC);
+    bin_add_data(&buf, name, strlen(name));
+    bin_add_16(&buf, entry->len);
+    bin_add_32(&buf, entry->attributes);
+    bin_add_32(&buf, entry->max_life);
+    bin_add_32(&buf, entry->max_renewable_life);
+    bin_add_32(&buf, entry->expiration);
+    bin_add_32(&buf, entry->pw_expiration);
+    bin_add_32(&buf, omit_nra ? 0 : entry->last_success);
+    bin_add_32(&buf, omit_nra ? 0 : entry->last_failed);
+    bin_add_32(&buf, omit_nra ? 0 : entry->fail_auth_count);
+    bin_add_tl_data(&buf, entry->tl_data);
+
+    bin_add_16(&buf, entry->n_key_data);
+    for (i = 0; i < entry->n_key_data; i++) {
+        kd = &entry->key_data[i];
+        bin_add_16(&buf, kd->key_data_ver);
+        bin_add_16(&buf, kd->key_data_kvno);
+        for (j = 0; j < kd->key_data_ver; j++) {
+            bin_add_16(&buf, (uint16_t)kd->key_data_type[j]);
+            bin_add_16(&buf, kd->key_data_length[j]);
+            k5_buf_add_len(&buf, kd->key_data_contents[j],
+                           kd->key_data_length[j]);
+        }
+    }
+
+    bin_add_16(&buf, entry->e_length);
+    k5_buf_add_len(&buf, entry->e_data, entry->e_length);
+
+    ret = bin_write_record(&buf, fp);
+    if (ret) {
+        com_err(progname, ret, _("while writing %s"), name);
+        return ret;
+    }
+    if (verbose)
+        fprintf(stderr, "%s\n", name);
+    return 0;
+}
+
+static void
+dump_binary_policy(void *data, osa_policy_ent_t entry)
+{
+    struct dump_args *arg = data;
+    struct k5buf buf;
+    const char *ks = entry->allowed_keysalts;
+
+    bin_start_record(&buf, BINREC_POLICY);
+    bin_add_data(&buf, entry->name, strlen(entry->name));
+    bin_add_32(&buf, entry->pw_min_life);
+    bin_add_32(&buf, entry->pw_max_life);
+    bin_add_32(&buf, entry->pw_min_length);
+    bin_add_32(&buf, entry->pw_min_classes);
+    bin_add_32(&buf, entry->pw_history_num);
+    bin_add_32(&buf, entry->pw_max_fail);
+    bin_add_32(&buf, entry->pw_failcnt_interval);
+    bin_add_32(&buf, entry->pw_lockout_duration);
+    bin_add_32(&buf, entry->attributes);
+    bin_add_32(&buf, entry->max_life);
+    bin_add_32(&buf, entry->max_renewable_life);
+    bin_add_data(&buf, ks, (ks == NULL) ? 0 : strlen(ks));
+    bin_add_tl_data(&buf, entry->tl_data);
+
+    /* A write error will be noticed when the output file is closed. */
+    if (bin_write_record(&buf, arg->ofile) == 0)
+        arg->nrecords++;
+}
+
+/* Write the end record of a binary dump. */
+static krb5_error_code
+dump_binary_end(struct dump_args *args)
+{
+    struct k5buf buf;
+
+    bin_start_record(&buf, BINREC_END);
+    bin_add_32(&buf, args->nrecords);
+    return bin_write_record(&buf, args->ofile);
+}
+
 static krb5_error_code
 dump_iterator(void *ptr, krb5_db_entry *entry)
 {
@@ -554,6 +783,13 @@ dump_iterator(void *ptr, krb5_db_entry *entry)
         return ret;
     }
 
+    /* In a parallel dump, each process iterates with a glob for one leading
+     * byte at a time.  The module may return principals beyond those matching
+     * the glob (db2 hash databases and LDAP visit every principal for each
+     * glob), so leave the others to their own iteration. */
+    if (args->lead != 0 && (unsigned char)name[0] != args->lead)
+        goto cleanup;
+
     /* Re-encode the keys in the new master key, if necessary. */
     if (mkey_convert) {
         ret = master_key_convert(args->context, entry);
@@ -570,6 +806,8 @@ dump_iterator(void *ptr, krb5_db_entry *entry)
 
     ret = args->dump->dump_princ(args->context, entry, name, args->ofile,
                                  args->verbose, args->omit_nra);
+    if (!ret)
+        args->nrecords++;
 
 cleanup:
     free(name);
@@ -700,6 +938,108 @@ process_tl_data(const char *fname, FILE *filep, int lineno,
     return 0;
 }
 
+static int
+bulk_entry_cmp(const void *a, const void *b)
+{
+    const struct bulk_entry *ea = a, *eb = b;
+    int cmp = strcmp(ea->name, eb->name);
+
+    if (cmp != 0)
+        return cmp;
+    return (ea->seq < eb->seq) ? -1 : (ea->seq > eb->seq);
+}
+
+/* Sort the queued principal entries by name and store them in the database.
+ * Free the entries whether or not they are stored successfully.  On failure,
+ * set *linenop to the dump line of the entry which could not be stored. */
+static krb5_error_code
+flush_bulk_entries(krb5_context context, int *linenop)
+{
+    krb5_error_code ret = 0;
+    size_t i;
+
+    qsort(bulk_entries, bulk_count, sizeof(*bulk_entries), bulk_entry_cmp);
+    for (i = 0; i < bulk_count; i++) {
+        if (!ret) {
+            ret = krb5_db_put_principal(context, bulk_entries[i].entry);
+            if (ret) {
+                com_err(progname, ret, _("while storing %s"),
+                        bulk_entries[i].name);
+                *linenop = bulk_entries[i].lineno;
+            }
+        }
+        krb5_db_free_principal(context, bulk_entries[i].entry);
+        free(bulk_entries[i].name);
+    }
+    bulk_count = 0;
+    return ret;
+}
+
+/* Store *dbentry (read from dump line *linenop) in the database, or queue it
+ * if a bulk load is in progress, taking ownership of it.  Display an error
+ * message on failure; if a queued entry fails, set *linenop to its line. */
+static krb5_error_code
+store_principal(krb5_context context, krb5_db_entry **dbentry,
+                const char *name, int *linenop)
+{
+    krb5_error_code ret;
+    char *copy;
+
+    if (bulk_entries == NULL) {
+        ret = krb5_db_put_principal(context, *dbentry);
+        if (ret)
+            com_err(progname, ret, _("while storing %s"), name);
+        return ret;
+    }
+
+    copy = strdup(name);
+    if (copy == NULL) {
+        com_err(progname, ENOMEM, _("while storing %s"), name);
+        return ENOMEM;
+    }
+    bulk_entries[bulk_count].name = copy;
+    bulk_entries[bulk_count].seq = bulk_count;
+    bulk_entries[bulk_count].lineno = *linenop;
+    bulk_entries[bulk_count].entry = *dbentry;
+    bulk_count++;
+    *dbentry = NULL;
+    if (bulk_count == LOAD_BATCH_SIZE)
+        return flush_bulk_entries(context, linenop);
+    return 0;
+}
+
+/* Set the mask bits of dbentry for its tagged data. */
+static void
+set_tl_data_mask(krb5_db_entry *dbentry)
+{
+    krb5_tl_data *tl;
+    XDR xdrs;
+    osa_princ_ent_rec osa_princ_ent;
+
+    if (dbentry->n_tl_data == 0)
+        return;
+    for (tl = dbentry->tl_data; tl; tl = tl->tl_data_next) {
+        /* test to set mask fields */
+        if (tl->tl_data_type == KRB5_TL_KADM_DATA) {
+            /* Assuming aux_attributes will always be there */
+            dbentry->mask |= KADM5_AUX_ATTRIBUTES;
+
+            /* test for an actual policy reference */
+            memset(&osa_princ_ent, 0, sizeof(osa_princ_ent));
+            xdrmem_create(&xdrs, (char *)tl->tl_data_contents,
+                          tl->tl_data_length, XDR_DECODE);
+            if (xdr_osa_princ_ent_rec(&xdrs, &osa_princ_ent)) {
+                if ((osa_princ_ent.aux_attributes & KADM5_POLICY) &&
+                    osa_princ_ent.policy != NULL)
+                    dbentry->mask |= KADM5_POLICY;
+                kdb_free_entry(NULL, NULL, &osa_princ_ent);
+            }
+            xdr_destroy(&xdrs);
+        }
+    }
+    dbentry->mask |= KADM5_TL_DATA;
+}
+
 /* Read a beta 7 entry and add it to the database.  Return -1 for end of file,
  * 0 for success and 1 for failure. */
 static int
@@ -712,7 +1052,6 @@ process_k5beta7_princ(krb5_context context, const char *fname, FILE *filep,
     unsigned int u1, u2, u3, u4, u5;
     char *name = NULL;
     krb5_key_data *kp = NULL, *kd;
-    krb5_tl_data *tl;
     krb5_error_code ret;
 
     dbentry = calloc(1, sizeof(*dbentry));
@@ -787,32 +1126,7 @@ process_k5beta7_princ(krb5_context context, const char *fname, FILE *filep,
     if (dbentry->n_tl_data) {
         if (process_tl_data(fname, filep, *linenop, dbentry->tl_data))
             goto fail;
-        for (tl = dbentry->tl_data; tl; tl = tl->tl_data_next) {
-            /* test to set mask fields */
-            if (tl->tl_data_type == KRB5_TL_KADM_DATA) {
-                XDR xdrs;
-                osa_princ_ent_rec osa_princ_ent;
-
-                /*
-                 * Assuming aux_attributes will always be
-                 * there
-                 */
-                dbentry->mask |= KADM5_AUX_ATTRIBUTES;
-
-                /* test for an actual policy reference */
-                memset(&osa_princ_ent, 0, sizeof(osa_princ_ent));
-                xdrmem_create(&xdrs, (char *)tl->tl_data_contents,
-                              tl->tl_data_length, XDR_DECODE);
-                if (xdr_osa_princ_ent_rec(&xdrs, &osa_princ_ent)) {
-                    if ((osa_princ_ent.aux_attributes & KADM5_POLICY) &&
-                        osa_princ_ent.policy != NULL)
-                        dbentry->mask |= KADM5_POLICY;
-                    kdb_free_entry(NULL, NULL, &osa_princ_ent);
-                }
-                xdr_destroy(&xdrs);
-            }
-        }
-        dbentry->mask |= KADM5_TL_DATA;
+        set_tl_data_mask(dbentry);
     }
 
     /* Get the key data. */
@@ -854,11 +1168,8 @@ process_k5beta7_princ(krb5_context context, const char *fname, FILE *filep,
     /* Finally, find the end of the record. */
     read_record_end(filep, fname, *linenop);
 
-    ret = krb5_db_put_principal(context, dbentry);
-    if (ret) {
-        com_err(progname, ret, _("while storing %s"), name);
+    if (store_principal(context, &dbentry, name, linenop))
         goto fail;
-    }
 
     if (verbose)
         fprintf(stderr, "%s\n", name);
@@ -1093,6 +1404,285 @@ process_r1_11_record(krb5_context context, const char *fname, FILE *filep,
                           process_k5beta7_princ, process_r1_11_policy);
 }
 
+/* Read one binary dump record from filep into *type_out and a newly
+ * allocated payload in *data_out and *len_out.  Verify the checksum.  Return 0
+ * on success, -1 for end of file, and 1 for failure. */
+static int
+bin_read_record(const char *fname, FILE *filep, int lineno, int *type_out,
+                unsigned char **data_out, size_t *len_out)
+{
+    unsigned char *rec, hdr[BINREC_HDRLEN], cksum[4];
+    size_t len;
+    uint32_t crc;
+
+    *data_out = NULL;
+    *len_out = 0;
+    if (fread(hdr, 1, BINREC_HDRLEN, filep) != BINREC_HDRLEN) {
+        if (feof(filep) && !ferror(filep))
+            return -1;
+        load_err(fname, lineno, _("cannot read record header"));
+        return 1;
+    }
+    len = load_32_be(hdr + 1);
+    if (len > BINREC_MAXLEN) {
+        load_err(fname, lineno, _("record length too large"));
+        return 1;
+    }
+    rec = malloc(len + 1);
+    if (rec == NULL)
+        return 1;
+    if (fread(rec, 1, len, filep) != len ||
+        fread(cksum, 1, 4, filep) != 4) {
+        load_err(fname, lineno, _("record is truncated"));
+        free(rec);
+        return 1;
+    }
+    crc = crc32_update(crc32_update(0, hdr, BINREC_HDRLEN), rec, len);
+    if (crc != load_32_be(cksum)) {
+        load_err(fname, lineno, _("record checksum mismatch"));
+        free(rec);
+        return 1;
+    }
+    *type_out = hdr[0];
+    *data_out = rec;
+    *len_out = len;
+    return 0;
+}
+
+/* Return a newly allocated copy of the next len bytes of in, or NULL if len is
+ * zero or an error occurs. */
+static unsigned char *
+bin_get_copy(struct k5input *in, size_t len)
+{
+    const unsigned char *ptr = k5_input_get_bytes(in, len);
+
+    if (ptr == NULL || len == 0)
+        return NULL;
+    return k5memdup(ptr, len, &in->status);
+}
+
+/* Read a four-byte length and that many bytes from in into a newly allocated
+ * zero-terminated string. */
+static char *
+bin_get_string(struct k5input *in)
+{
+    size_t len = k5_input_get_uint32_be(in);
+    const unsigned char *ptr = k5_input_get_bytes(in, len);
+
+    if (ptr == NULL)
+        return NULL;
+    return k5memdup0(ptr, len, &in->status);
+}
+
+/* Read a count of TL data elements and the elements from in. */
+static void
+bin_get_tl_data(struct k5input *in, krb5_int16 *n_out,
+                krb5_tl_data **tl_out)
+{
+    krb5_tl_data *tl;
+    uint16_t n = k5_input_get_uint16_be(in);
+
+    if (n > SHRT_MAX) {
+        k5_input_set_status(in, EINVAL);
+        return;
+    }
+    if (alloc_tl_data(n, tl_out)) {
+        k5_input_set_status(in, ENOMEM);
+        return;
+    }
+    *n_out = n;
+    for (tl = *tl_out; tl != NULL && !in->status; tl = tl->tl_data_next) {
+        tl->tl_data_type = k5_input_get_uint16_be(in);
+        tl->tl_data_length = k5_input_get_uint16_be(in);
+        tl->tl_data_contents = bin_get_copy(in, tl->tl_data_length);
+    }
+}
+
+/* Decode a binary principal record and add it to the database. */
+static int
+process_binary_princ(krb5_context context, const char *fname, int *linenop,
+                     krb5_boolean verbose, struct k5input *in)
+{
+    int retval = 1;
+    krb5_db_entry *dbentry;
+    krb5_key_data *kd;
+    char *name;
+    int i, j;
+    krb5_error_code ret;
+
+    dbentry = calloc(1, sizeof(*dbentry));
+    if (dbentry == NULL)
+        return 1;
+    name = bin_get_string(in);
+    dbentry->len = k5_input_get_uint16_be(in);
+    dbentry->attributes = k5_input_get_uint32_be(in);
+    dbentry->max_life = k5_input_get_uint32_be(in);
+    dbentry->max_renewable_life = k5_input_get_uint32_be(in);
+    dbentry->expiration = k5_input_get_uint32_be(in);
+    dbentry->pw_expiration = k5_input_get_uint32_be(in);
+    dbentry->last_success = k5_input_get_uint32_be(in);
+    dbentry->last_failed = k5_input_get_uint32_be(in);
+    dbentry->fail_auth_count = k5_input_get_uint32_be(in);
+    dbentry->mask = KADM5_LOAD | KADM5_PRINCIPAL | KADM5_ATTRIBUTES |
+        KADM5_MAX_LIFE | KADM5_MAX_RLIFE |
+        KADM5_PRINC_EXPIRE_TIME | KADM5_LAST_SUCCESS |
+        KADM5_LAST_FAILED | KADM5_FAIL_AUTH_COUNT;
+    bin_get_tl_data(in, &dbentry->n_tl_data, &dbentry->tl_data);
+    if (in->status)
+        goto cleanup;
+    set_tl_data_mask(dbentry);
+
+    dbentry->n_key_data = k5_input_get_uint16_be(in);
+    if (dbentry->n_key_data > 0) {
+        dbentry->key_data = calloc(dbentry->n_key_data, sizeof(*kd));
+        if (dbentry->key_data == NULL) {
+            dbentry->n_key_data = 0;
+            goto cleanup;
+        }
+        dbentry->mask |= KADM5_KEY_DATA;
+    }
+    for (i = 0; i < dbentry->n_key_data && !in->status; i++) {
+        kd = &dbentry->key_data[i];
+        kd->key_data_ver = k5_input_get_uint16_be(in);
+        kd->key_data_kvno = k5_input_get_uint16_be(in);
+        if (kd->key_data_ver > KRB5_KDB_V1_KEY_DATA_ARRAY) {
+            k5_input_set_status(in, EINVAL);
+            break;
+        }
+        for (j = 0; j < kd->key_data_ver; j++) {
+            kd->key_data_type[j] = k5_input_get_uint16_be(in);
+            kd->key_data_length[j] = k5_input_get_uint16_be(in);
+            kd->key_data_contents[j] = bin_get_copy(in,
+                                                    kd->key_data_length[j]);
+        }
+    }
+
+    dbentry->e_length = k5_input_get_uint16_be(in);
+    dbentry->e_data = bin_get_copy(in, dbentry->e_length);
+    if (in->status || in->len != 0) {
+        load_err(fname, *linenop, _("cannot decode principal record"));
+        goto cleanup;
+    }
+
+    ret = krb5_parse_name(context, name, &dbentry->princ);
+    if (ret) {
+        com_err(progname, ret, _("while parsing name %s"), name);
+        goto cleanup;
+    }
+    if (store_principal(context, &dbentry, name, linenop))
+        goto cleanup;
+
+    if (verbose)
+        fprintf(stderr, "%s\n", name);
+    retval = 0;
+
+cleanup:
+    free(name);
+    krb5_db_free_principal(context, dbentry);
+    return retval;
+}
+
+/* Decode a binary policy record and add it to the database. */
+static int
+process_binary_policy(krb5_context context, const char *fname, int lineno,
+                      krb5_boolean verbose, struct k5input *in)
+{
+    osa_policy_ent_rec rec;
+    krb5_tl_data *tl, *tl_next;
+    int retval = 1;
+    krb5_error_code ret;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.name = bin_get_string(in);
+    rec.pw_min_life = k5_input_get_uint32_be(in);
+    rec.pw_max_life = k5_input_get_uint32_be(in);
+    rec.pw_min_length = k5_input_get_uint32_be(in);
+    rec.pw_min_classes = k5_input_get_uint32_be(in);
+    rec.pw_history_num = k5_input_get_uint32_be(in);
+    rec.pw_max_fail = k5_input_get_uint32_be(in);
+    rec.pw_failcnt_interval = k5_input_get_uint32_be(in);
+    rec.pw_lockout_duration = k5_input_get_uint32_be(in);
+    rec.attributes = k5_input_get_uint32_be(in);
+    rec.max_life = k5_input_get_uint32_be(in);
+    rec.max_renewable_life = k5_input_get_uint32_be(in);
+    rec.allowed_keysalts = bin_get_string(in);
+    bin_get_tl_data(in, &rec.n_tl_data, &rec.tl_data);
+    if (in->status || in->len != 0) {
+        load_err(fname, lineno, _("cannot decode policy record"));
+        goto cleanup;
+    }
+    if (rec.allowed_keysalts != NULL && *rec.allowed_keysalts == '\0') {
+        free(rec.allowed_keysalts);
+        rec.allowed_keysalts = NULL;
+    }
+
+    ret = krb5_db_create_policy(context, &rec);
+    if (ret)
+        ret = krb5_db_put_policy(context, &rec);
+    if (ret) {
+        com_err(progname, ret, _("while creating policy"));
+        goto cleanup;
+    }
+    if (verbose)
+        fprintf(stderr, "created policy %s\n", rec.name);
+    retval = 0;
+
+cleanup:
+    free(rec.name);
+    free(rec.allowed_keysalts);
+    for (tl = rec.tl_data; tl; tl = tl_next) {
+        tl_next = tl->tl_data_next;
+        free(tl->tl_data_contents);
+        free(tl);
+    }
+    return retval;
+}
+
+/* Read and process one binary dump record.  Records are counted in *linenop,
+ * so that the end record can check that none are missing. */
+static int
+process_binary_record(krb5_context context, const char *fname, FILE *filep,
+                      krb5_boolean verbose, int *linenop)
+{
+    struct k5input in;
+    unsigned char *data;
+    size_t len;
+    uint32_t count;
+    int type, ret;
+
+    (*linenop)++;
+    ret = bin_read_record(fname, filep, *linenop, &type, &data, &len);
+    if (ret == -1) {
+        load_err(fname, *linenop, _("dump is missing its end record"));
+        return 1;
+    }
+    if (ret)
+        return ret;
+
+    k5_input_init(&in, data, len);
+    if (type == BINREC_PRINC) {
+        ret = process_binary_princ(context, fname, linenop, verbose, &in);
+    } else if (type == BINREC_POLICY) {
+        ret = process_binary_policy(context, fname, *linenop, verbose, &in);
+    } else if (type == BINREC_END) {
+        count = k5_input_get_uint32_be(&in);
+        if (in.status || in.len != 0 || count != (uint32_t)*linenop - 2) {
+            load_err(fname, *linenop, _("record count mismatch"));
+            ret = 1;
+        } else if (getc(filep) != EOF) {
+            load_err(fname, *linenop, _("data after end record"));
+            ret = 1;
+        } else {
+            ret = -1;
+        }
+    } else {
+        fprintf(stderr, _("unknown record type \"%d\"\n"), type);
+        ret = 1;
+    }
+    free(data);
+    return ret;
+}
+
 dump_version beta7_version = {
     "Kerberos version 5",
     "kdb5_util load_dump version 4\n",
@@ -1143,6 +1733,16 @@ dump_version r1_11_version = {
     dump_r1_11_policy,
     process_r1_11_record,
 };
+dump_version binary_version = {
+    "Kerberos version 5 binary",
+    "kdb5_util load_dump binary version 1\n",
+    0,
+    0,
+    0,
+    dump_binary_princ,
+    dump_binary_policy,
+    process_binary_record,
+};
 dump_version iprop_version = {
     "Kerberos iprop version",
     "iprop",
@@ -1221,8 +1821,10 @@ current_dump_sno_in_ulog(krb5_context context, const char *ifile)
     if (f == NULL)
         return 0;              /* aliasing other errors to ENOENT here is OK */
 
-    if (fgets(buf, sizeof(buf), f) == NULL)
-        return errno ? -1 : 0;
+    if (fgets(buf, sizeof(buf), f) == NULL) {
+        fclose(f);
+        return 0;
+    }
     fclose(f);
 
     if (!parse_iprop_header(buf, &junk, &last))
@@ -1232,10 +1834,231 @@ current_dump_sno_in_ulog(krb5_context context, const char *ifile)
     return status == UPDATE_OK || status == UPDATE_NIL;
 }
 
+/* Set glob to a pattern matching the principal names which begin with the
+ * byte c. */
+static void
+lead_glob(int c, char glob[4])
+{
+    char *p = glob;
+
+    if (strchr("*?[\\", c) != NULL)
+        *p++ = '\\';
+    *p++ = c;
+    *p++ = '*';
+    *p = '\0';
+}
+
+/* Ignore an entry found while checking that the module can iterate by
+ * prefix. */
+static krb5_error_code
+skip_entry(void *ptr, krb5_db_entry *entry)
+{
+    return 0;
+}
+
+/* In a child process, write binary records for the principals whose names
+ * begin with a byte assigned to args->worker to fd, and exit. */
+static void
+dump_worker(struct dump_args *args, int fd, krb5_flags iterflags)
+{
+    krb5_error_code ret;
+    char glob[4];
+    int c;
+
+    /* The inherited database handle shares its file offset with the parent
+     * and the other workers, so open our own.  The parent's lock keeps the
+     * database consistent for us. */
+    (void)krb5_db_fini(util_context);
+    ret = krb5_db_open(util_context, db5util_db_args,
+                       KRB5_KDB_OPEN_RO | KRB5_KDB_SRV_TYPE_ADMIN);
+    if (!ret && mkey_convert) {
+        ret = krb5_db_fetch_mkey_list(util_context, master_princ,
+                                      &master_keyblock);
+    }
+    if (ret) {
+        com_err(progname, ret, _("while reopening database"));
+        _exit(1);
+    }
+
+    args->ofile = fdopen(fd, "w");
+    if (args->ofile == NULL)
+        _exit(1);
+
+    /* Iterate over each leading byte separately, so that the module can seek
+     * to the matching key range. */
+    for (c = 1; c < 256 && !ret; c++) {
+        if (c % args->nworkers != args->worker)
+            continue;
+        lead_glob(c, glob);
+        args->lead = c;
+        ret = krb5_db_iterate(util_context, glob, dump_iterator, args,
+                              iterflags | KRB5_DB_ITER_PREFIX);
+    }
+    if (ret)
+        com_err(progname, ret, _("performing %s dump"), args->dump->name);
+    if (fclose(args->ofile) != 0 && !ret) {
+        com_err(progname, errno, _("while writing dump"));
+        ret = 1;
+    }
+    _exit(ret ? 1 : 0);
+}
+
+/* Copy the complete records in buf to fp, counting them in *count, and leave
+ * any partial record at the start of buf. */
+static krb5_error_code
+flush_worker_records(struct k5buf *buf, FILE *fp, unsigned long *count)
+{
+    unsigned char *p = buf->data;
+    size_t reclen, off = 0;
+
+    while (buf->len - off >= BINREC_HDRLEN) {
+        reclen = BINREC_HDRLEN + load_32_be(p + off + 1) + 4;
+        if (buf->len - off < reclen)
+            break;
+        off += reclen;
+        (*count)++;
+    }
+    if (off > 0) {
+        if (fwrite(buf->data, 1, off, fp) != off)
+            return errno ? errno : EIO;
+        memmove(buf->data, p + off, buf->len - off);
+        k5_buf_truncate(buf, buf->len - off);
+    }
+    return 0;
+}
+
+/*
+ * Dump the principals in binary format using nworkers child processes, each
+ * handling the names beginning with a subset of the possible first bytes.
+ * Complete records are copied to args->ofile as they arrive from each worker.
+ * A shared lock is held across the whole dump so that the workers see the
+ * same database contents.
+ */
+static krb5_error_code
+dump_parallel(struct dump_args *args, int nworkers, krb5_flags iterflags)
+{
+    krb5_error_code ret, ret2;
+    struct pollfd *fds = NULL;
+    struct k5buf *bufs = NULL;
+    pid_t *pids = NULL;
+    int i, j, nopen = 0, status, pfd[2];
+    krb5_boolean locked = FALSE;
+    char chunk[BUFSIZ];
+    ssize_t nread;
+
+    fds = calloc(nworkers, sizeof(*fds));
+    bufs = calloc(nworkers, sizeof(*bufs));
+    pids = calloc(nworkers, sizeof(*pids));
+    if (fds == NULL || bufs == NULL || pids == NULL) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    for (i = 0; i < nworkers; i++) {
+        fds[i].fd = -1;
+        k5_buf_init_dynamic(&bufs[i]);
+    }
+
+    ret = krb5_db_lock(util_context, KRB5_DB_LOCKMODE_SHARED);
+    if (ret == 0)
+        locked = TRUE;
+    else if (ret != KRB5_PLUGIN_OP_NOTSUPP)
+        goto cleanup;
+    ret = 0;
+
+    /* Don't let the workers inherit unflushed output. */
+    fflush(args->ofile);
+    fflush(stderr);
+
+    for (i = 0; i < nworkers; i++) {
+        if (pipe(pfd) == -1) {
+            ret = errno;
+            goto cleanup;
+        }
+        pids[i] = fork();
+        if (pids[i] == -1) {
+            ret = errno;
+            close(pfd[0]);
+            close(pfd[1]);
+            goto cleanup;
+        }
+        if (pids[i] == 0) {
+            close(pfd[0]);
+            for (j = 0; j < i; j++)
+                close(fds[j].fd);
+            args->worker = i;
+            dump_worker(args, pfd[1], iterflags);
+        }
+        close(pfd[1]);
+        fds[i].fd = pfd[0];
+        fds[i].events = POLLIN;
+        nopen++;
+    }
+
+    while (nopen > 0) {
+        if (poll(fds, nworkers, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            ret = errno;
+            goto cleanup;
+        }
+        for (i = 0; i < nworkers; i++) {
+            if (fds[i].fd == -1 || fds[i].revents == 0)
+                continue;
+            nread = read(fds[i].fd, chunk, sizeof(chunk));
+            if (nread == -1 && errno == EINTR)
+                continue;
+            if (nread <= 0) {
+                /* A worker which dies mid-record leaves a partial record. */
+                if (nread == -1 || bufs[i].len > 0)
+                    ret = (nread == -1) ? errno : KRB5_KDB_TRUNCATED_RECORD;
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                nopen--;
+                if (ret)
+                    goto cleanup;
+                continue;
+            }
+            k5_buf_add_len(&bufs[i], chunk, nread);
+            if (k5_buf_status(&bufs[i]) != 0) {
+                ret = ENOMEM;
+                goto cleanup;
+            }
+            ret = flush_worker_records(&bufs[i], args->ofile, &args->nrecords);
+            if (ret)
+                goto cleanup;
+        }
+    }
+
+cleanup:
+    for (i = 0; fds != NULL && i < nworkers; i++) {
+        if (fds[i].fd != -1)
+            close(fds[i].fd);
+    }
+    /* Reap the workers; any unsuccessful exit fails the dump. */
+    for (i = 0; pids != NULL && i < nworkers; i++) {
+        if (pids[i] <= 0)
+            continue;
+        while (waitpid(pids[i], &status, 0) == -1 && errno == EINTR);
+        if (!ret && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+            ret = KRB5_KDB_INTERNAL_ERROR;
+    }
+    if (locked) {
+        ret2 = krb5_db_unlock(util_context);
+        if (!ret)
+            ret = ret2;
+    }
+    for (i = 0; bufs != NULL && i < nworkers; i++)
+        k5_buf_free(&bufs[i]);
+    free(fds);
+    free(bufs);
+    free(pids);
+    return ret;
+}
+
 /*
  * usage is:
- *      dump_db [-b7] [-ov] [-r13] [-r18] [-verbose] [-mkey_convert]
- *              [-new_mkey_file mkey_file] [-rev] [-recurse]
+ *      dump_db [-b7] [-ov] [-r13] [-r18] [-binary [-j jobs]] [-verbose]
+ *              [-mkey_convert] [-new_mkey_file mkey_file] [-rev] [-recurse]
  *              [filename [principals...]]
  */
 void
@@ -1254,11 +2077,17 @@ dump_db(int argc, char **argv)
     krb5_boolean conditional = FALSE;
     kdb_last_t last;
     krb5_flags iterflags = 0;
+    int nworkers = 1;
+    char glob[4];
 
     /* Parse the arguments. */
     dump = &r1_11_version;
     args.verbose = FALSE;
     args.omit_nra = FALSE;
+    args.nrecords = 0;
+    args.nworkers = 1;
+    args.worker = 0;
+    args.lead = 0;
     mkey_convert = FALSE;
     log_ctx = util_context->kdblog_context;
 
@@ -1274,6 +2103,12 @@ dump_db(int argc, char **argv)
             dump = &r1_3_version;
         } else if (!strcmp(argv[aindex], "-r18")) {
             dump = &r1_8_version;
+        } else if (!strcmp(argv[aindex], "-binary")) {
+            dump = &binary_version;
+        } else if (!strcmp(argv[aindex], "-j") && aindex + 1 < argc) {
+            nworkers = atoi(argv[++aindex]);
+            if (nworkers < 1 || nworkers > 255)
+                usage();
         } else if (!strncmp(argv[aindex], "-i", 2)) {
             if (log_ctx && log_ctx->iproprole) {
                 /* ipropx_version is the maximum version acceptable. */
@@ -1321,8 +2156,18 @@ dump_db(int argc, char **argv)
         }
     }
 
-    /* If a conditional ipropx dump we check if the existing dump is
-     * good enough. */
+    if (nworkers > 1 && (dump != &binary_version || iterflags != 0)) {
+        com_err(progname, 0, _("-j can only be used with -binary, and not "
+                               "with -rev or -recurse"));
+        goto error;
+    }
+
+    /*
+     * If a conditional ipropx dump we check if the existing dump is good
+     * enough.  The check is made while holding the dump_ok lock, so that
+     * when several slaves need a full resync at once, the first dump is
+     * written once and the others wait for it and then reuse it.
+     */
     if (ofile != NULL && conditional) {
         if (!dump->iprop) {
             com_err(progname, 0,
@@ -1330,8 +2175,12 @@ dump_db(int argc, char **argv)
                       "use only for iprop dumps"));
             goto error;
         }
-        if (current_dump_sno_in_ulog(util_context, ofile))
+        if (!prep_ok_file(util_context, ofile, &ok_fd))
+            return;             /* prep_ok_file() bumps exit_status */
+        if (current_dump_sno_in_ulog(util_context, ofile)) {
+            close(ok_fd);
             return;
+        }
     }
 
     /*
@@ -1343,6 +2192,21 @@ dump_db(int argc, char **argv)
         goto error;
     }
 
+    /*
+     * Each worker iterates once per leading byte, so a parallel dump is only
+     * worthwhile if the module can seek to the names beginning with a byte.
+     * Check with the first worker's pattern before starting.
+     */
+    if (nworkers > 1) {
+        lead_glob(1, glob);
+        ret = krb5_db_iterate(util_context, glob, skip_entry, NULL,
+                              KRB5_DB_ITER_PREFIX | KRB5_DB_ITER_NAMES_ONLY);
+        if (ret) {
+            com_err(progname, ret, _("-j cannot be used with this database"));
+            goto error;
+        }
+    }
+
     /*
      * If we're doing a master key conversion, set up for it.
      */
@@ -1402,7 +2266,7 @@ dump_db(int argc, char **argv)
         /* Discourage accidental dumping to filenames beginning with '-'. */
         if (ofile[0] == '-')
             usage();
-        if (!prep_ok_file(util_context, ofile, &ok_fd))
+        if (ok_fd == -1 && !prep_ok_file(util_context, ofile, &ok_fd))
             return;             /* prep_ok_file() bumps exit_status */
         f = create_ofile(ofile, &tmpofile);
         if (f == NULL) {
@@ -1434,7 +2298,13 @@ dump_db(int argc, char **argv)
     if (dump->header[strlen(dump->header)-1] != '\n')
         fputc('\n', args.ofile);
 
-    ret = krb5_db_iterate(util_context, NULL, dump_iterator, &args, iterflags);
+    if (nworkers > 1) {
+        args.nworkers = nworkers;
+        ret = dump_parallel(&args, nworkers, iterflags);
+    } else {
+        ret = krb5_db_iterate(util_context, NULL, dump_iterator, &args,
+                              iterflags);
+    }
     if (ret) {
         com_err(progname, ret, _("performing %s dump"), dump->name);
         goto error;
@@ -1448,6 +2318,19 @@ dump_db(int argc, char **argv)
         }
     }
 
+    if (dump == &binary_version) {
+        ret = dump_binary_end(&args);
+        if (ret) {
+            com_err(progname, ret, _("performing %s dump"), dump->name);
+            goto error;
+        }
+    }
+
+    if (fflush(f) != 0 || ferror(f)) {
+        com_err(progname, errno, _("while writing dump"));
+        goto error;
+    }
+
     if (f != stdout) {
         fclose(f);
         finish_ofile(ofile, &tmpofile);
@@ -1472,6 +2355,9 @@ restore_dump(krb5_context context, char *dumpfile, FILE *f,
 
     /* Process the records. */
     while (!(err = dump->load_record(context, dumpfile, f, verbose, &lineno)));
+    if (err == -1 && bulk_count > 0 &&
+        flush_bulk_entries(context, &lineno) != 0)
+        err = 1;
     if (err != -1) {
         fprintf(stderr, _("%s: error processing line %d of %s\n"), progname,
                 lineno, dumpfile);
@@ -1482,7 +2368,7 @@ restore_dump(krb5_context context, char *dumpfile, FILE *f,
 
 /*
  * Usage: load_db [-ov] [-b7] [-r13] [-verbose] [-update] [-hash]
- *                filename
+ *                filename|-
  */
 void
 load_db(int argc, char **argv)
@@ -1537,7 +2423,7 @@ load_db(int argc, char **argv)
     dumpfile = argv[aindex];
 
     /* Open the dumpfile. */
-    if (dumpfile != NULL) {
+    if (dumpfile != NULL && strcmp(dumpfile, "-") != 0) {
         f = fopen(dumpfile, "r");
         if (f == NULL) {
             com_err(progname, errno, _("while opening %s"), dumpfile);
@@ -1571,6 +2457,8 @@ load_db(int argc, char **argv)
             load = &r1_8_version;
         } else if (strcmp(buf, r1_11_version.header) == 0) {
             load = &r1_11_version;
+        } else if (strcmp(buf, binary_version.header) == 0) {
+            load = &binary_version;
         } else if (strncmp(buf, ov_version.header,
                            strlen(ov_version.header)) == 0) {
             load = &ov_version;
@@ -1613,6 +2501,23 @@ load_db(int argc, char **argv)
             goto error;
         }
         temp_db_created = TRUE;
+
+        /* Nothing else uses the temporary DB, so hold a lock on it for the
+         * whole load.  This keeps the module from reopening and flushing the
+         * database for each record. */
+        ret = krb5_db_lock(util_context, KRB5_DB_LOCKMODE_EXCLUSIVE);
+        if (ret == 0) {
+            db_locked = TRUE;
+        } else if (ret != KRB5_PLUGIN_OP_NOTSUPP) {
+            com_err(progname, ret, _("while locking database"));
+            goto error;
+        }
+
+        bulk_entries = calloc(LOAD_BATCH_SIZE, sizeof(*bulk_entries));
+        if (bulk_entries == NULL) {
+            com_err(progname, ENOMEM, _("while loading database"));
+            goto error;
+        }
     } else {
         /* Initialize the database. */
         ret = krb5_db_open(util_context, db5util_db_args,
@@ -1654,6 +2559,7 @@ load_db(int argc, char **argv)
         com_err(progname, ret, _("while unlocking database"));
         goto error;
     }
+    db_locked = FALSE;
 
     if (!update) {
         /* Initialize the ulog header before promoting so we can't leave behind
@@ -1695,8 +2601,21 @@ load_db(int argc, char **argv)
     }
 
 cleanup:
+    if (bulk_entries != NULL) {
+        while (bulk_count > 0) {
+            bulk_count--;
+            krb5_db_free_principal(util_context,
+                                   bulk_entries[bulk_count].entry);
+            free(bulk_entries[bulk_count].name);
+        }
+        free(bulk_entries);
+        bulk_entries = NULL;
+    }
+
     /* If we created a temporary DB but didn't succeed, destroy it. */
     if (exit_status && temp_db_created) {
+        if (db_locked)
+            (void)krb5_db_unlock(util_context);
         ret = krb5_db_destroy(util_context, db5util_db_args);
         /* Ignore a not supported error since there is nothing to do about
          * it anyway. */
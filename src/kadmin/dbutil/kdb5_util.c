@@ -55,6 +55,7 @@
 
 #include <k5-int.h>
 #include <kadm5/admin.h>
+#include <kadm5/server_internal.h>
 #include <locale.h>
 #include <adm_proto.h>
 #include <time.h>
@@ -84,8 +85,8 @@ void usage()
               "\tcreate  [-s]\n"
               "\tdestroy [-f]\n"
               "\tstash   [-f keyfile]\n"
-              "\tdump    [-old|-ov|-b6|-b7|-r13|-r18] [-verbose]\n"
-              "\t        [-mkey_convert] [-new_mkey_file mkey_file]\n"
+              "\tdump    [-old|-ov|-b6|-b7|-r13|-r18|-binary] [-j jobs]\n"
+              "\t        [-verbose] [-mkey_convert] [-new_mkey_file mkey_file]\n"
               "\t        [-rev] [-recurse] [filename [princs...]]\n"
               "\tload    [-old|-ov|-b6|-b7|-r13|-r18] [-verbose] [-update] "
               "filename\n"
@@ -98,6 +99,7 @@ void usage()
             _("\tupdate_princ_encryption [-f] [-n] [-v] [princ-pattern]\n"
               "\tpurge_mkeys [-f] [-n] [-v]\n"
               "\ttabdump [-H] [-c] [-e] [-n] [-o outfile] dumptype\n"
+              "\tcompile_dict [-b bits] [-n] wordfile [dictfile]\n"
               "\nwhere,\n\t[-x db_args]* - any number of database specific "
               "arguments.\n"
               "\t\t\tLook at each database documentation for supported "
@@ -119,6 +121,7 @@ krb5_boolean dbactive = FALSE;
 static int open_db_and_mkey(void);
 
 static void add_random_key(int, char **);
+static void compile_dict(int, char **);
 
 typedef void (*cmd_func)(int, char **);
 
@@ -139,6 +142,7 @@ struct _cmd_table {
     {"update_princ_encryption", kdb5_update_princ_encryption, 1},
     {"purge_mkeys", kdb5_purge_mkeys, 1},
     {"tabdump", tabdump, 1},
+    {"compile_dict", compile_dict, 0},
     {NULL, NULL, 0},
 };
 
@@ -649,3 +653,41 @@ add_random_key(argc, argv)
     }
     printf(_("%s changed\n"), pr_str);
 }
+
+static void
+compile_dict(int argc, char **argv)
+{
+    krb5_error_code ret;
+    char *me = progname, *end, *wordfile, *dictfile;
+    unsigned long bits = 0;
+    krb5_boolean exact = TRUE;
+
+    for (argv++, argc--; *argv != NULL && **argv == '-'; argv++, argc--) {
+        if (strcmp(*argv, "-b") == 0 && argv[1] != NULL) {
+            argv++, argc--;
+            bits = strtoul(*argv, &end, 10);
+            if (*end != '\0' || bits == 0 || bits > 64)
+                usage();
+        } else if (strcmp(*argv, "-n") == 0) {
+            exact = FALSE;
+        } else {
+            usage();
+        }
+    }
+    if (argc < 1 || argc > 2 || (!exact && bits == 0))
+        usage();
+    wordfile = argv[0];
+    dictfile = (argc == 2) ? argv[1] : global_params.dict_file;
+    if (dictfile == NULL) {
+        com_err(me, 0, _("No dictionary file specified"));
+        exit_status++;
+        return;
+    }
+
+    ret = kadm5int_dict_compile(util_context, wordfile, dictfile, bits, exact);
+    if (ret) {
+        com_err(me, ret, _("while compiling %s into %s"), wordfile, dictfile);
+        exit_status++;
+        return;
+    }
+}
@@ -8,6 +8,7 @@
 
 
 #include "k5-platform.h"
+#include <socket-utils.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/resource.h> /* rlimit */
@@ -27,6 +28,7 @@
 #include <kdb_log.h>
 #include "misc.h"
 #include "osconf.h"
+#include "kprop.h"
 
 extern gss_name_t rqst2name(struct svc_req *rqstp);
 
@@ -129,6 +131,154 @@ buf_to_string(gss_buffer_desc *b)
     return s;
 }
 
+/*
+ * Slaves which have recently asked for updates, by the address of their kprop
+ * port.  Each committed update is announced to them with a datagram so that
+ * they need not wait for their next poll.  A slave which has not polled for
+ * SUBSCRIBER_LIFETIME seconds is dropped.
+ */
+#define SUBSCRIBER_LIFETIME (60 * 60)
+
+struct subscriber {
+    struct sockaddr_storage addr;
+    time_t last;
+};
+
+static struct subscriber *subscribers;
+static size_t nsubscribers;
+
+/* Return the port to which update notifications are sent. */
+static uint16_t
+notify_port(void)
+{
+    static uint16_t port;
+    struct addrinfo hints, *res;
+
+    if (port != 0)
+	return port;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(NULL, (kprop_port != NULL) ? kprop_port : KPROP_SERVICE,
+		    &hints, &res) == 0) {
+	port = sa_getport(res->ai_addr);
+	freeaddrinfo(res);
+    }
+    if (port == 0)
+	port = KPROP_PORT;
+    return port;
+}
+
+/* Record the slave calling on xprt as a subscriber to update notifications,
+ * or refresh its entry if it is already present. */
+static void
+add_subscriber(SVCXPRT *xprt)
+{
+    struct sockaddr_storage ss;
+    socklen_t sslen = sizeof(ss);
+    struct subscriber *newsubs;
+    time_t now = time(NULL);
+    size_t i;
+
+    memset(&ss, 0, sizeof(ss));
+    if (getpeername(xprt->xp_sock, ss2sa(&ss), &sslen) != 0 ||
+	!sa_is_inet(ss2sa(&ss)))
+	return;
+    sa_setport(ss2sa(&ss), notify_port());
+
+    for (i = 0; i < nsubscribers; i++) {
+	if (memcmp(&subscribers[i].addr, &ss, sa_socklen(ss2sa(&ss))) == 0) {
+	    subscribers[i].last = now;
+	    return;
+	}
+    }
+    newsubs = realloc(subscribers, (nsubscribers + 1) * sizeof(*newsubs));
+    if (newsubs == NULL)
+	return;
+    subscribers = newsubs;
+    subscribers[nsubscribers].addr = ss;
+    subscribers[nsubscribers].last = now;
+    nsubscribers++;
+}
+
+/* ulog notification callback: tell each current subscriber that the log now
+ * ends at sno, dropping subscribers which have stopped polling. */
+static void
+notify_subscribers(krb5_context context, kdb_sno_t sno, void *data)
+{
+    unsigned char msg[IPROP_NOTIFY_LEN];
+    struct sockaddr *sa;
+    time_t now = time(NULL);
+    size_t i, j;
+    int fd;
+
+    store_32_be(IPROP_NOTIFY_MAGIC, msg);
+    store_32_be(sno, msg + 4);
+    for (i = j = 0; i < nsubscribers; i++) {
+	if (now - subscribers[i].last > SUBSCRIBER_LIFETIME)
+	    continue;
+	subscribers[j++] = subscribers[i];
+	sa = ss2sa(&subscribers[i].addr);
+	fd = socket(sa->sa_family, SOCK_DGRAM, 0);
+	if (fd < 0)
+	    continue;
+	if (sendto(fd, msg, sizeof(msg), 0, sa, sa_socklen(sa)) < 0)
+	    DPRINT("notify_subscribers: sendto failed: %s\n", strerror(errno));
+	close(fd);
+    }
+    nsubscribers = j;
+}
+
+/*
+ * On an intermediate slave, updates reach the ulog through kpropd rather than
+ * through kadmind, so kadmind -proponly checks the ulog every
+ * ULOG_WATCH_INTERVAL milliseconds and relays changes to its own subscribers.
+ * A ulog holding only the dummy entry left by a reset or a full load is not
+ * announced, as it has no updates to offer; subscribers which need a full
+ * resync will learn so when they next poll.
+ */
+#define ULOG_WATCH_INTERVAL 1000
+
+static kdb_last_t watched;
+
+static void
+watch_ulog(verto_ctx *vctx, verto_ev *ev)
+{
+    kadm5_server_handle_t handle = global_server_handle;
+    kdb_last_t first, last;
+
+    if (ulog_get_first(handle->context, &first) != 0 ||
+	ulog_get_last(handle->context, &last) != 0)
+	return;
+    if (last.last_sno == watched.last_sno &&
+	last.last_time.seconds == watched.last_time.seconds &&
+	last.last_time.useconds == watched.last_time.useconds)
+	return;
+    watched = last;
+    if (first.last_sno != last.last_sno)
+	notify_subscribers(handle->context, last.last_sno, NULL);
+}
+
+/* Send update notifications to slaves when kadmind commits updates, or, if
+ * relay is true, when kpropd replays updates from upstream. */
+krb5_error_code
+iprop_notify_init(verto_ctx *vctx, krb5_context context, krb5_boolean relay)
+{
+    krb5_error_code ret;
+
+    if (!relay)
+	return ulog_set_notify(context, notify_subscribers, NULL);
+
+    ret = ulog_get_last(context, &watched);
+    if (ret)
+	return ret;
+    if (verto_add_timeout(vctx, VERTO_EV_FLAG_PERSIST, watch_ulog,
+			  ULOG_WATCH_INTERVAL) == NULL)
+	return ENOMEM;
+    return 0;
+}
+
 kdb_incr_result_t *
 iprop_get_updates_1_svc(kdb_last_t *arg, struct svc_req *rqstp)
 {
@@ -190,6 +340,8 @@ iprop_get_updates_1_svc(kdb_last_t *arg, struct svc_req *rqstp)
 	goto out;
     }
 
+    add_subscriber(rqstp->rq_xprt);
+
     kret = ulog_get_entries(handle->context, arg, &ret);
 
     if (ret.ret == UPDATE_OK) {
@@ -334,7 +486,10 @@ ipropx_resync(uint32_t vers, struct svc_req *rqstp)
      * ulog.  This allows us to share a single global dump with all
      * slaves, since it's OK to share an older dump, as long as its sno
      * and timestamp are in the ulog (then the slaves can get the
-     * subsequent updates very iprop).
+     * subsequent updates very iprop).  kdb5_util makes the check under
+     * the dump's lock, so when several slaves ask for a resync at once,
+     * one child writes the dump and the others wait for it and then
+     * send the same file, each with its own kprop.
      */
     if (asprintf(&ubuf, "%s -r %s dump -i%d -c %s", kdb5_util,
 		 handle->params.realm, vers, dump_file) < 0) {
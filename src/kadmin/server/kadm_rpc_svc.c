@@ -254,13 +254,26 @@ void kadm_1(rqstp, transp)
 	  svcerr_noproc(transp);
 	  return;
      }
+     switch (rqstp->rq_proc) {
+     case GET_PRINCIPAL:
+     case GET_PRINCS:
+     case GET_POLICY:
+     case GET_STRINGS:
+	  /* Read-only; may be processed on a worker thread. */
+	  if (workers_submit(rqstp, transp, xdr_argument, xdr_result, local,
+			     sizeof(argument), sizeof(result)))
+	       return;
+	  break;
+     }
      memset(&argument, 0, sizeof(argument));
      if (!svc_getargs(transp, xdr_argument, &argument)) {
 	  svcerr_decode(transp);
 	  return;
      }
      memset(&result, 0, sizeof(result));
+     workers_lock();
      retval = (*local)(&argument, &result, rqstp);
+     workers_unlock();
      if (retval && !svc_sendreply(transp, xdr_result, (void *)&result)) {
 	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to send function results, "
 		 "continuing.");
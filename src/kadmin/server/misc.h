@@ -55,6 +55,26 @@ void log_badauth(OM_uint32 major, OM_uint32 minor, SVCXPRT *xprt, char *data);
 
 const char *client_addr(SVCXPRT *xprt);
 
+/* workers.c */
+krb5_error_code
+workers_init(verto_ctx *vctx, int nworkers, kadm5_config_params *params,
+             char **db_args);
+
+bool_t
+workers_submit(struct svc_req *rqstp, SVCXPRT *transp, xdrproc_t xdr_argument,
+               xdrproc_t xdr_result, bool_t (*local)(), size_t argsize,
+               size_t resultsize);
+
+void workers_flush(int fd);
+
+void workers_lock(void);
+
+void workers_unlock(void);
+
+void *workers_server_handle(void);
+
+void workers_free(void);
+
 /* network.c */
 #include "net-server.h"
 
@@ -62,6 +82,9 @@ const char *client_addr(SVCXPRT *xprt);
 void
 krb5_iprop_prog_1(struct svc_req *rqstp, SVCXPRT *transp);
 
+krb5_error_code
+iprop_notify_init(verto_ctx *vctx, krb5_context context, krb5_boolean relay);
+
 kadm5_ret_t
 kiprop_get_adm_host_srv_name(krb5_context,
                              const char *,
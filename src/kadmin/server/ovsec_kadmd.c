@@ -88,6 +88,7 @@ usage()
                       "[-port port-number]\n"
                       "\t\t[-proponly] [-p path-to-kdb5_util] [-F dump-file]\n"
                       "\t\t[-K path-to-kprop] [-k kprop-port] [-P pid_file]\n"
+                      "\t\t[-w numworkers]\n"
                       "\nwhere,\n\t[-x db_args]* - any number of database "
                       "specific arguments.\n"
                       "\t\t\tLook at each database documentation for "
@@ -357,6 +358,7 @@ main(int argc, char *argv[])
     const char *pid_file = NULL;
     char **db_args = NULL, **tmpargs;
     int ret, i, db_args_size = 0, strong_random = 1, proponly = 0;
+    int nworkers = 0;
 
     setlocale(LC_ALL, "");
     setvbuf(stderr, NULL, _IONBF, 0);
@@ -440,6 +442,11 @@ main(int argc, char *argv[])
             if (!argc)
                 usage();
             kprop_port = *argv;
+        } else if (strcmp(*argv, "-w") == 0) {
+            argc--, argv++;
+            if (!argc)
+                usage();
+            nworkers = atoi(*argv);
         } else {
             break;
         }
@@ -449,6 +456,11 @@ main(int argc, char *argv[])
     if (argc != 0)
         usage();
 
+    if (nworkers > 0 && params.mkey_from_kbd) {
+        fprintf(stderr, _("%s: -w cannot be used with -m\n"), progname);
+        exit(1);
+    }
+
     ret = kadm5_init_krb5_context(&context);
     if (ret) {
         fprintf(stderr, _("%s: %s while initializing context, aborting\n"),
@@ -528,6 +540,9 @@ main(int argc, char *argv[])
         ret = ulog_map(context, params.iprop_logfile, params.iprop_ulogsize);
         if (ret)
             fail_to_start(ret, _("mapping update log"));
+        ret = iprop_notify_init(vctx, context, proponly);
+        if (ret)
+            fail_to_start(ret, _("setting up update notifications"));
 
         if (nofork) {
             fprintf(stderr,
@@ -539,6 +554,12 @@ main(int argc, char *argv[])
     if (kprop_port == NULL)
         kprop_port = getenv("KPROP_PORT");
 
+    /* Worker threads are started after daemon() so that they belong to the
+     * daemon process. */
+    ret = workers_init(vctx, nworkers, &params, db_args);
+    if (ret)
+        fail_to_start(ret, _("starting worker threads"));
+
     krb5_klog_syslog(LOG_INFO, _("starting"));
     if (nofork)
         fprintf(stderr, _("%s: starting...\n"), progname);
@@ -547,6 +568,7 @@ main(int argc, char *argv[])
     krb5_klog_syslog(LOG_INFO, _("finished, exiting"));
 
     /* Clean up memory, etc */
+    workers_free();
     svcauth_gssapi_unset_names();
     kadm5_destroy(global_server_handle);
     loop_free(vctx);
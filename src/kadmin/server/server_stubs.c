@@ -19,7 +19,6 @@
 
 extern gss_name_t                       gss_changepw_name;
 extern gss_name_t                       gss_oldchangepw_name;
-extern void *                           global_server_handle;
 
 #define CHANGEPW_SERVICE(rqstp)                                         \
     (cmp_gss_names_rel_1(acceptor_name(rqstp->rq_svccred), gss_changepw_name) | \
@@ -114,7 +113,7 @@ static kadm5_ret_t new_server_handle(krb5_ui_4 api_version,
            malloc(sizeof(*handle))))
         return ENOMEM;
 
-    *handle = *(kadm5_server_handle_t)global_server_handle;
+    *handle = *(kadm5_server_handle_t)workers_server_handle();
     handle->api_version = api_version;
 
     if (! gss_to_krb5_name(handle, rqst2name(rqstp),
@@ -143,24 +142,32 @@ static void free_server_handle(kadm5_server_handle_t handle)
     free(handle);
 }
 
-/* Result is stored in a static buffer and is invalidated by the next call. */
-const char *
-client_addr(SVCXPRT *xprt)
+/* Format the address of xprt's peer into buf, or return "(unknown)". */
+static const char *
+format_client_addr(SVCXPRT *xprt, char *buf, size_t len)
 {
-    static char abuf[128];
     struct sockaddr_storage ss;
-    socklen_t len = sizeof(ss);
+    socklen_t sslen = sizeof(ss);
     const char *p = NULL;
 
-    if (getpeername(xprt->xp_sock, ss2sa(&ss), &len) != 0)
+    if (getpeername(xprt->xp_sock, ss2sa(&ss), &sslen) != 0)
         return "(unknown)";
     if (ss2sa(&ss)->sa_family == AF_INET)
-        p = inet_ntop(AF_INET, &ss2sin(&ss)->sin_addr, abuf, sizeof(abuf));
+        p = inet_ntop(AF_INET, &ss2sin(&ss)->sin_addr, buf, len);
     else if (ss2sa(&ss)->sa_family == AF_INET6)
-        p = inet_ntop(AF_INET6, &ss2sin6(&ss)->sin6_addr, abuf, sizeof(abuf));
+        p = inet_ntop(AF_INET6, &ss2sin6(&ss)->sin6_addr, buf, len);
     return (p == NULL) ? "(unknown)" : p;
 }
 
+/* Result is stored in a static buffer and is invalidated by the next call. */
+const char *
+client_addr(SVCXPRT *xprt)
+{
+    static char abuf[128];
+
+    return format_client_addr(xprt, abuf, sizeof(abuf));
+}
+
 /*
  * Function: setup_gss_names
  *
@@ -329,7 +336,7 @@ log_unauth(
     struct svc_req *rqstp)
 {
     size_t tlen, clen, slen;
-    char *tdots, *cdots, *sdots;
+    char *tdots, *cdots, *sdots, abuf[128];
 
     tlen = strlen(target);
     trunc_name(&tlen, &tdots);
@@ -345,7 +352,8 @@ log_unauth(
                             op, (int)tlen, target, tdots,
                             (int)clen, (char *)client->value, cdots,
                             (int)slen, (char *)server->value, sdots,
-                            client_addr(rqstp->rq_xprt));
+                            format_client_addr(rqstp->rq_xprt, abuf,
+                                               sizeof(abuf)));
 }
 
 static int
@@ -358,7 +366,7 @@ log_done(
     struct svc_req *rqstp)
 {
     size_t tlen, clen, slen;
-    char *tdots, *cdots, *sdots;
+    char *tdots, *cdots, *sdots, abuf[128];
 
     if (errmsg == NULL)
         errmsg = _("success");
@@ -376,7 +384,8 @@ log_done(
                             op, (int)tlen, target, tdots, errmsg,
                             (int)clen, (char *)client->value, cdots,
                             (int)slen, (char *)server->value, sdots,
-                            client_addr(rqstp->rq_xprt));
+                            format_client_addr(rqstp->rq_xprt, abuf,
+                                               sizeof(abuf)));
 }
 
 bool_t
@@ -0,0 +1,500 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kadmin/server/workers.c - Worker threads for read-only kadmin requests */
+/*
+ * Copyright (C) 2017 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * When enabled with the -w option, kadmind runs the read-only RPC procedures
+ * (GET_PRINCIPAL, GET_PRINCS, GET_POLICY and GET_STRINGS) on a pool of worker
+ * threads, so that a slow listing or lookup does not hold up other clients.
+ * Each worker has its own krb5 context and kadm5 server handle, and therefore
+ * its own database handle.  The writes are still performed on the main loop.
+ * The KDB lock cannot be relied upon to order them against the workers' reads
+ * in the same process, since it falls back to per-process POSIX locks where
+ * OFD locks are not available, so the main loop waits for the workers to
+ * finish their current reads before performing a request itself (see
+ * workers_lock()).
+ *
+ * Arguments are decoded and replies are sent on the main loop thread, which
+ * owns the RPC transports.  A transport only holds the state of the call most
+ * recently read from it, so the main loop must send the reply to a call on a
+ * connection before reading anything more from it; net-server calls
+ * workers_flush() for this purpose.
+ */
+
+#include "k5-int.h"
+#include <gssrpc/rpc.h>
+#include <kadm5/admin.h>
+#include <kadm5/server_internal.h>
+#include <adm_proto.h>
+#include <syslog.h>
+#include "misc.h"
+
+extern void *global_server_handle;
+
+#ifdef ENABLE_THREADS
+
+/* Maximum number of requests queued or in progress per worker thread.  When
+ * the pool is this busy, further requests are processed inline. */
+#define WORKER_QUEUE_DEPTH 16
+
+struct rpc_job {
+    struct rpc_job *next;       /* next in the queue or the done list */
+    struct svc_req rqst;        /* copy of the dispatched request */
+    SVCXPRT *xprt;
+    xdrproc_t xdr_argument;
+    xdrproc_t xdr_result;
+    bool_t (*local)();
+    void *argument;
+    void *result;
+    bool_t retval;
+    int done;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t db_cond = PTHREAD_COND_INITIALIZER;
+static pthread_key_t handle_key;
+static int nthreads, shutdown_pool;
+static int readers, writing;
+static pthread_t *threads;
+static krb5_context *contexts;
+static void **handles;
+static struct rpc_job *queue, **queue_tail = &queue;
+static struct rpc_job *done;
+static int notify[2] = { -1, -1 };
+static verto_ev *notify_ev;
+
+/* The unfinished job for each RPC connection, indexed by descriptor.  Only
+ * used by the main loop thread. */
+static struct rpc_job *busy[FD_SETSIZE];
+static unsigned int pending;
+
+static void
+free_job(struct rpc_job *job)
+{
+    free(job->argument);
+    free(job->result);
+    free(job);
+}
+
+/* Send the reply for a completed job and free it. */
+static void
+finish_job(struct rpc_job *job)
+{
+    SVCXPRT *xprt = job->xprt;
+
+    busy[xprt->xp_sock] = NULL;
+    pending--;
+
+    if (job->retval &&
+        !svc_sendreply(xprt, job->xdr_result, job->result)) {
+        krb5_klog_syslog(LOG_ERR, _("WARNING! Unable to send function "
+                                    "results, continuing."));
+        svcerr_systemerr(xprt);
+    }
+    if (!svc_freeargs(xprt, job->xdr_argument, job->argument)) {
+        krb5_klog_syslog(LOG_ERR, _("WARNING! Unable to free arguments, "
+                                    "continuing."));
+    }
+    if (!svc_freeargs(xprt, job->xdr_result, job->result)) {
+        krb5_klog_syslog(LOG_ERR, _("WARNING! Unable to free results, "
+                                    "continuing."));
+    }
+    free_job(job);
+}
+
+/* Wait until the main loop is not processing a request itself, and register
+ * as a reader.  Called with pool_lock held. */
+static void
+read_lock(void)
+{
+    while (writing)
+        pthread_cond_wait(&db_cond, &pool_lock);
+    readers++;
+}
+
+/* Called with pool_lock held. */
+static void
+read_unlock(void)
+{
+    if (--readers == 0)
+        pthread_cond_broadcast(&db_cond);
+}
+
+static void *
+worker_main(void *ptr)
+{
+    struct rpc_job *job;
+
+    (void)pthread_setspecific(handle_key, ptr);
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (!shutdown_pool && queue == NULL)
+            pthread_cond_wait(&queue_cond, &pool_lock);
+        if (shutdown_pool)
+            break;
+        job = queue;
+        queue = job->next;
+        if (queue == NULL)
+            queue_tail = &queue;
+        read_lock();
+        pthread_mutex_unlock(&pool_lock);
+
+        job->retval = (*job->local)(job->argument, job->result, &job->rqst);
+
+        pthread_mutex_lock(&pool_lock);
+        read_unlock();
+        job->done = 1;
+        job->next = done;
+        done = job;
+        pthread_cond_broadcast(&done_cond);
+        /* If the pipe is full, the loop has not yet drained it and will see
+         * this job anyway. */
+        (void)write(notify[1], "", 1);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+/* Send the replies for the jobs completed by the worker threads. */
+static void
+done_cb(verto_ctx *vctx, verto_ev *ev)
+{
+    struct rpc_job *job, *next;
+    char buf[64];
+
+    while (read(notify[0], buf, sizeof(buf)) > 0);
+
+    pthread_mutex_lock(&pool_lock);
+    job = done;
+    done = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    for (; job != NULL; job = next) {
+        next = job->next;
+        finish_job(job);
+    }
+}
+
+void
+workers_flush(int fd)
+{
+    struct rpc_job *job, **jp;
+
+    if (fd < 0 || fd >= FD_SETSIZE || busy[fd] == NULL)
+        return;
+    job = busy[fd];
+
+    pthread_mutex_lock(&pool_lock);
+    while (!job->done)
+        pthread_cond_wait(&done_cond, &pool_lock);
+    for (jp = &done; *jp != job; jp = &(*jp)->next);
+    *jp = job->next;
+    pthread_mutex_unlock(&pool_lock);
+
+    finish_job(job);
+}
+
+bool_t
+workers_submit(struct svc_req *rqstp, SVCXPRT *transp, xdrproc_t xdr_argument,
+               xdrproc_t xdr_result, bool_t (*local)(), size_t argsize,
+               size_t resultsize)
+{
+    struct rpc_job *job;
+
+    /* Only RPCSEC_GSS keeps the transport's authentication state after the
+     * dispatch function returns, which is needed to send the reply. */
+    if (nthreads == 0 || rqstp->rq_cred.oa_flavor != RPCSEC_GSS ||
+        pending >= (unsigned int)nthreads * WORKER_QUEUE_DEPTH)
+        return FALSE;
+
+    job = calloc(1, sizeof(*job));
+    if (job == NULL)
+        return FALSE;
+    job->argument = calloc(1, argsize);
+    job->result = calloc(1, resultsize);
+    if (job->argument == NULL || job->result == NULL) {
+        free_job(job);
+        return FALSE;
+    }
+    job->rqst = *rqstp;
+    job->xprt = transp;
+    job->xdr_argument = xdr_argument;
+    job->xdr_result = xdr_result;
+    job->local = local;
+
+    if (!svc_getargs(transp, xdr_argument, job->argument)) {
+        svcerr_decode(transp);
+        free_job(job);
+        return TRUE;
+    }
+
+    busy[transp->xp_sock] = job;
+    pending++;
+
+    /* If the client has already sent another call, it will be read as soon as
+     * we return, so process this one now. */
+    if (SVC_STAT(transp) != XPRT_IDLE) {
+        workers_lock();
+        job->retval = (*local)(job->argument, job->result, rqstp);
+        workers_unlock();
+        finish_job(job);
+        return TRUE;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    *queue_tail = job;
+    queue_tail = &job->next;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&pool_lock);
+    return TRUE;
+}
+
+/*
+ * Wait for the worker threads to finish their current requests and keep them
+ * from starting new ones, so that the main loop can access the database.  New
+ * requests are held back as soon as the main loop starts waiting, so that a
+ * steady stream of read-only requests cannot delay it indefinitely.
+ */
+void
+workers_lock(void)
+{
+    if (nthreads == 0)
+        return;
+    pthread_mutex_lock(&pool_lock);
+    writing = 1;
+    while (readers > 0)
+        pthread_cond_wait(&db_cond, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void
+workers_unlock(void)
+{
+    if (nthreads == 0)
+        return;
+    pthread_mutex_lock(&pool_lock);
+    writing = 0;
+    pthread_cond_broadcast(&db_cond);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void *
+workers_server_handle(void)
+{
+    void *handle = NULL;
+
+    if (nthreads > 0)
+        handle = pthread_getspecific(handle_key);
+    return (handle != NULL) ? handle : global_server_handle;
+}
+
+void
+workers_free(void)
+{
+    struct rpc_job *job, *next;
+    int i;
+
+    if (threads == NULL)
+        return;
+
+    pthread_mutex_lock(&pool_lock);
+    shutdown_pool = 1;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&pool_lock);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    /* Discard any unfinished jobs without replying. */
+    for (job = queue; job != NULL; job = next) {
+        next = job->next;
+        free_job(job);
+    }
+    for (job = done; job != NULL; job = next) {
+        next = job->next;
+        free_job(job);
+    }
+    queue = done = NULL;
+    queue_tail = &queue;
+    memset(busy, 0, sizeof(busy));
+    pending = 0;
+
+    for (i = 0; handles != NULL && i < nthreads; i++) {
+        if (handles[i] != NULL)
+            kadm5_destroy(handles[i]);
+        if (contexts[i] != NULL)
+            krb5_free_context(contexts[i]);
+    }
+    if (notify_ev != NULL)
+        verto_del(notify_ev);
+    if (notify[0] != -1) {
+        close(notify[0]);
+        close(notify[1]);
+    }
+    free(threads);
+    free(handles);
+    free(contexts);
+    threads = NULL;
+    handles = NULL;
+    contexts = NULL;
+    notify_ev = NULL;
+    notify[0] = notify[1] = -1;
+    nthreads = 0;
+}
+
+krb5_error_code
+workers_init(verto_ctx *vctx, int nworkers, kadm5_config_params *params,
+             char **db_args)
+{
+    krb5_error_code ret;
+    int i, flags;
+
+    if (nworkers <= 0)
+        return 0;
+
+    ret = pthread_key_create(&handle_key, NULL);
+    if (ret)
+        return ret;
+
+    threads = k5calloc(nworkers, sizeof(*threads), &ret);
+    if (threads == NULL)
+        goto error;
+    contexts = k5calloc(nworkers, sizeof(*contexts), &ret);
+    if (contexts == NULL)
+        goto error;
+    handles = k5calloc(nworkers, sizeof(*handles), &ret);
+    if (handles == NULL)
+        goto error;
+
+    if (pipe(notify) == -1) {
+        ret = errno;
+        notify[0] = notify[1] = -1;
+        goto error;
+    }
+    for (i = 0; i < 2; i++) {
+        set_cloexec_fd(notify[i]);
+        flags = fcntl(notify[i], F_GETFL);
+        (void)fcntl(notify[i], F_SETFL, flags | O_NONBLOCK);
+    }
+    notify_ev = verto_add_io(vctx, VERTO_EV_FLAG_PERSIST |
+                             VERTO_EV_FLAG_IO_READ, done_cb, notify[0]);
+    if (notify_ev == NULL) {
+        ret = ENOMEM;
+        goto error;
+    }
+
+    /* Give each worker its own context and database handle, opened the same
+     * way as the main one. */
+    for (i = 0; i < nworkers; i++) {
+        ret = kadm5_init_krb5_context(&contexts[i]);
+        if (ret)
+            goto error;
+        ret = kadm5_init(contexts[i], "kadmind", NULL, NULL, params,
+                         KADM5_STRUCT_VERSION, KADM5_API_VERSION_4, db_args,
+                         &handles[i]);
+        if (ret)
+            goto error;
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        ret = pthread_create(&threads[i], NULL, worker_main, handles[i]);
+        if (ret)
+            goto error;
+        nthreads++;
+    }
+
+    loop_set_rpc_flush(workers_flush);
+    return 0;
+
+error:
+    /* Account for the handles of workers which were not started. */
+    if (handles != NULL) {
+        for (i = nthreads; i < nworkers; i++) {
+            if (handles[i] != NULL)
+                kadm5_destroy(handles[i]);
+            if (contexts[i] != NULL)
+                krb5_free_context(contexts[i]);
+            handles[i] = NULL;
+            contexts[i] = NULL;
+        }
+    }
+    if (threads == NULL)
+        return ret;
+    workers_free();
+    return ret;
+}
+
+#else /* !ENABLE_THREADS */
+
+void
+workers_flush(int fd)
+{
+}
+
+bool_t
+workers_submit(struct svc_req *rqstp, SVCXPRT *transp, xdrproc_t xdr_argument,
+               xdrproc_t xdr_result, bool_t (*local)(), size_t argsize,
+               size_t resultsize)
+{
+    return FALSE;
+}
+
+void
+workers_lock(void)
+{
+}
+
+void
+workers_unlock(void)
+{
+}
+
+void *
+workers_server_handle(void)
+{
+    return global_server_handle;
+}
+
+void
+workers_free(void)
+{
+}
+
+krb5_error_code
+workers_init(verto_ctx *vctx, int nworkers, kadm5_config_params *params,
+             char **db_args)
+{
+    return (nworkers > 0) ? ENOTSUP : 0;
+}
+
+#endif /* ENABLE_THREADS */
@@ -205,6 +205,7 @@ struct bind_address {
 
 static SET(verto_ev *) events;
 static SET(struct bind_address) bind_addresses;
+static void (*rpc_flush)(int fd);
 
 verto_ctx *
 loop_init(verto_ev_type types)
@@ -488,6 +489,11 @@ free_socket(verto_ctx *ctx, verto_ev *ev)
     fd = verto_get_fd(ev);
     conn = verto_get_private(ev);
 
+    /* Send any reply still pending before the RPC transport goes away. */
+    if (fd >= 0 && conn != NULL && conn->type == CONN_RPC &&
+        conn->rpc_force_close && rpc_flush != NULL)
+        rpc_flush(fd);
+
     /* Close the file descriptor. */
     krb5_klog_syslog(LOG_INFO, _("closing down fd %d"), fd);
     if (fd >= 0 && (!conn || conn->type != CONN_RPC || conn->rpc_force_close))
@@ -1436,6 +1442,12 @@ process_tcp_connection_write(verto_ctx *ctx, verto_ev *ev)
     verto_del(ev);
 }
 
+void
+loop_set_rpc_flush(void (*flush)(int fd))
+{
+    rpc_flush = flush;
+}
+
 void
 loop_free(verto_ctx *ctx)
 {
@@ -1548,6 +1560,9 @@ process_rpc_connection(verto_ctx *ctx, verto_ev *ev)
 {
     fd_set fds;
 
+    if (rpc_flush != NULL)
+        rpc_flush(verto_get_fd(ev));
+
     FD_ZERO(&fds);
     FD_SET(verto_get_fd(ev), &fds);
     svc_getreqset(&fds);
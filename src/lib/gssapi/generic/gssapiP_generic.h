@@ -174,8 +174,14 @@ OM_uint32 g_display_com_err_status (OM_uint32 *minor_status,
                                     OM_uint32 status_value,
                                     gss_buffer_t status_string);
 
+/* The default and maximum number of sequence numbers tracked for replay
+ * detection. */
+#define G_SEQSTATE_DEFAULT_WINDOW 64
+#define G_SEQSTATE_MAX_WINDOW (1024 * 1024)
+
 long g_seqstate_init(g_seqnum_state *state_out, uint64_t seqnum,
-                     int do_replay, int do_sequence, int wide);
+                     int do_replay, int do_sequence, int wide,
+                     uint64_t window);
 OM_uint32 g_seqstate_check(g_seqnum_state state, uint64_t seqnum);
 void g_seqstate_free(g_seqnum_state state);
 void g_seqstate_size(g_seqnum_state state, size_t *sizep);
@@ -366,6 +366,51 @@ OM_uint32 KRB5_CALLCONV gss_verify_mic_iov
     gss_iov_buffer_desc *, /* iov */
     int);		/* iov_count */
 
+/*
+ * One message within a batch per-message call.  iov and iov_count are inputs
+ * laid out as for gss_wrap_iov() or gss_unwrap_iov(); the remaining fields are
+ * outputs describing the result for this message.  qop_state is only set by
+ * gss_unwrap_iov_batch().
+ */
+typedef struct gss_iov_msg_desc_struct {
+    gss_iov_buffer_desc *iov;
+    int iov_count;
+    int conf_state;
+    gss_qop_t qop_state;
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
+} gss_iov_msg_desc, *gss_iov_msg_t;
+
+/*
+ * Wrap msg_count messages under one context.  Messages are processed in array
+ * order, so sequence numbers are assigned in that order.  Each message's
+ * result is stored in its major_status and minor_status fields; a failure for
+ * one message does not prevent processing of the rest.  The return value is
+ * GSS_S_COMPLETE if every message was wrapped, or the major status of the
+ * first message which failed.
+ */
+OM_uint32 KRB5_CALLCONV gss_wrap_iov_batch
+(
+    OM_uint32 *,	/* minor_status */
+    gss_ctx_id_t,	/* context_handle */
+    int,		/* conf_req_flag */
+    gss_qop_t,		/* qop_req */
+    gss_iov_msg_desc *, /* msgs */
+    int);		/* msg_count */
+
+/*
+ * Unwrap msg_count messages under one context, in array order.  Results are
+ * reported per message as for gss_wrap_iov_batch().  Supplementary status bits
+ * such as GSS_S_DUPLICATE_TOKEN are reported only in the per-message major
+ * status.
+ */
+OM_uint32 KRB5_CALLCONV gss_unwrap_iov_batch
+(
+    OM_uint32 *,	/* minor_status */
+    gss_ctx_id_t,	/* context_handle */
+    gss_iov_msg_desc *, /* msgs */
+    int);		/* msg_count */
+
 /*
  * Release buffers that have the ALLOCATED flag set.
  */
@@ -163,6 +163,83 @@ struct test {
     },
 };
 
+/* Tests for a replay window wider than the default. */
+struct {
+    uint64_t seqnum;
+    enum resultcode result;
+} wide_window_seqs[] = {
+    /* With a window of 1000 (rounded up to 1024), seqnums up to 1024 behind
+     * the expected next seqnum can be checked for replays. */
+    { 2000, NOERR }, { 977, NOERR }, { 976, OLD }, { 1500, NOERR },
+    { 1500, REPLAY }, { 977, REPLAY },
+    /* A large jump forward clears the whole window. */
+    { 5000, NOERR }, { 1500, OLD }, { 4000, NOERR }, { 4000, REPLAY },
+    { 3977, NOERR },
+    /* 5024 uses the same bitmap slot as 4000, which must be cleared as the
+     * window moves past it. */
+    { 5100, NOERR }, { 5024, NOERR }, { 5024, REPLAY }, { 4076, OLD },
+    { 4077, NOERR }
+};
+
+static void
+check_seqs(g_seqnum_state seqstate, size_t start, size_t end)
+{
+    size_t i;
+    OM_uint32 status;
+
+    for (i = start; i < end; i++) {
+        status = g_seqstate_check(seqstate, wide_window_seqs[i].seqnum);
+        if (status != wide_window_seqs[i].result) {
+            fprintf(stderr, "Wide window seq %d failed: %d != %d\n",
+                    (int)i, status, wide_window_seqs[i].result);
+            exit(1);
+        }
+    }
+}
+
+static void
+test_wide_window()
+{
+    g_seqnum_state seqstate, copy;
+    size_t n = sizeof(wide_window_seqs) / sizeof(*wide_window_seqs);
+    size_t len = 0, remain;
+    unsigned char *buf, *bp;
+
+    if (g_seqstate_init(&seqstate, 0, DO_REPLAY, NO_SEQUENCE, WIDE, 1000))
+        abort();
+    check_seqs(seqstate, 0, n / 2);
+
+    /* Check that the window survives serialization. */
+    g_seqstate_size(seqstate, &len);
+    buf = malloc(len);
+    if (buf == NULL)
+        abort();
+    bp = buf;
+    remain = len;
+    if (g_seqstate_externalize(seqstate, &bp, &remain) || remain != 0)
+        abort();
+
+    /* The token holds the flags, base, next and window fields and the
+     * bitmap, independent of the structure layout. */
+    if (len != 4 + 3 * 8 + 1024 / 8 || load_32_be(buf) != 0x5 ||
+        load_64_be(buf + 20) != 1024)
+        abort();
+    bp = buf;
+    remain = len - 1;
+    if (g_seqstate_internalize(&copy, &bp, &remain) != EINVAL)
+        abort();
+
+    bp = buf;
+    remain = len;
+    if (g_seqstate_internalize(&copy, &bp, &remain) || remain != 0)
+        abort();
+    g_seqstate_free(seqstate);
+    free(buf);
+
+    check_seqs(copy, n / 2, n);
+    g_seqstate_free(copy);
+}
+
 int
 main()
 {
@@ -179,7 +256,7 @@ main()
             if (t->wide_seqnums != BOTH && t->wide_seqnums != w)
                 continue;
             if (g_seqstate_init(&seqstate, t->initial, t->do_replay,
-                                t->do_sequence, w))
+                                t->do_sequence, w, G_SEQSTATE_DEFAULT_WINDOW))
                 abort();
             for (j = 0; j < t->nseqs; j++) {
                 status = g_seqstate_check(seqstate, t->seqs[j].seqnum);
@@ -193,5 +270,6 @@ main()
         }
     }
 
+    test_wide_window();
     return 0;
 }
@@ -51,19 +51,69 @@ struct g_seqnum_state_st {
      * seen sequence number), relative to base. */
     uint64_t next;
 
+    /* The number of sequence numbers prior to next which are tracked for
+     * replay detection.  Always a power of two and at least 64, so that it
+     * evenly divides the sequence number space. */
+    uint64_t window;
+
     /*
-     * A bitmap for the 64 sequence numbers prior to next.  If the 1<<(i-1) bit
-     * is set, then we have seen seqnum next-i relative to base.  The least
-     * significant bit is always set if we have received any sequence numbers,
-     * and indicates the highest sequence number we have seen (next-1).  When
-     * we advance next, we shift recvmap to the left.
+     * A ring bitmap of window bits.  The bit for sequence number n (relative
+     * to base) is bit n % 64 of word (n / 64) % (window / 64), and is set if
+     * we have received n.  Only bits for the window sequence numbers prior to
+     * next are meaningful; bits for numbers at or beyond next are cleared as
+     * next advances over them.
      */
-    uint64_t recvmap;
+    uint64_t *recvmap;
 };
 
+/* Return a pointer to the recvmap word for seqnum and set *bit_out to the bit
+ * within that word. */
+static inline uint64_t *
+map_word(g_seqnum_state state, uint64_t seqnum, uint64_t *bit_out)
+{
+    *bit_out = (uint64_t)1 << (seqnum & 63);
+    return &state->recvmap[(seqnum / 64) & (state->window / 64 - 1)];
+}
+
+/* Clear the recvmap bits for count sequence numbers starting at seqnum. */
+static void
+clear_range(g_seqnum_state state, uint64_t seqnum, uint64_t count)
+{
+    uint64_t *word, bit, nbits, mask;
+
+    if (count >= state->window) {
+        memset(state->recvmap, 0, state->window / 8);
+        return;
+    }
+    while (count > 0) {
+        word = map_word(state, seqnum, &bit);
+        nbits = 64 - (seqnum & 63);
+        if (nbits > count)
+            nbits = count;
+        mask = (nbits == 64) ? UINT64_MAX :
+            (((uint64_t)1 << nbits) - 1) << (seqnum & 63);
+        *word &= ~mask;
+        seqnum += nbits;
+        count -= nbits;
+    }
+}
+
+/* Round window up to a power of two between 64 and G_SEQSTATE_MAX_WINDOW. */
+static uint64_t
+round_window(uint64_t window)
+{
+    uint64_t w = 64;
+
+    if (window > G_SEQSTATE_MAX_WINDOW)
+        window = G_SEQSTATE_MAX_WINDOW;
+    while (w < window)
+        w <<= 1;
+    return w;
+}
+
 long
 g_seqstate_init(g_seqnum_state *state_out, uint64_t seqnum, int do_replay,
-                int do_sequence, int wide)
+                int do_sequence, int wide, uint64_t window)
 {
     g_seqnum_state state;
 
@@ -75,7 +125,13 @@ g_seqstate_init(g_seqnum_state *state_out, uint64_t seqnum, int do_replay,
     state->do_sequence = do_sequence;
     state->seqmask = wide ? UINT64_MAX : UINT32_MAX;
     state->base = seqnum;
-    state->next = state->recvmap = 0;
+    state->next = 0;
+    state->window = round_window(window);
+    state->recvmap = calloc(state->window / 64, sizeof(uint64_t));
+    if (state->recvmap == NULL) {
+        free(state);
+        return ENOMEM;
+    }
     *state_out = state;
     return 0;
 }
@@ -83,7 +139,7 @@ g_seqstate_init(g_seqnum_state *state_out, uint64_t seqnum, int do_replay,
 OM_uint32
 g_seqstate_check(g_seqnum_state state, uint64_t seqnum)
 {
-    uint64_t rel_seqnum, offset, bit;
+    uint64_t rel_seqnum, offset, bit, *word;
 
     if (!state->do_replay && !state->do_sequence)
         return GSS_S_COMPLETE;
@@ -92,10 +148,13 @@ g_seqstate_check(g_seqnum_state state, uint64_t seqnum)
     rel_seqnum = (seqnum - state->base) & state->seqmask;
 
     if (rel_seqnum >= state->next) {
-        /* seqnum is the expected sequence number or in the future.  Update the
-         * received bitmap and expected next sequence number. */
+        /* seqnum is the expected sequence number or in the future.  Clear the
+         * bits for the numbers entering the window, mark seqnum as received,
+         * and update the expected next sequence number. */
         offset = rel_seqnum - state->next;
-        state->recvmap = (state->recvmap << (offset + 1)) | 1;
+        clear_range(state, state->next, offset + 1);
+        word = map_word(state, rel_seqnum, &bit);
+        *word |= bit;
         state->next = (rel_seqnum + 1) & state->seqmask;
 
         return (offset > 0 && state->do_sequence) ? GSS_S_GAP_TOKEN :
@@ -104,14 +163,14 @@ g_seqstate_check(g_seqnum_state state, uint64_t seqnum)
 
     /* seqnum is in the past.  Check if it's too old for replay detection. */
     offset = state->next - rel_seqnum;
-    if (offset > 64)
+    if (offset > state->window)
         return state->do_sequence ? GSS_S_UNSEQ_TOKEN : GSS_S_OLD_TOKEN;
 
     /* Check for replay and mark as received. */
-    bit = (uint64_t)1 << (offset - 1);
-    if (state->do_replay && (state->recvmap & bit))
+    word = map_word(state, rel_seqnum, &bit);
+    if (state->do_replay && (*word & bit))
         return GSS_S_DUPLICATE_TOKEN;
-    state->recvmap |= bit;
+    *word |= bit;
 
     return state->do_sequence ? GSS_S_UNSEQ_TOKEN : GSS_S_COMPLETE;
 }
@@ -119,27 +178,53 @@ g_seqstate_check(g_seqnum_state state, uint64_t seqnum)
 void
 g_seqstate_free(g_seqnum_state state)
 {
+    if (state != NULL)
+        free(state->recvmap);
     free(state);
 }
 
 /*
- * These support functions are for the serialization routines
+ * These support functions are for the serialization routines.  The state is
+ * serialized as a 32-bit word of flags, the base, next and window values as
+ * 64-bit integers, and then the window / 64 recvmap words, all big-endian.
  */
+#define SEQSTATE_REPLAY   0x1
+#define SEQSTATE_SEQUENCE 0x2
+#define SEQSTATE_WIDE     0x4
+#define SEQSTATE_HDRLEN   (4 + 3 * 8)
+
 void
 g_seqstate_size(g_seqnum_state state, size_t *sizep)
 {
-    *sizep += sizeof(*state);
+    *sizep += SEQSTATE_HDRLEN + state->window / 8;
 }
 
 long
 g_seqstate_externalize(g_seqnum_state state, unsigned char **buf,
                        size_t *lenremain)
 {
-    if (*lenremain < sizeof(*state))
+    unsigned char *bp = *buf;
+    size_t maplen = state->window / 8;
+    uint32_t flags = 0;
+    uint64_t i;
+
+    if (*lenremain < SEQSTATE_HDRLEN + maplen)
         return ENOMEM;
-    memcpy(*buf, state, sizeof(*state));
-    *buf += sizeof(*state);
-    *lenremain -= sizeof(*state);
+    if (state->do_replay)
+        flags |= SEQSTATE_REPLAY;
+    if (state->do_sequence)
+        flags |= SEQSTATE_SEQUENCE;
+    if (state->seqmask == UINT64_MAX)
+        flags |= SEQSTATE_WIDE;
+    store_32_be(flags, bp);
+    store_64_be(state->base, bp + 4);
+    store_64_be(state->next, bp + 12);
+    store_64_be(state->window, bp + 20);
+    bp += SEQSTATE_HDRLEN;
+    for (i = 0; i < state->window / 64; i++, bp += 8)
+        store_64_be(state->recvmap[i], bp);
+    *buf = bp;
+    *lenremain -= SEQSTATE_HDRLEN + maplen;
     return 0;
 }
 
@@ -148,16 +233,40 @@ g_seqstate_internalize(g_seqnum_state *state_out, unsigned char **buf,
                        size_t *lenremain)
 {
     g_seqnum_state state;
+    const unsigned char *bp = *buf;
+    uint32_t flags;
+    uint64_t i, window;
+    size_t maplen;
 
     *state_out = NULL;
-    if (*lenremain < sizeof(*state))
+    if (*lenremain < SEQSTATE_HDRLEN)
+        return EINVAL;
+    flags = load_32_be(bp);
+    window = load_64_be(bp + 20);
+    if (window != round_window(window) ||
+        *lenremain - SEQSTATE_HDRLEN < window / 8)
         return EINVAL;
+    maplen = window / 8;
+
     state = malloc(sizeof(*state));
     if (state == NULL)
         return ENOMEM;
-    memcpy(state, *buf, sizeof(*state));
-    *buf += sizeof(*state);
-    *lenremain -= sizeof(*state);
+    state->do_replay = (flags & SEQSTATE_REPLAY) != 0;
+    state->do_sequence = (flags & SEQSTATE_SEQUENCE) != 0;
+    state->seqmask = (flags & SEQSTATE_WIDE) ? UINT64_MAX : UINT32_MAX;
+    state->base = load_64_be(bp + 4) & state->seqmask;
+    state->next = load_64_be(bp + 12) & state->seqmask;
+    state->window = window;
+    state->recvmap = malloc(maplen);
+    if (state->recvmap == NULL) {
+        free(state);
+        return ENOMEM;
+    }
+    bp += SEQSTATE_HDRLEN;
+    for (i = 0; i < window / 64; i++, bp += 8)
+        state->recvmap[i] = load_64_be(bp);
+    *buf += SEQSTATE_HDRLEN + maplen;
+    *lenremain -= SEQSTATE_HDRLEN + maplen;
     *state_out = state;
     return 0;
 }
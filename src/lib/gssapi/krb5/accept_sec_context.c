@@ -980,10 +980,7 @@ kg_accept_krb5(minor_status, context_handle,
         goto fail;
     }
 
-    code = g_seqstate_init(&ctx->seqstate, ctx->seq_recv,
-                           (ctx->gss_flags & GSS_C_REPLAY_FLAG) != 0,
-                           (ctx->gss_flags & GSS_C_SEQUENCE_FLAG) != 0,
-                           ctx->proto);
+    code = kg_init_seqstate(context, ctx);
     if (code) {
         major_status = GSS_S_FAILURE;
         goto fail;
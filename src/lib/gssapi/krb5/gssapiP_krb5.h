@@ -271,6 +271,9 @@ krb5_error_code kg_get_seq_num (krb5_context context,
                                 unsigned char *cksum, unsigned char *buf, int *direction,
                                 krb5_ui_4 *seqnum);
 
+krb5_error_code kg_init_seqstate(krb5_context context,
+                                 krb5_gss_ctx_id_rec *ctx);
+
 krb5_error_code kg_make_seed (krb5_context context,
                               krb5_key key,
                               unsigned char *seed);
@@ -777,6 +780,15 @@ OM_uint32 KRB5_CALLCONV krb5_gss_wrap_iov
  int                        /* iov_count */
 );
 
+OM_uint32 KRB5_CALLCONV krb5_gss_wrap_iov_batch
+(OM_uint32 *,           /* minor_status */
+ gss_ctx_id_t,              /* context_handle */
+ int,                       /* conf_req_flag */
+ gss_qop_t,                 /* qop_req */
+ gss_iov_msg_desc *,        /* msgs */
+ int                        /* msg_count */
+);
+
 OM_uint32 KRB5_CALLCONV krb5_gss_wrap_iov_length
 (OM_uint32 *,           /* minor_status */
  gss_ctx_id_t,              /* context_handle */
@@ -805,6 +817,13 @@ OM_uint32 KRB5_CALLCONV krb5_gss_unwrap_iov
  int                        /* iov_count */
 );
 
+OM_uint32 KRB5_CALLCONV krb5_gss_unwrap_iov_batch
+(OM_uint32 *,           /* minor_status */
+ gss_ctx_id_t,              /* context_handle */
+ gss_iov_msg_desc *,        /* msgs */
+ int                        /* msg_count */
+);
+
 OM_uint32 KRB5_CALLCONV krb5_gss_wrap_size_limit
 (OM_uint32 *,           /* minor_status */
  gss_ctx_id_t,               /* context_handle */
@@ -1386,6 +1405,17 @@ iakerb_gss_unwrap_iov(OM_uint32 *minor_status, gss_ctx_id_t context_handle,
                       int *conf_state, gss_qop_t *qop_state,
                       gss_iov_buffer_desc *iov, int iov_count);
 
+OM_uint32 KRB5_CALLCONV
+iakerb_gss_wrap_iov_batch(OM_uint32 *minor_status,
+                          gss_ctx_id_t context_handle, int conf_req_flag,
+                          gss_qop_t qop_req, gss_iov_msg_desc *msgs,
+                          int msg_count);
+
+OM_uint32 KRB5_CALLCONV
+iakerb_gss_unwrap_iov_batch(OM_uint32 *minor_status,
+                            gss_ctx_id_t context_handle,
+                            gss_iov_msg_desc *msgs, int msg_count);
+
 OM_uint32 KRB5_CALLCONV
 iakerb_gss_wrap_size_limit(OM_uint32 *minor_status,
                            gss_ctx_id_t context_handle, int conf_req_flag,
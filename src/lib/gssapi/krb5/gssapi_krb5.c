@@ -931,6 +931,8 @@ static struct gss_config krb5_mechanism = {
     krb5_gss_get_mic_iov,
     krb5_gss_verify_mic_iov,
     krb5_gss_get_mic_iov_length,
+    krb5_gss_wrap_iov_batch,
+    krb5_gss_unwrap_iov_batch,
 };
 
 /* Functions which use security contexts or acquire creds are IAKERB-specific;
@@ -1023,6 +1025,8 @@ static struct gss_config iakerb_mechanism = {
     iakerb_gss_get_mic_iov,
     iakerb_gss_verify_mic_iov,
     iakerb_gss_get_mic_iov_length,
+    iakerb_gss_wrap_iov_batch,
+    iakerb_gss_unwrap_iov_batch,
 };
 
 #ifdef _GSS_STATIC_LINK
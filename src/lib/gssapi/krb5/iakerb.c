@@ -1257,6 +1257,35 @@ iakerb_gss_unwrap_iov(OM_uint32 *minor_status, gss_ctx_id_t context_handle,
                                iov, iov_count);
 }
 
+OM_uint32 KRB5_CALLCONV
+iakerb_gss_wrap_iov_batch(OM_uint32 *minor_status,
+                          gss_ctx_id_t context_handle, int conf_req_flag,
+                          gss_qop_t qop_req, gss_iov_msg_desc *msgs,
+                          int msg_count)
+{
+    iakerb_ctx_id_t ctx = (iakerb_ctx_id_t)context_handle;
+
+    if (ctx->gssc == GSS_C_NO_CONTEXT)
+        return GSS_S_NO_CONTEXT;
+
+    return krb5_gss_wrap_iov_batch(minor_status, ctx->gssc, conf_req_flag,
+                                   qop_req, msgs, msg_count);
+}
+
+OM_uint32 KRB5_CALLCONV
+iakerb_gss_unwrap_iov_batch(OM_uint32 *minor_status,
+                            gss_ctx_id_t context_handle,
+                            gss_iov_msg_desc *msgs, int msg_count)
+{
+    iakerb_ctx_id_t ctx = (iakerb_ctx_id_t)context_handle;
+
+    if (ctx->gssc == GSS_C_NO_CONTEXT)
+        return GSS_S_NO_CONTEXT;
+
+    return krb5_gss_unwrap_iov_batch(minor_status, ctx->gssc, msgs,
+                                     msg_count);
+}
+
 OM_uint32 KRB5_CALLCONV
 iakerb_gss_wrap_iov_length(OM_uint32 *minor_status,
                            gss_ctx_id_t context_handle, int conf_req_flag,
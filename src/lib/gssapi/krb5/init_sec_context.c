@@ -647,10 +647,7 @@ kg_new_connection(
     if (!(ctx->gss_flags & GSS_C_MUTUAL_FLAG)) {
         /* There will be no AP-REP, so set up sequence state now. */
         ctx->seq_recv = ctx->seq_send;
-        code = g_seqstate_init(&ctx->seqstate, ctx->seq_recv,
-                               (ctx->gss_flags & GSS_C_REPLAY_FLAG) != 0,
-                               (ctx->gss_flags & GSS_C_SEQUENCE_FLAG) != 0,
-                               ctx->proto);
+        code = kg_init_seqstate(context, ctx);
         if (code != 0)
             goto cleanup;
     }
@@ -823,10 +820,7 @@ mutual_auth(
 
     /* store away the sequence number */
     ctx->seq_recv = ap_rep_data->seq_number;
-    code = g_seqstate_init(&ctx->seqstate, ctx->seq_recv,
-                           (ctx->gss_flags & GSS_C_REPLAY_FLAG) != 0,
-                           (ctx->gss_flags & GSS_C_SEQUENCE_FLAG) != 0,
-                           ctx->proto);
+    code = kg_init_seqstate(context, ctx);
     if (code) {
         krb5_free_ap_rep_enc_part(context, ap_rep_data);
         goto fail;
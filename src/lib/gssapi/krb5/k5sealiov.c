@@ -261,6 +261,30 @@ cleanup:
     return code;
 }
 
+/* Make a token for one message under an established context. */
+static krb5_error_code
+make_seal_token_iov(krb5_context context, krb5_gss_ctx_id_rec *ctx,
+                    int conf_req_flag, int *conf_state,
+                    gss_iov_buffer_desc *iov, int iov_count, int toktype)
+{
+    if (conf_req_flag && kg_integ_only_iov(iov, iov_count)) {
+        /* may be more sensible to return an error here */
+        conf_req_flag = FALSE;
+    }
+
+    switch (ctx->proto) {
+    case 0:
+        return make_seal_token_v1_iov(context, ctx, conf_req_flag,
+                                      conf_state, iov, iov_count, toktype);
+    case 1:
+        return gss_krb5int_make_seal_token_v3_iov(context, ctx, conf_req_flag,
+                                                  conf_state, iov, iov_count,
+                                                  toktype);
+    default:
+        return G_UNKNOWN_QOP;
+    }
+}
+
 OM_uint32
 kg_seal_iov(OM_uint32 *minor_status,
             gss_ctx_id_t context_handle,
@@ -286,26 +310,9 @@ kg_seal_iov(OM_uint32 *minor_status,
         return GSS_S_NO_CONTEXT;
     }
 
-    if (conf_req_flag && kg_integ_only_iov(iov, iov_count)) {
-        /* may be more sensible to return an error here */
-        conf_req_flag = FALSE;
-    }
-
     context = ctx->k5_context;
-    switch (ctx->proto) {
-    case 0:
-        code = make_seal_token_v1_iov(context, ctx, conf_req_flag,
-                                      conf_state, iov, iov_count, toktype);
-        break;
-    case 1:
-        code = gss_krb5int_make_seal_token_v3_iov(context, ctx, conf_req_flag,
-                                                  conf_state, iov, iov_count, toktype);
-        break;
-    default:
-        code = G_UNKNOWN_QOP;
-        break;
-    }
-
+    code = make_seal_token_iov(context, ctx, conf_req_flag, conf_state,
+                               iov, iov_count, toktype);
     if (code != 0) {
         *minor_status = code;
         save_error_info(*minor_status, context);
@@ -508,6 +515,54 @@ krb5_gss_wrap_iov(OM_uint32 *minor_status,
     return major_status;
 }
 
+/*
+ * Wrap a batch of messages.  The context and QOP are checked once for the
+ * whole batch rather than once per message, and each message is sealed in
+ * array order so that sequence numbers are assigned in that order.
+ */
+OM_uint32 KRB5_CALLCONV
+krb5_gss_wrap_iov_batch(OM_uint32 *minor_status,
+                        gss_ctx_id_t context_handle,
+                        int conf_req_flag,
+                        gss_qop_t qop_req,
+                        gss_iov_msg_desc *msgs,
+                        int msg_count)
+{
+    krb5_gss_ctx_id_rec *ctx = (krb5_gss_ctx_id_rec *)context_handle;
+    krb5_context context;
+    krb5_error_code code;
+    gss_iov_msg_desc *m;
+    int i;
+
+    if (qop_req != 0) {
+        *minor_status = (OM_uint32)G_UNKNOWN_QOP;
+        return GSS_S_BAD_QOP;
+    }
+    if (ctx->terminated || !ctx->established) {
+        *minor_status = KG_CTX_INCOMPLETE;
+        return GSS_S_NO_CONTEXT;
+    }
+
+    context = ctx->k5_context;
+    for (i = 0; i < msg_count; i++) {
+        m = &msgs[i];
+        code = make_seal_token_iov(context, ctx, conf_req_flag,
+                                   &m->conf_state, m->iov, m->iov_count,
+                                   KG_TOK_WRAP_MSG);
+        if (code != 0) {
+            m->major_status = GSS_S_FAILURE;
+            m->minor_status = code;
+            save_error_info(code, context);
+        } else {
+            m->major_status = GSS_S_COMPLETE;
+            m->minor_status = 0;
+        }
+    }
+
+    *minor_status = 0;
+    return GSS_S_COMPLETE;
+}
+
 OM_uint32 KRB5_CALLCONV
 krb5_gss_wrap_iov_length(OM_uint32 *minor_status,
                          gss_ctx_id_t context_handle,
@@ -658,6 +658,44 @@ krb5_gss_unwrap_iov(OM_uint32 *minor_status,
     return major_status;
 }
 
+/* Unwrap a batch of messages in array order, checking the context once. */
+OM_uint32 KRB5_CALLCONV
+krb5_gss_unwrap_iov_batch(OM_uint32 *minor_status,
+                          gss_ctx_id_t context_handle,
+                          gss_iov_msg_desc *msgs,
+                          int msg_count)
+{
+    krb5_gss_ctx_id_rec *ctx = (krb5_gss_ctx_id_rec *)context_handle;
+    gss_iov_msg_desc *m;
+    int i;
+
+    if (ctx->terminated || !ctx->established) {
+        *minor_status = KG_CTX_INCOMPLETE;
+        return GSS_S_NO_CONTEXT;
+    }
+
+    for (i = 0; i < msg_count; i++) {
+        m = &msgs[i];
+        if (kg_locate_iov(m->iov, m->iov_count,
+                          GSS_IOV_BUFFER_TYPE_STREAM) != NULL) {
+            m->major_status = kg_unseal_stream_iov(&m->minor_status, ctx,
+                                                   &m->conf_state,
+                                                   &m->qop_state, m->iov,
+                                                   m->iov_count,
+                                                   KG_TOK_WRAP_MSG);
+        } else {
+            m->major_status = kg_unseal_iov_token(&m->minor_status, ctx,
+                                                  &m->conf_state,
+                                                  &m->qop_state, m->iov,
+                                                  m->iov_count,
+                                                  KG_TOK_WRAP_MSG);
+        }
+    }
+
+    *minor_status = 0;
+    return GSS_S_COMPLETE;
+}
+
 OM_uint32 KRB5_CALLCONV
 krb5_gss_verify_mic_iov(OM_uint32 *minor_status,
                         gss_ctx_id_t context_handle,
@@ -100,3 +100,25 @@ krb5_error_code kg_get_seq_num(context, key, cksum, buf, direction, seqnum)
 
     return(0);
 }
+
+/*
+ * Initialize ctx->seqstate to check received sequence numbers starting at
+ * ctx->seq_recv, according to the context flags.  The replay window size comes
+ * from the gss_seq_window libdefaults variable.
+ */
+krb5_error_code
+kg_init_seqstate(krb5_context context, krb5_gss_ctx_id_rec *ctx)
+{
+    int window;
+
+    if (profile_get_integer(context->profile, KRB5_CONF_LIBDEFAULTS,
+                            KRB5_CONF_GSS_SEQ_WINDOW, NULL,
+                            G_SEQSTATE_DEFAULT_WINDOW, &window) != 0 ||
+        window < 0)
+        window = G_SEQSTATE_DEFAULT_WINDOW;
+
+    return g_seqstate_init(&ctx->seqstate, ctx->seq_recv,
+                           (ctx->gss_flags & GSS_C_REPLAY_FLAG) != 0,
+                           (ctx->gss_flags & GSS_C_SEQUENCE_FLAG) != 0,
+                           ctx->proto, window);
+}
@@ -0,0 +1,175 @@
+/* lib/gssapi/mechglue/g_iov_batch.c - Glue for batch per-message calls */
+/*
+ * Copyright (C) 2017 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mglueP.h"
+
+static OM_uint32
+val_batch_args(OM_uint32 *minor_status, gss_ctx_id_t context_handle,
+	       gss_iov_msg_desc *msgs, int msg_count)
+{
+    int i;
+
+    /* Initialize outputs. */
+    if (minor_status != NULL)
+	*minor_status = 0;
+    for (i = 0; msgs != NULL && i < msg_count; i++) {
+	msgs[i].conf_state = 0;
+	msgs[i].qop_state = GSS_C_QOP_DEFAULT;
+	msgs[i].major_status = GSS_S_FAILURE;
+	msgs[i].minor_status = 0;
+    }
+
+    /* Validate arguments. */
+    if (minor_status == NULL)
+	return GSS_S_CALL_INACCESSIBLE_WRITE;
+    if (context_handle == GSS_C_NO_CONTEXT)
+	return GSS_S_CALL_INACCESSIBLE_READ | GSS_S_NO_CONTEXT;
+    if (msgs == NULL || msg_count < 0)
+	return GSS_S_CALL_INACCESSIBLE_READ;
+    for (i = 0; i < msg_count; i++) {
+	if (msgs[i].iov == GSS_C_NO_IOV_BUFFER)
+	    return GSS_S_CALL_INACCESSIBLE_READ;
+    }
+
+    return GSS_S_COMPLETE;
+}
+
+/*
+ * Map the per-message minor codes in msgs and return the status of the first
+ * failed message (or GSS_S_COMPLETE if there were none), setting
+ * *minor_status to its minor code.
+ */
+static OM_uint32
+batch_result(OM_uint32 *minor_status, gss_mechanism mech,
+	     gss_iov_msg_desc *msgs, int msg_count)
+{
+    OM_uint32 status = GSS_S_COMPLETE;
+    int i;
+
+    for (i = 0; i < msg_count; i++) {
+	if (msgs[i].major_status == GSS_S_COMPLETE)
+	    continue;
+	map_error(&msgs[i].minor_status, mech);
+	if (status == GSS_S_COMPLETE && GSS_ERROR(msgs[i].major_status)) {
+	    status = msgs[i].major_status;
+	    *minor_status = msgs[i].minor_status;
+	}
+    }
+    return status;
+}
+
+OM_uint32 KRB5_CALLCONV
+gss_wrap_iov_batch(OM_uint32 *minor_status, gss_ctx_id_t context_handle,
+		   int conf_req_flag, gss_qop_t qop_req,
+		   gss_iov_msg_desc *msgs, int msg_count)
+{
+    OM_uint32 status;
+    gss_union_ctx_id_t ctx;
+    gss_mechanism mech;
+    gss_iov_msg_desc *m;
+    int i;
+
+    status = val_batch_args(minor_status, context_handle, msgs, msg_count);
+    if (status != GSS_S_COMPLETE)
+	return status;
+
+    /* Select the approprate underlying mechanism routine and call it. */
+    ctx = (gss_union_ctx_id_t)context_handle;
+    mech = gssint_get_mechanism(ctx->mech_type);
+    if (mech == NULL)
+	return GSS_S_BAD_MECH;
+    if (mech->gss_wrap_iov_batch != NULL) {
+	status = mech->gss_wrap_iov_batch(minor_status, ctx->internal_ctx_id,
+					  conf_req_flag, qop_req, msgs,
+					  msg_count);
+	if (status != GSS_S_COMPLETE) {
+	    map_error(minor_status, mech);
+	    return status;
+	}
+    } else if (mech->gss_wrap_iov != NULL) {
+	/* Fall back to wrapping the messages one at a time. */
+	for (i = 0; i < msg_count; i++) {
+	    m = &msgs[i];
+	    m->major_status = mech->gss_wrap_iov(&m->minor_status,
+						 ctx->internal_ctx_id,
+						 conf_req_flag, qop_req,
+						 &m->conf_state, m->iov,
+						 m->iov_count);
+	}
+    } else {
+	return GSS_S_UNAVAILABLE;
+    }
+
+    return batch_result(minor_status, mech, msgs, msg_count);
+}
+
+OM_uint32 KRB5_CALLCONV
+gss_unwrap_iov_batch(OM_uint32 *minor_status, gss_ctx_id_t context_handle,
+		     gss_iov_msg_desc *msgs, int msg_count)
+{
+    OM_uint32 status;
+    gss_union_ctx_id_t ctx;
+    gss_mechanism mech;
+    gss_iov_msg_desc *m;
+    int i;
+
+    status = val_batch_args(minor_status, context_handle, msgs, msg_count);
+    if (status != GSS_S_COMPLETE)
+	return status;
+
+    /* Select the approprate underlying mechanism routine and call it. */
+    ctx = (gss_union_ctx_id_t)context_handle;
+    mech = gssint_get_mechanism(ctx->mech_type);
+    if (mech == NULL)
+	return GSS_S_BAD_MECH;
+    if (mech->gss_unwrap_iov_batch != NULL) {
+	status = mech->gss_unwrap_iov_batch(minor_status, ctx->internal_ctx_id,
+					    msgs, msg_count);
+	if (status != GSS_S_COMPLETE) {
+	    map_error(minor_status, mech);
+	    return status;
+	}
+    } else if (mech->gss_unwrap_iov != NULL) {
+	/* Fall back to unwrapping the messages one at a time. */
+	for (i = 0; i < msg_count; i++) {
+	    m = &msgs[i];
+	    m->major_status = mech->gss_unwrap_iov(&m->minor_status,
+						   ctx->internal_ctx_id,
+						   &m->conf_state,
+						   &m->qop_state, m->iov,
+						   m->iov_count);
+	}
+    } else {
+	return GSS_S_UNAVAILABLE;
+    }
+
+    return batch_result(minor_status, mech, msgs, msg_count);
+}
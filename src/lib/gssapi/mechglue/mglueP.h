@@ -702,6 +702,26 @@ typedef struct gss_config {
 	    int				/* iov_count */
 	);
 
+	/* batch per-message extensions, added in 1.16 */
+
+	OM_uint32	(KRB5_CALLCONV *gss_wrap_iov_batch)
+	(
+	    OM_uint32 *,		/* minor_status */
+	    gss_ctx_id_t,		/* context_handle */
+	    int,			/* conf_req_flag */
+	    gss_qop_t,			/* qop_req */
+	    gss_iov_msg_desc *,		/* msgs */
+	    int				/* msg_count */
+	);
+
+	OM_uint32	(KRB5_CALLCONV *gss_unwrap_iov_batch)
+	(
+	    OM_uint32 *,		/* minor_status */
+	    gss_ctx_id_t,		/* context_handle */
+	    gss_iov_msg_desc *,		/* msgs */
+	    int				/* msg_count */
+	);
+
 } *gss_mechanism;
 
 /*
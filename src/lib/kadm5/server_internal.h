@@ -185,6 +185,19 @@ k5_pwqual_check(krb5_context context, pwqual_handle handle,
                 const char *password, const char *policy_name,
                 krb5_principal princ);
 
+/*
+ * Compile the word list infile into a dictionary file outfile for the dict
+ * password quality module, which maps it instead of reading and sorting the
+ * word list.  If bloom_bits_per_word is nonzero, include a bloom filter using
+ * that many bits per word.  If exact is false, include only the bloom filter,
+ * so that a small fraction of passwords not in the word list are also
+ * rejected.
+ */
+krb5_error_code
+kadm5int_dict_compile(krb5_context context, const char *infile,
+                      const char *outfile, unsigned int bloom_bits_per_word,
+                      krb5_boolean exact);
+
 /*** initvt functions for built-in password quality modules ***/
 
 /* The dict module checks passwords against the realm's dictionary. */
@@ -33,18 +33,157 @@
 #include <krb5/pwqual_plugin.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <kadm5/admin.h>
 #include "adm_proto.h"
 #include <syslog.h>
 #include "server_internal.h"
 
+/*
+ * A compiled dictionary (see kadm5int_dict_compile()) consists of a header:
+ *
+ *   bytes 0-7    DICT_MAGIC
+ *   bytes 8-11   number of bloom filter probes per word, or 0 for no filter
+ *   bytes 12-15  zero
+ *   bytes 16-23  size of the bloom filter in bytes, a multiple of 8
+ *   bytes 24-31  number of hash table slots, zero or a power of two
+ *
+ * followed by the bloom filter and a linear-probing hash table of 64-bit word
+ * hashes, in which an empty slot contains zero.  All integers are big-endian.
+ * If there is no hash table, membership in the bloom filter alone marks a
+ * word as present.  The file is mapped read-only, so that it is loaded on
+ * demand and shared between processes through the page cache.
+ */
+#define DICT_MAGIC "K5DICT\0\1"
+#define DICT_HEADER_LEN 32
+#define DICT_MAX_PROBES 32
+
 typedef struct dict_moddata_st {
     char **word_list;        /* list of word pointers */
     char *word_block;        /* actual word data */
     unsigned int word_count; /* number of words */
+
+    /* Compiled dictionary fields */
+    void *map;               /* mapped dictionary file */
+    size_t map_len;          /* length of map */
+    const unsigned char *bloom;
+    uint64_t bloom_bits;
+    unsigned int nprobes;
+    const unsigned char *table;
+    uint64_t nslots;
 } *dict_moddata;
 
+/* Return the FNV-1a hash of the len bytes of word, folding ASCII letters to
+ * lower case.  Zero is reserved for empty hash table slots. */
+static uint64_t
+word_hash(const char *word, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    unsigned char c;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        c = word[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+    return (h == 0) ? 1 : h;
+}
+
+/* Derive a second, independent hash from h (the splitmix64 finalizer). */
+static uint64_t
+hash_mix(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/* Return the bit of a bloom filter of nbits bits set by probe i for hash h. */
+static inline uint64_t
+bloom_bit(uint64_t h, unsigned int i, uint64_t nbits)
+{
+    return (h + i * (hash_mix(h) | 1)) % nbits;
+}
+
+/* Return the first hash table slot to probe for hash h. */
+static inline uint64_t
+table_slot(uint64_t h, uint64_t nslots)
+{
+    return hash_mix(h) & (nslots - 1);
+}
+
+/* Return true if the compiled dictionary dict contains password. */
+static krb5_boolean
+compiled_lookup(dict_moddata dict, const char *password)
+{
+    uint64_t h, bit, slot, val, n;
+    unsigned int i;
+
+    h = word_hash(password, strlen(password));
+    if (dict->nprobes > 0) {
+        for (i = 0; i < dict->nprobes; i++) {
+            bit = bloom_bit(h, i, dict->bloom_bits);
+            if (!(dict->bloom[bit / 8] & (1 << (bit % 8))))
+                return FALSE;
+        }
+        if (dict->nslots == 0)
+            return TRUE;
+    }
+
+    slot = (dict->nslots > 0) ? table_slot(h, dict->nslots) : 0;
+    for (n = 0; n < dict->nslots; n++) {
+        val = load_64_be(dict->table + slot * 8);
+        if (val == 0)
+            return FALSE;
+        if (val == h)
+            return TRUE;
+        slot = (slot + 1) & (dict->nslots - 1);
+    }
+    return FALSE;
+}
+
+/* Map the compiled dictionary open on fd, of size len, into dict. */
+static krb5_error_code
+map_compiled_dict(krb5_context context, dict_moddata dict, int fd,
+                  const char *dict_file, size_t len)
+{
+    const unsigned char *p;
+    uint64_t bloom_len, nslots;
+    unsigned int nprobes;
+
+    dict->map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (dict->map == MAP_FAILED) {
+        dict->map = NULL;
+        return errno;
+    }
+    dict->map_len = len;
+
+    p = dict->map;
+    nprobes = load_32_be(p + 8);
+    bloom_len = load_64_be(p + 16);
+    nslots = load_64_be(p + 24);
+    if (load_32_be(p + 12) != 0 || nprobes > DICT_MAX_PROBES ||
+        (nprobes == 0) != (bloom_len == 0) || bloom_len % 8 != 0 ||
+        (nslots & (nslots - 1)) != 0 ||
+        bloom_len > len - DICT_HEADER_LEN ||
+        nslots != (len - DICT_HEADER_LEN - bloom_len) / 8 ||
+        (len - DICT_HEADER_LEN - bloom_len) % 8 != 0) {
+        krb5_set_error_message(context, EINVAL,
+                               _("Dictionary file %s is corrupt"), dict_file);
+        return EINVAL;
+    }
+
+    dict->nprobes = nprobes;
+    dict->bloom = p + DICT_HEADER_LEN;
+    dict->bloom_bits = bloom_len * 8;
+    dict->table = dict->bloom + bloom_len;
+    dict->nslots = nslots;
+    return 0;
+}
+
 
 /*
  * Function: word_compare
@@ -94,12 +233,13 @@ word_compare(const void *s1, const void *s2)
  */
 
 static int
-init_dict(dict_moddata dict, const char *dict_file)
+init_dict(krb5_context context, dict_moddata dict, const char *dict_file)
 {
-    int fd;
+    int fd, ret;
     size_t len, i;
     char *p, *t;
     struct stat sb;
+    char header[DICT_HEADER_LEN];
 
     if (dict_file == NULL) {
         krb5_klog_syslog(LOG_INFO,
@@ -121,6 +261,17 @@ init_dict(dict_moddata dict, const char *dict_file)
         close(fd);
         return errno;
     }
+    if (sb.st_size >= DICT_HEADER_LEN &&
+        read(fd, header, DICT_HEADER_LEN) == DICT_HEADER_LEN &&
+        memcmp(header, DICT_MAGIC, 8) == 0) {
+        ret = map_compiled_dict(context, dict, fd, dict_file, sb.st_size);
+        close(fd);
+        return ret;
+    }
+    if (lseek(fd, 0, SEEK_SET) == -1) {
+        close(fd);
+        return errno;
+    }
     if ((dict->word_block = malloc(sb.st_size + 1)) == NULL)
         return ENOMEM;
     if (read(fd, dict->word_block, sb.st_size) != sb.st_size)
@@ -173,6 +324,8 @@ destroy_dict(dict_moddata dict)
         return;
     free(dict->word_list);
     free(dict->word_block);
+    if (dict->map != NULL)
+        munmap(dict->map, dict->map_len);
     free(dict);
     return;
 }
@@ -188,15 +341,12 @@ dict_open(krb5_context context, const char *dict_file,
     *data = NULL;
 
     /* Allocate and initialize a dictionary structure. */
-    dict = malloc(sizeof(*dict));
+    dict = calloc(1, sizeof(*dict));
     if (dict == NULL)
         return ENOMEM;
-    dict->word_list = NULL;
-    dict->word_block = NULL;
-    dict->word_count = 0;
 
     /* Fill in the dictionary structure with data from dict_file. */
-    ret = init_dict(dict, dict_file);
+    ret = init_dict(context, dict, dict_file);
     if (ret != 0) {
         destroy_dict(dict);
         return ret;
@@ -224,6 +374,8 @@ dict_check(krb5_context context, krb5_pwqual_moddata data,
         bsearch(&password, dict->word_list, dict->word_count, sizeof(char *),
                 word_compare) != NULL)
         return KADM5_PASS_Q_DICT;
+    if (dict->map != NULL && compiled_lookup(dict, password))
+        return KADM5_PASS_Q_DICT;
 
     return 0;
 }
@@ -250,3 +402,173 @@ pwqual_dict_initvt(krb5_context context, int maj_ver, int min_ver,
     vt->close = dict_close;
     return 0;
 }
+
+/* Set the bits of hash h in the bloom filter and hash table being built. */
+static void
+compile_word(uint64_t h, unsigned char *bloom, uint64_t bloom_bits,
+             unsigned int nprobes, unsigned char *table, uint64_t nslots)
+{
+    uint64_t bit, slot, val;
+    unsigned int i;
+
+    for (i = 0; i < nprobes; i++) {
+        bit = bloom_bit(h, i, bloom_bits);
+        bloom[bit / 8] |= 1 << (bit % 8);
+    }
+    if (nslots == 0)
+        return;
+    for (slot = table_slot(h, nslots); ; slot = (slot + 1) & (nslots - 1)) {
+        val = load_64_be(table + slot * 8);
+        if (val == h)
+            return;
+        if (val == 0) {
+            store_64_be(h, table + slot * 8);
+            return;
+        }
+    }
+}
+
+/* Write len bytes of data to fd, returning 0 or an errno value. */
+static int
+write_all(int fd, const unsigned char *data, size_t len)
+{
+    ssize_t ret;
+
+    while (len > 0) {
+        ret = write(fd, data, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return (ret < 0) ? errno : EIO;
+        data += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+krb5_error_code
+kadm5int_dict_compile(krb5_context context, const char *infile,
+                      const char *outfile, unsigned int bloom_bits_per_word,
+                      krb5_boolean exact)
+{
+    krb5_error_code ret;
+    int fd = -1, outfd = -1;
+    struct stat sb;
+    char *words = NULL, *tmpname = NULL, *p, *end, *nl;
+    unsigned char header[DICT_HEADER_LEN], *bloom = NULL, *table = NULL;
+    uint64_t nwords = 0, bloom_len = 0, nslots = 0;
+    unsigned int nprobes = 0;
+    size_t len = 0;
+
+    if (!exact && bloom_bits_per_word == 0)
+        return EINVAL;
+
+    fd = open(infile, O_RDONLY);
+    if (fd == -1)
+        return errno;
+    set_cloexec_fd(fd);
+    if (fstat(fd, &sb) == -1) {
+        ret = errno;
+        goto cleanup;
+    }
+    len = sb.st_size;
+    if (len > 0) {
+        words = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (words == MAP_FAILED) {
+            words = NULL;
+            ret = errno;
+            goto cleanup;
+        }
+    }
+
+    /* Count the words, including a final line without a newline. */
+    for (p = words, end = words + len; p < end; p = nl + 1) {
+        nl = memchr(p, '\n', end - p);
+        if (nl == NULL)
+            nl = end;
+        nwords++;
+    }
+
+    if (bloom_bits_per_word > 0) {
+        nprobes = (bloom_bits_per_word * 693 + 500) / 1000;
+        if (nprobes < 1)
+            nprobes = 1;
+        if (nprobes > DICT_MAX_PROBES)
+            nprobes = DICT_MAX_PROBES;
+        bloom_len = (nwords * bloom_bits_per_word + 63) / 64 * 8;
+        if (bloom_len == 0)
+            bloom_len = 8;
+        bloom = calloc(1, bloom_len);
+        if (bloom == NULL) {
+            ret = ENOMEM;
+            goto cleanup;
+        }
+    }
+    if (exact) {
+        /* Keep the table at most half full. */
+        nslots = 1;
+        while (nslots < nwords * 2)
+            nslots *= 2;
+        table = calloc(nslots, 8);
+        if (table == NULL) {
+            ret = ENOMEM;
+            goto cleanup;
+        }
+    }
+
+    for (p = words, end = words + len; p < end; p = nl + 1) {
+        nl = memchr(p, '\n', end - p);
+        if (nl == NULL)
+            nl = end;
+        compile_word(word_hash(p, nl - p), bloom, bloom_len * 8, nprobes,
+                     table, nslots);
+    }
+
+    memcpy(header, DICT_MAGIC, 8);
+    store_32_be(nprobes, header + 8);
+    store_32_be(0, header + 12);
+    store_64_be(bloom_len, header + 16);
+    store_64_be(nslots, header + 24);
+
+    /* Write to a temporary file and rename it into place, so that processes
+     * which have the old dictionary mapped are not affected. */
+    if (asprintf(&tmpname, "%s.XXXXXX", outfile) < 0) {
+        tmpname = NULL;
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    outfd = mkstemp(tmpname);
+    if (outfd == -1) {
+        ret = errno;
+        free(tmpname);
+        tmpname = NULL;
+        goto cleanup;
+    }
+    set_cloexec_fd(outfd);
+    ret = write_all(outfd, header, DICT_HEADER_LEN);
+    if (!ret && bloom_len > 0)
+        ret = write_all(outfd, bloom, bloom_len);
+    if (!ret && nslots > 0)
+        ret = write_all(outfd, table, nslots * 8);
+    if (!ret && fchmod(outfd, 0644) == -1)
+        ret = errno;
+    if (!ret && fsync(outfd) == -1)
+        ret = errno;
+    if (close(outfd) == -1 && !ret)
+        ret = errno;
+    outfd = -1;
+    if (!ret && rename(tmpname, outfile) == -1)
+        ret = errno;
+    if (ret)
+        unlink(tmpname);
+
+cleanup:
+    if (words != NULL)
+        munmap(words, len);
+    if (fd != -1)
+        close(fd);
+    free(tmpname);
+    free(bloom);
+    free(table);
+    return ret;
+}
@@ -41,6 +41,8 @@ typedef struct _acl_op_table {
 
 typedef struct _acl_entry {
     struct _acl_entry   *ae_next;
+    struct _acl_entry   *ae_chain;      /* next in the same index chain */
+    int                 ae_seq;         /* position in the ACL file */
     char                *ae_name;
     krb5_boolean        ae_name_bad;
     krb5_principal      ae_principal;
@@ -77,6 +79,23 @@ typedef struct _wildstate {
 static aent_t   *acl_list_head = (aent_t *) NULL;
 static aent_t   *acl_list_tail = (aent_t *) NULL;
 
+/*
+ * Index of the usable ACL entries, built when the file is loaded.  Entries
+ * naming a principal without wildcards are hashed on the whole name; entries
+ * with wildcards are hashed on their number of components and, if it is
+ * literal, their first component.  Each bucket chains its entries in file
+ * order (hash collisions simply share a chain), so a lookup merges a few short
+ * chains by file position to keep first-match semantics.  Entries for "*"
+ * match any principal and are chained separately.
+ */
+#define ACL_KEY_EXACT   0
+#define ACL_KEY_FIRST   1
+#define ACL_KEY_LENGTH  2
+
+static aent_t   **acl_index = NULL;
+static size_t   acl_index_size = 0;
+static aent_t   *acl_any_head = NULL;
+
 static const char *acl_acl_file = (char *) NULL;
 static int acl_inited = 0;
 static int acl_debug_level = 0;
@@ -465,6 +484,10 @@ kadm5int_acl_free_entries()
         free(ap);
     }
     acl_list_head = acl_list_tail = (aent_t *) NULL;
+    free(acl_index);
+    acl_index = NULL;
+    acl_index_size = 0;
+    acl_any_head = NULL;
     acl_inited = 0;
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_free_entries()\n"));
 }
@@ -589,107 +612,273 @@ kadm5int_acl_match_data(const krb5_data *e1, const krb5_data *e2,
 }
 
 /*
- * kadm5int_acl_find_entry()    - Find a matching entry.
+ * kadm5int_acl_resolve_entries()       - Parse the principal names and
+ *                                        restrictions of all entries.
+ *
+ * This is done once at load time rather than on first match so that lookups
+ * do not modify the ACL list, and can safely be made from several threads.
+ * Entries which fail to parse are marked bad and never match.
  */
-static aent_t *
-kadm5int_acl_find_entry(krb5_context kcontext, krb5_const_principal principal,
-                        krb5_const_principal dest_princ)
+static void
+kadm5int_acl_resolve_entries(krb5_context kcontext)
 {
     aent_t              *entry;
-    krb5_error_code     kret;
+    int                 seq = 0;
+
+    for (entry = acl_list_head; entry; entry = entry->ae_next) {
+        entry->ae_seq = seq++;
+        if (strcmp(entry->ae_name, "*") &&
+            krb5_parse_name(kcontext, entry->ae_name, &entry->ae_principal)) {
+            DPRINT(DEBUG_ACL, acl_debug_level,
+                   ("Bad ACL entry %s\n", entry->ae_name));
+            entry->ae_name_bad = 1;
+            continue;
+        }
+        if (entry->ae_target && strcmp(entry->ae_target, "*") &&
+            krb5_parse_name(kcontext, entry->ae_target,
+                            &entry->ae_target_princ)) {
+            DPRINT(DEBUG_ACL, acl_debug_level,
+                   ("Bad target in ACL entry for %s\n", entry->ae_name));
+            entry->ae_target_bad = 1;
+            entry->ae_name_bad = 1;
+            continue;
+        }
+        if (entry->ae_restriction_string &&
+            kadm5int_acl_parse_restrictions(entry->ae_restriction_string,
+                                            &entry->ae_restrictions)) {
+            DPRINT(DEBUG_ACL, acl_debug_level,
+                   ("Bad restrictions in ACL entry for %s\n", entry->ae_name));
+            entry->ae_restriction_bad = 1;
+            entry->ae_name_bad = 1;
+        }
+    }
+}
+
+/* Does an ACL principal component or realm match anything? */
+static krb5_boolean
+kadm5int_acl_is_wildcard(const krb5_data *d)
+{
+    /* Mirrors the wildcard test in kadm5int_acl_match_data(). */
+    return d->length == 0 || (d->length == 1 && d->data[0] == '*');
+}
+
+static uint32_t
+kadm5int_acl_hash_bytes(uint32_t h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len-- > 0)
+        h = (h ^ *p++) * 16777619;
+    return h;
+}
+
+static uint32_t
+kadm5int_acl_hash_data(uint32_t h, const krb5_data *d)
+{
+    h = kadm5int_acl_hash_bytes(h, &d->length, sizeof(d->length));
+    return kadm5int_acl_hash_bytes(h, d->data, d->length);
+}
+
+/*
+ * kadm5int_acl_index_key()     - Compute the index key of the given kind
+ *                                for a principal.
+ */
+static uint32_t
+kadm5int_acl_index_key(int kind, krb5_const_principal princ)
+{
+    uint32_t            h = 2166136261U;
     int                 i;
-    int                 matchgood;
-    wildstate_t         state;
 
-    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_find_entry()\n"));
-    for (entry=acl_list_head; entry; entry = entry->ae_next) {
-        memset(&state, 0, sizeof(state));
+    h = kadm5int_acl_hash_bytes(h, &kind, sizeof(kind));
+    h = kadm5int_acl_hash_bytes(h, &princ->length, sizeof(princ->length));
+    if (kind == ACL_KEY_EXACT) {
+        h = kadm5int_acl_hash_data(h, &princ->realm);
+        for (i = 0; i < princ->length; i++)
+            h = kadm5int_acl_hash_data(h, &princ->data[i]);
+    } else if (kind == ACL_KEY_FIRST) {
+        h = kadm5int_acl_hash_data(h, &princ->data[0]);
+    }
+    return h;
+}
+
+/*
+ * kadm5int_acl_entry_key()     - Compute the index key for an entry.
+ */
+static uint32_t
+kadm5int_acl_entry_key(aent_t *entry)
+{
+    krb5_principal      princ = entry->ae_principal;
+    krb5_boolean        wild;
+    int                 i;
+
+    wild = kadm5int_acl_is_wildcard(&princ->realm);
+    for (i = 0; !wild && i < princ->length; i++)
+        wild = kadm5int_acl_is_wildcard(&princ->data[i]);
+    if (!wild)
+        return kadm5int_acl_index_key(ACL_KEY_EXACT, princ);
+    if (princ->length > 0 && !kadm5int_acl_is_wildcard(&princ->data[0]))
+        return kadm5int_acl_index_key(ACL_KEY_FIRST, princ);
+    return kadm5int_acl_index_key(ACL_KEY_LENGTH, princ);
+}
+
+/*
+ * kadm5int_acl_build_index()   - Index the usable entries of the ACL list.
+ *
+ * If memory runs out, no index is built and lookups scan the list instead.
+ */
+static void
+kadm5int_acl_build_index()
+{
+    aent_t              *entry, **tails, *any_tail = NULL;
+    size_t              n = 0, size = 16, b;
+
+    for (entry = acl_list_head; entry; entry = entry->ae_next)
+        n++;
+    while (size < n * 2)
+        size *= 2;
+    acl_index = calloc(size, sizeof(*acl_index));
+    tails = calloc(size, sizeof(*tails));
+    if (acl_index == NULL || tails == NULL) {
+        free(acl_index);
+        free(tails);
+        acl_index = NULL;
+        return;
+    }
+    acl_index_size = size;
+
+    for (entry = acl_list_head; entry; entry = entry->ae_next) {
+        entry->ae_chain = NULL;
         if (entry->ae_name_bad)
             continue;
         if (!strcmp(entry->ae_name, "*")) {
-            DPRINT(DEBUG_ACL, acl_debug_level, ("A wildcard ACL match\n"));
-            matchgood = 1;
+            if (any_tail)
+                any_tail->ae_chain = entry;
+            else
+                acl_any_head = entry;
+            any_tail = entry;
+            continue;
         }
-        else {
-            if (!entry->ae_principal && !entry->ae_name_bad) {
-                kret = krb5_parse_name(kcontext,
-                                       entry->ae_name,
-                                       &entry->ae_principal);
-                if (kret)
-                    entry->ae_name_bad = 1;
-            }
-            if (entry->ae_name_bad) {
-                DPRINT(DEBUG_ACL, acl_debug_level,
-                       ("Bad ACL entry %s\n", entry->ae_name));
-                continue;
+        b = kadm5int_acl_entry_key(entry) & (size - 1);
+        if (tails[b])
+            tails[b]->ae_chain = entry;
+        else
+            acl_index[b] = entry;
+        tails[b] = entry;
+    }
+    free(tails);
+}
+
+/*
+ * kadm5int_acl_match_entry()   - Does an entry apply to this principal
+ *                                and target?
+ */
+static krb5_boolean
+kadm5int_acl_match_entry(aent_t *entry, krb5_const_principal principal,
+                         krb5_const_principal dest_princ)
+{
+    int                 i;
+    int                 matchgood;
+    wildstate_t         state;
+
+    memset(&state, 0, sizeof(state));
+    if (entry->ae_name_bad)
+        return 0;
+    if (!strcmp(entry->ae_name, "*")) {
+        DPRINT(DEBUG_ACL, acl_debug_level, ("A wildcard ACL match\n"));
+        matchgood = 1;
+    }
+    else {
+        matchgood = 0;
+        if (kadm5int_acl_match_data(&entry->ae_principal->realm,
+                                    &principal->realm, 0, (wildstate_t *)0) &&
+            (entry->ae_principal->length == principal->length)) {
+            matchgood = 1;
+            for (i=0; i<principal->length; i++) {
+                if (!kadm5int_acl_match_data(&entry->ae_principal->data[i],
+                                             &principal->data[i], 0, &state)) {
+                    matchgood = 0;
+                    break;
+                }
             }
+        }
+    }
+    if (!matchgood)
+        return 0;
+
+    /* We've matched the principal.  If we have a target, then try it */
+    if (entry->ae_target && strcmp(entry->ae_target, "*")) {
+        if (!dest_princ)
             matchgood = 0;
-            if (kadm5int_acl_match_data(&entry->ae_principal->realm,
-                                        &principal->realm, 0, (wildstate_t *)0) &&
-                (entry->ae_principal->length == principal->length)) {
-                matchgood = 1;
-                for (i=0; i<principal->length; i++) {
-                    if (!kadm5int_acl_match_data(&entry->ae_principal->data[i],
-                                                 &principal->data[i], 0, &state)) {
+        else if (entry->ae_target_princ && dest_princ) {
+            if (kadm5int_acl_match_data(&entry->ae_target_princ->realm,
+                                        &dest_princ->realm, 1, (wildstate_t *)0) &&
+                (entry->ae_target_princ->length == dest_princ->length)) {
+                for (i=0; i<dest_princ->length; i++) {
+                    if (!kadm5int_acl_match_data(&entry->ae_target_princ->data[i],
+                                                 &dest_princ->data[i], 1, &state)) {
                         matchgood = 0;
                         break;
                     }
                 }
             }
+            else
+                matchgood = 0;
         }
-        if (!matchgood)
-            continue;
+    }
+    return matchgood;
+}
 
-        /* We've matched the principal.  If we have a target, then try it */
-        if (entry->ae_target && strcmp(entry->ae_target, "*")) {
-            if (!entry->ae_target_princ && !entry->ae_target_bad) {
-                kret = krb5_parse_name(kcontext, entry->ae_target,
-                                       &entry->ae_target_princ);
-                if (kret)
-                    entry->ae_target_bad = 1;
-            }
-            if (entry->ae_target_bad) {
-                DPRINT(DEBUG_ACL, acl_debug_level,
-                       ("Bad target in ACL entry for %s\n", entry->ae_name));
-                entry->ae_name_bad = 1;
-                continue;
-            }
-            if (!dest_princ)
-                matchgood = 0;
-            else if (entry->ae_target_princ && dest_princ) {
-                if (kadm5int_acl_match_data(&entry->ae_target_princ->realm,
-                                            &dest_princ->realm, 1, (wildstate_t *)0) &&
-                    (entry->ae_target_princ->length == dest_princ->length)) {
-                    for (i=0; i<dest_princ->length; i++) {
-                        if (!kadm5int_acl_match_data(&entry->ae_target_princ->data[i],
-                                                     &dest_princ->data[i], 1, &state)) {
-                            matchgood = 0;
-                            break;
-                        }
-                    }
-                }
-                else
-                    matchgood = 0;
-            }
+/*
+ * kadm5int_acl_find_entry()    - Find the first matching entry.
+ */
+static aent_t *
+kadm5int_acl_find_entry(krb5_context kcontext, krb5_const_principal principal,
+                        krb5_const_principal dest_princ)
+{
+    aent_t              *entry, *chains[4];
+    size_t              mask;
+    int                 i, nchains = 0;
+
+    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_find_entry()\n"));
+    if (acl_index == NULL) {
+        for (entry = acl_list_head; entry; entry = entry->ae_next) {
+            if (kadm5int_acl_match_entry(entry, principal, dest_princ))
+                break;
         }
-        if (!matchgood)
-            continue;
+        goto done;
+    }
 
-        if (entry->ae_restriction_string
-            && !entry->ae_restriction_bad
-            && !entry->ae_restrictions
-            && kadm5int_acl_parse_restrictions(entry->ae_restriction_string,
-                                               &entry->ae_restrictions)) {
-            DPRINT(DEBUG_ACL, acl_debug_level,
-                   ("Bad restrictions in ACL entry for %s\n", entry->ae_name));
-            entry->ae_restriction_bad = 1;
+    /* Gather the chains holding every entry which could match. */
+    mask = acl_index_size - 1;
+    chains[nchains++] =
+        acl_index[kadm5int_acl_index_key(ACL_KEY_EXACT, principal) & mask];
+    if (principal->length > 0) {
+        chains[nchains++] =
+            acl_index[kadm5int_acl_index_key(ACL_KEY_FIRST, principal) & mask];
+    }
+    chains[nchains++] =
+        acl_index[kadm5int_acl_index_key(ACL_KEY_LENGTH, principal) & mask];
+    chains[nchains++] = acl_any_head;
+
+    /* Try their entries in file order. */
+    for (;;) {
+        entry = NULL;
+        for (i = 0; i < nchains; i++) {
+            if (chains[i] && (!entry || chains[i]->ae_seq < entry->ae_seq))
+                entry = chains[i];
         }
-        if (entry->ae_restriction_bad) {
-            entry->ae_name_bad = 1;
-            continue;
+        if (!entry)
+            break;
+        /* Two keys may share a bucket; advance every cursor on this entry. */
+        for (i = 0; i < nchains; i++) {
+            if (chains[i] == entry)
+                chains[i] = entry->ae_chain;
         }
-        break;
+        if (kadm5int_acl_match_entry(entry, principal, dest_princ))
+            break;
     }
+
+done:
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_find_entry()=%x\n",entry));
     return(entry);
 }
@@ -712,6 +901,10 @@ kadm5int_acl_init(kcontext, debug_level, acl_file)
             ((acl_file) ? acl_file : "(null)")));
     acl_acl_file = (acl_file) ? acl_file : (char *) KRB5_DEFAULT_ADMIN_ACL;
     acl_inited = kadm5int_acl_load_acl_file();
+    if (acl_inited) {
+        kadm5int_acl_resolve_entries(kcontext);
+        kadm5int_acl_build_index();
+    }
 
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_init() = %d\n", kret));
     return(kret);
@@ -26,6 +26,9 @@
 
 #define getpagesize() sysconf(_SC_PAGESIZE)
 
+/* Limit the offset index to half of the mapped log. */
+#define MAX_ULOGENTRIES ((MAXLOGLEN / 2) / sizeof(uint32_t))
+
 static int pagesize = 0;
 
 #define INIT_ULOG(ctx)                          \
@@ -50,22 +53,53 @@ time_current(kdbe_time_t *out)
     out->useconds = timestamp.tv_usec;
 }
 
-/* Sync update entry to disk. */
-static void
-sync_update(kdb_hlog_t *ulog, kdb_ent_header_t *upd)
+/* Return the space used in the data area by an entry with len bytes of
+ * update data. */
+static inline unsigned long
+rec_size(unsigned long len)
+{
+    return ULOG_ROUNDUP(sizeof(kdb_ent_header_t) + len);
+}
+
+/* Return the file offset of the data area for a log with ulogentries index
+ * slots. */
+static inline uint32_t
+data_offset(uint32_t ulogentries)
+{
+    return ULOG_DATA_OFFSET(ulogentries);
+}
+
+/* Return the initial data area size for a log with ulogentries index
+ * slots. */
+static uint32_t
+default_data_size(uint32_t ulogentries)
+{
+    uint64_t size = (uint64_t)ulogentries * ULOG_BLOCK;
+    uint32_t max = MAXLOGLEN - data_offset(ulogentries);
+
+    return (size > max) ? max : size;
+}
+
+/* Flush the pages containing len bytes at addr to disk. */
+static int
+sync_range(void *addr, unsigned long len)
 {
-    unsigned long start, end, size;
+    unsigned long start, end;
 
     if (!pagesize)
         pagesize = getpagesize();
 
-    start = (unsigned long)upd & ~(pagesize - 1);
-
-    end = ((unsigned long)upd + ulog->kdb_block + (pagesize - 1)) &
-        ~(pagesize - 1);
+    start = (unsigned long)addr & ~(pagesize - 1);
+    end = ((unsigned long)addr + len + (pagesize - 1)) & ~(pagesize - 1);
+    return msync((caddr_t)start, end - start, MS_SYNC);
+}
 
-    size = end - start;
-    if (msync((caddr_t)start, size, MS_SYNC)) {
+/* Sync update entry and its index slot to disk. */
+static void
+sync_update(kdb_hlog_t *ulog, unsigned int indx, kdb_ent_header_t *upd)
+{
+    if (sync_range(upd, rec_size(upd->kdb_entry_size)) ||
+        sync_range(&ULOG_OFFSETS(ulog)[indx], sizeof(uint32_t))) {
         /* Couldn't sync to disk, let's panic. */
         syslog(LOG_ERR, _("could not sync ulog update to disk"));
         abort();
@@ -91,9 +125,15 @@ static krb5_boolean
 check_sno(kdb_log_context *log_ctx, kdb_sno_t sno,
           const kdbe_time_t *timestamp)
 {
+    kdb_hlog_t *ulog = log_ctx->ulog;
     unsigned int indx = (sno - 1) % log_ctx->ulogentries;
-    kdb_ent_header_t *ent = INDEX(log_ctx->ulog, indx);
+    uint32_t off = ULOG_OFFSETS(ulog)[indx];
+    kdb_ent_header_t *ent;
 
+    if (off < ulog->kdb_data_off ||
+        off - ulog->kdb_data_off > ulog->kdb_data_size - rec_size(0))
+        return FALSE;
+    ent = INDEX(ulog, indx);
     return ent->kdb_entry_sno == sno && time_equal(&ent->kdb_time, timestamp);
 }
 
@@ -163,41 +203,81 @@ extend_file_to(int fd, unsigned int new_size)
 }
 
 /*
- * Resize the array elements.  We reinitialize the update log rather than
- * unrolling the the log and copying it over to a temporary log for obvious
- * performance reasons.  Slaves will subsequently do a full resync, but the
- * need for resizing should be very small.
+ * Grow the data area so that it can hold a record of recsize bytes.  The data
+ * area ends the file, so the records already stored stay where they are and
+ * slaves can continue to update incrementally.  Large records only cost their
+ * own size, so this should only happen for records exceeding the whole
+ * default data area.
  */
 static krb5_error_code
-resize(kdb_hlog_t *ulog, uint32_t ulogentries, int ulogfd,
-       unsigned int recsize)
+resize(kdb_log_context *log_ctx, unsigned long recsize)
 {
-    unsigned int new_block, new_size;
+    kdb_hlog_t *ulog = log_ctx->ulog;
+    unsigned long new_size;
 
-    if (ulog == NULL)
+    if (recsize > MAXLOGLEN)
         return KRB5_LOG_ERROR;
-
-    new_size = sizeof(kdb_hlog_t);
-    new_block = (recsize / ULOG_BLOCK) + 1;
-    new_block *= ULOG_BLOCK;
-    new_size += ulogentries * new_block;
-
-    if (new_size > MAXLOGLEN)
+    new_size = ulog->kdb_data_size + (recsize / ULOG_BLOCK + 1) * ULOG_BLOCK;
+    if (new_size > MAXLOGLEN - ulog->kdb_data_off)
         return KRB5_LOG_ERROR;
 
-    /* Reinit log with new block size. */
-    memset(ulog, 0, sizeof(*ulog));
-    ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
-    ulog->db_version_num = KDB_VERSION;
-    ulog->kdb_state = KDB_STABLE;
-    ulog->kdb_block = new_block;
+    if (extend_file_to(log_ctx->ulogfd, ulog->kdb_data_off + new_size) < 0)
+        return errno;
+    ulog->kdb_data_size = new_size;
     sync_header(ulog);
+    return 0;
+}
 
-    /* Expand log considering new block size. */
-    if (extend_file_to(ulogfd, new_size) < 0)
-        return errno;
+/* Discard the oldest entry in the log. */
+static void
+discard_first(kdb_log_context *log_ctx)
+{
+    kdb_hlog_t *ulog = log_ctx->ulog;
+    kdb_ent_header_t *ent;
 
-    return 0;
+    ulog->kdb_num--;
+    if (ulog->kdb_num == 0)
+        return;
+    ulog->kdb_first_sno++;
+    ent = INDEX(ulog, (ulog->kdb_first_sno - 1) % log_ctx->ulogentries);
+    ulog->kdb_first_time = ent->kdb_time;
+}
+
+/*
+ * Return the offset at which to store a record of recsize bytes following the
+ * last entry, discarding the oldest entries as necessary to free an index
+ * slot and enough contiguous space.  The data area is used as a ring of
+ * variable-length records; a record which does not fit before the end of the
+ * data area is placed at its start.  recsize must not exceed the data area
+ * size.
+ */
+static uint32_t
+find_space(kdb_log_context *log_ctx, unsigned long recsize)
+{
+    kdb_hlog_t *ulog = log_ctx->ulog;
+    uint32_t ulogentries = log_ctx->ulogentries;
+    uint32_t start = ulog->kdb_data_off, end = start + ulog->kdb_data_size;
+    uint32_t first, next;
+    kdb_ent_header_t *last;
+
+    if (ulog->kdb_num >= ulogentries)
+        discard_first(log_ctx);
+
+    while (ulog->kdb_num > 0) {
+        first = ULOG_OFFSETS(ulog)[(ulog->kdb_first_sno - 1) % ulogentries];
+        last = INDEX(ulog, (ulog->kdb_last_sno - 1) % ulogentries);
+        next = (char *)last - (char *)ulog + rec_size(last->kdb_entry_size);
+        if (first < next) {
+            if (end - next >= recsize)
+                return next;
+            if (first - start >= recsize)
+                return start;
+        } else if (first - next >= recsize) {
+            return next;
+        }
+        discard_first(log_ctx);
+    }
+    return start;
 }
 
 /* Set the ulog to contain only a dummy entry with the given serial number and
@@ -206,13 +286,16 @@ static void
 set_dummy(kdb_log_context *log_ctx, kdb_sno_t sno, const kdbe_time_t *kdb_time)
 {
     kdb_hlog_t *ulog = log_ctx->ulog;
-    kdb_ent_header_t *ent = INDEX(ulog, (sno - 1) % log_ctx->ulogentries);
+    unsigned int indx = (sno - 1) % log_ctx->ulogentries;
+    kdb_ent_header_t *ent;
 
+    ULOG_OFFSETS(ulog)[indx] = ulog->kdb_data_off;
+    ent = INDEX(ulog, indx);
     memset(ent, 0, sizeof(*ent));
     ent->kdb_umagic = KDB_ULOG_MAGIC;
     ent->kdb_entry_sno = sno;
     ent->kdb_time = *kdb_time;
-    sync_update(ulog, ent);
+    sync_update(ulog, indx, ent);
 
     ulog->kdb_num = 1;
     ulog->kdb_first_sno = ulog->kdb_last_sno = sno;
@@ -229,7 +312,8 @@ reset_ulog(kdb_log_context *log_ctx)
     memset(ulog, 0, sizeof(*ulog));
     ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
     ulog->db_version_num = KDB_VERSION;
-    ulog->kdb_block = ULOG_BLOCK;
+    ulog->kdb_data_off = data_offset(log_ctx->ulogentries);
+    ulog->kdb_data_size = default_data_size(log_ctx->ulogentries);
 
     /* Create a dummy entry to remember the timestamp for downstreams. */
     time_current(&kdb_time);
@@ -263,35 +347,40 @@ unlock_ulog(krb5_context context)
  * Add an update to the log.  The update's kdb_entry_sno and kdb_time fields
  * must already be set.  The layout of the update log looks like:
  *
- * header log -> [ update header -> xdr(kdb_incr_update_t) ], ...
+ * header log -> [ offset of entry ], ... ->
+ *     [ update header -> xdr(kdb_incr_update_t) ], ...
+ *
+ * Entries take only the space they need, and the oldest entries are discarded
+ * when either the index or the data area is full.
  */
 static krb5_error_code
 store_update(kdb_log_context *log_ctx, kdb_incr_update_t *upd)
 {
     XDR xdrs;
     kdb_ent_header_t *indx_log;
-    unsigned int i, recsize;
-    unsigned long upd_size;
+    unsigned int i;
+    unsigned long upd_size, recsize;
+    uint32_t off;
     krb5_error_code retval;
     kdb_hlog_t *ulog = log_ctx->ulog;
     uint32_t ulogentries = log_ctx->ulogentries;
 
     upd_size = xdr_sizeof((xdrproc_t)xdr_kdb_incr_update_t, upd);
 
-    recsize = sizeof(kdb_ent_header_t) + upd_size;
+    recsize = rec_size(upd_size);
 
-    if (recsize > ulog->kdb_block) {
-        retval = resize(ulog, ulogentries, log_ctx->ulogfd, recsize);
+    if (recsize > ulog->kdb_data_size) {
+        retval = resize(log_ctx, recsize);
         if (retval)
             return retval;
     }
 
     ulog->kdb_state = KDB_UNSTABLE;
 
-    i = (upd->kdb_entry_sno - 1) % ulogentries;
-    indx_log = INDEX(ulog, i);
+    off = find_space(log_ctx, recsize);
+    indx_log = (kdb_ent_header_t *)((char *)ulog + off);
 
-    memset(indx_log, 0, ulog->kdb_block);
+    memset(indx_log, 0, recsize);
     indx_log->kdb_umagic = KDB_ULOG_MAGIC;
     indx_log->kdb_entry_size = upd_size;
     indx_log->kdb_entry_sno = upd->kdb_entry_sno;
@@ -304,24 +393,20 @@ store_update(kdb_log_context *log_ctx, kdb_incr_update_t *upd)
         return KRB5_LOG_CONV;
 
     indx_log->kdb_commit = TRUE;
-    sync_update(ulog, indx_log);
+    i = (upd->kdb_entry_sno - 1) % ulogentries;
+    ULOG_OFFSETS(ulog)[i] = off;
+    sync_update(ulog, i, indx_log);
 
     /* Modify the ulog header to reflect the new update. */
     ulog->kdb_last_sno = upd->kdb_entry_sno;
     ulog->kdb_last_time = upd->kdb_time;
     if (ulog->kdb_num == 0) {
-        /* We should only see this in old ulogs. */
+        /* The whole log was discarded to make room for this update. */
         ulog->kdb_num = 1;
         ulog->kdb_first_sno = upd->kdb_entry_sno;
         ulog->kdb_first_time = upd->kdb_time;
-    } else if (ulog->kdb_num < ulogentries) {
-        ulog->kdb_num++;
     } else {
-        /* We are circling; set kdb_first_sno and time to the next update. */
-        i = upd->kdb_entry_sno % ulogentries;
-        indx_log = INDEX(ulog, i);
-        ulog->kdb_first_sno = indx_log->kdb_entry_sno;
-        ulog->kdb_first_time = indx_log->kdb_time;
+        ulog->kdb_num++;
     }
 
     ulog->kdb_state = KDB_STABLE;
@@ -351,6 +436,8 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
     time_current(&upd->kdb_time);
     ret = store_update(log_ctx, upd);
     unlock_ulog(context);
+    if (ret == 0 && log_ctx->notify != NULL)
+        log_ctx->notify(context, upd->kdb_entry_sno, log_ctx->notify_data);
     return ret;
 }
 
@@ -475,20 +562,26 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries)
     kdb_hlog_t *ulog = NULL;
     int ulogfd = -1;
 
+    if (ulogentries == 0 || ulogentries > MAX_ULOGENTRIES)
+        return KRB5_LOG_ERROR;
+
     if (stat(logname, &st) == -1) {
         ulogfd = open(logname, O_RDWR | O_CREAT, 0600);
         if (ulogfd == -1)
             return errno;
-
-        filesize = sizeof(kdb_hlog_t) + ulogentries * ULOG_BLOCK;
-        if (extend_file_to(ulogfd, filesize) < 0)
-            return errno;
     } else {
         ulogfd = open(logname, O_RDWR, 0600);
         if (ulogfd == -1)
             return errno;
     }
 
+    /* Make sure a freshly reset log fits in the file. */
+    filesize = data_offset(ulogentries) + default_data_size(ulogentries);
+    if (extend_file_to(ulogfd, filesize) < 0) {
+        close(ulogfd);
+        return errno;
+    }
+
     ulog = mmap(0, MAXLOGLEN, PROT_READ | PROT_WRITE, MAP_SHARED, ulogfd, 0);
     if (ulog == MAP_FAILED) {
         /* Can't map update log file to memory. */
@@ -521,6 +614,21 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries)
         reset_ulog(log_ctx);
     }
 
+    /* Reinit ulog if it has an older layout or if ulogentries changed the
+     * location of the data area. */
+    if (ulog->db_version_num != KDB_VERSION ||
+        ulog->kdb_data_off != data_offset(ulogentries) ||
+        ulog->kdb_data_size < rec_size(0) ||
+        ulog->kdb_data_size > MAXLOGLEN - ulog->kdb_data_off)
+        reset_ulog(log_ctx);
+
+    /* Expand the ulog file if it isn't big enough for a grown data area. */
+    filesize = ulog->kdb_data_off + ulog->kdb_data_size;
+    if (extend_file_to(ulogfd, filesize) < 0) {
+        unlock_ulog(context);
+        return errno;
+    }
+
     /* Reinit ulog if ulogentries changed such that we have too many entries or
      * our first or last entry was written to the wrong location. */
     if (ulog->kdb_num != 0 &&
@@ -528,15 +636,6 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries)
          !check_sno(log_ctx, ulog->kdb_first_sno, &ulog->kdb_first_time) ||
          !check_sno(log_ctx, ulog->kdb_last_sno, &ulog->kdb_last_time)))
         reset_ulog(log_ctx);
-
-    if (ulog->kdb_num != ulogentries) {
-        /* Expand the ulog file if it isn't big enough. */
-        filesize = sizeof(kdb_hlog_t) + ulogentries * ulog->kdb_block;
-        if (extend_file_to(ulogfd, filesize) < 0) {
-            unlock_ulog(context);
-            return errno;
-        }
-    }
     unlock_ulog(context);
 
     return 0;
@@ -626,6 +725,18 @@ ulog_set_role(krb5_context ctx, iprop_role role)
     return 0;
 }
 
+/* Arrange for fn to be called with the new serial number each time an update
+ * is committed to the log through this context. */
+krb5_error_code
+ulog_set_notify(krb5_context context, ulog_notify_fn fn, void *data)
+{
+    if (context->kdblog_context == NULL)
+        return KRB5_LOG_ERROR;
+    context->kdblog_context->notify = fn;
+    context->kdblog_context->notify_data = data;
+    return 0;
+}
+
 update_status_t
 ulog_get_sno_status(krb5_context context, const kdb_last_t *last)
 {
@@ -638,6 +749,23 @@ ulog_get_sno_status(krb5_context context, const kdb_last_t *last)
     return status;
 }
 
+krb5_error_code
+ulog_get_first(krb5_context context, kdb_last_t *first_out)
+{
+    krb5_error_code ret;
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog;
+
+    INIT_ULOG(context);
+    ret = lock_ulog(context, KRB5_LOCKMODE_SHARED);
+    if (ret)
+        return ret;
+    first_out->last_sno = log_ctx->ulog->kdb_first_sno;
+    first_out->last_time = log_ctx->ulog->kdb_first_time;
+    unlock_ulog(context);
+    return 0;
+}
+
 krb5_error_code
 ulog_get_last(krb5_context context, kdb_last_t *last_out)
 {
@@ -32,9 +32,9 @@
 
 /*
  * This program performs unit tests for the update log functions in kdb_log.c.
- * Right now it contains only a test for issue #7839, checking that
- * ulog_add_update behaves appropriately when the last serial number is
- * reached.
+ * It contains a test for issue #7839, checking that ulog_add_update behaves
+ * appropriately when the last serial number is reached, and a test that
+ * variable-size entries share the data area without disturbing each other.
  *
  * The test program accepts one argument, which it unlinks and then maps with
  * ulog_map().  This lets us test all of the update log functions except for
@@ -50,6 +50,47 @@
 static struct _krb5_context context_st;
 static krb5_context context = &context_st;
 
+/* Add an update for a principal name of len bytes. */
+static void
+add_update(size_t len)
+{
+    kdb_incr_update_t upd;
+    char *name;
+
+    name = malloc(len);
+    assert(name != NULL);
+    memset(name, 'x', len);
+    memset(&upd, 0, sizeof(upd));
+    upd.kdb_princ_name.utf8str_t_val = name;
+    upd.kdb_princ_name.utf8str_t_len = len;
+    if (ulog_add_update(context, &upd) != 0)
+        abort();
+    free(name);
+}
+
+/* Check that every entry in the log is where the index says it is and lies
+ * within the data area. */
+static void
+check_entries(kdb_log_context *lctx)
+{
+    kdb_hlog_t *ulog = lctx->ulog;
+    kdb_ent_header_t *ent;
+    kdb_sno_t sno;
+    uint32_t off;
+
+    assert(ulog->kdb_num <= lctx->ulogentries);
+    assert(ulog->kdb_last_sno - ulog->kdb_first_sno + 1 == ulog->kdb_num);
+    for (sno = ulog->kdb_first_sno; sno <= ulog->kdb_last_sno; sno++) {
+        off = ULOG_OFFSETS(ulog)[(sno - 1) % lctx->ulogentries];
+        ent = INDEX(ulog, (sno - 1) % lctx->ulogentries);
+        assert(off >= ulog->kdb_data_off);
+        assert(off + sizeof(*ent) + ent->kdb_entry_size <=
+               ulog->kdb_data_off + ulog->kdb_data_size);
+        assert(ent->kdb_umagic == KDB_ULOG_MAGIC);
+        assert(ent->kdb_entry_sno == sno);
+    }
+}
+
 int
 main(int argc, char **argv)
 {
@@ -57,6 +98,8 @@ main(int argc, char **argv)
     kdb_hlog_t *ulog;
     kdb_incr_update_t upd;
     const char *filename;
+    uint32_t data_size, num;
+    int i;
 
     if (argc != 2) {
         fprintf(stderr, "Usage: %s filename\n", argv[0]);
@@ -84,5 +127,46 @@ main(int argc, char **argv)
     assert(ulog->kdb_num == 2);
     assert(ulog->kdb_first_sno == 1);
     assert(ulog->kdb_last_sno == 2);
+
+    /* Fill the log with small updates; the index should wrap. */
+    for (i = 0; i < 25; i++)
+        add_update(10 + i);
+    check_entries(lctx);
+    assert(ulog->kdb_num == lctx->ulogentries);
+    assert(ulog->kdb_last_sno == 27);
+
+    /* A few medium-sized updates should push out older entries by space
+     * rather than by count. */
+    for (i = 0; i < 4; i++)
+        add_update(ULOG_BLOCK * 3);
+    check_entries(lctx);
+    assert(ulog->kdb_num < lctx->ulogentries);
+    assert(ulog->kdb_last_sno == 31);
+
+    /* An update larger than the whole data area should grow it without
+     * discarding the other entries. */
+    data_size = ulog->kdb_data_size;
+    num = ulog->kdb_num;
+    add_update(data_size + 1);
+    check_entries(lctx);
+    assert(ulog->kdb_data_size > data_size);
+    assert(ulog->kdb_num == num + 1);
+
+    /* Small updates should reuse the space left before the large one. */
+    for (i = 0; i < 40; i++)
+        add_update(i * 97 % 500);
+    check_entries(lctx);
+    assert(ulog->kdb_last_sno == 72);
+
+    /* Mapping the log again should keep its contents. */
+    num = ulog->kdb_num;
+    ulog_fini(context);
+    if (ulog_map(context, filename, 10) != 0)
+        abort();
+    lctx = context->kdblog_context;
+    ulog = lctx->ulog;
+    assert(ulog->kdb_num == num);
+    assert(ulog->kdb_last_sno == 72);
+    check_entries(lctx);
     return 0;
 }
@@ -38,13 +38,19 @@
 
 K5_LIST_HEAD(server_head, server_st);
 
+/* Minimum time in milliseconds to wait for a response before also sending a
+ * request to the next remote. */
+#define HEDGE_MIN_DELAY 20
+
 typedef struct remote_state_st remote_state;
 typedef struct request_st request;
 typedef struct server_st server;
 
 struct remote_state_st {
     const krad_packet *packet;
-    krad_remote *remote;
+    server *srv;
+    int64_t sent;               /* Time sent in milliseconds. */
+    krb5_boolean pending;       /* Awaiting a response or timeout. */
 };
 
 struct request_st {
@@ -60,11 +66,15 @@ struct request_st {
     remote_state *remotes;
     ssize_t current;
     ssize_t count;
+    verto_ev *hedge;
 };
 
 struct server_st {
     krad_remote *serv;
     time_t last;
+    int srtt;                   /* Smoothed response time in milliseconds,
+                                 * or 0 if not yet known. */
+    unsigned int outstanding;   /* Requests awaiting a response. */
     K5_LIST_ENTRY(server_st) list;
 };
 
@@ -74,11 +84,22 @@ struct krad_client_st {
     struct server_head servers;
 };
 
+/* Return the current time in milliseconds. */
+static int64_t
+now_ms(krb5_context kctx)
+{
+    krb5_int32 sec, usec;
+
+    if (krb5_us_timeofday(kctx, &sec, &usec) != 0)
+        return 0;
+    return (int64_t)sec * 1000 + usec / 1000;
+}
+
 /* Return either a pre-existing server that matches the address info and the
  * secret, or create a new one. */
 static krb5_error_code
 get_server(krad_client *rc, const struct addrinfo *ai, const char *secret,
-           krad_remote **out)
+           server **out)
 {
     krb5_error_code retval;
     time_t currtime;
@@ -90,7 +111,7 @@ get_server(krad_client *rc, const struct addrinfo *ai, const char *secret,
     K5_LIST_FOREACH(srv, &rc->servers, list) {
         if (kr_remote_equals(srv->serv, ai, secret)) {
             srv->last = currtime;
-            *out = srv->serv;
+            *out = srv;
             return 0;
         }
     }
@@ -107,14 +128,28 @@ get_server(krad_client *rc, const struct addrinfo *ai, const char *secret,
     }
 
     K5_LIST_INSERT_HEAD(&rc->servers, srv, list);
-    *out = srv->serv;
+    *out = srv;
     return 0;
 }
 
+/*
+ * Estimate how long a server will take to respond to a new request, from its
+ * response time and the number of requests already waiting on it.  Servers
+ * which have not responded yet are assumed to take the whole timeout.
+ */
+static long
+server_cost(const server *srv, int timeout)
+{
+    long rtt = (srv->srtt > 0) ? srv->srtt : timeout;
+
+    return rtt * (srv->outstanding + 1);
+}
+
 /* Free a request. */
 static void
 request_free(request *req)
 {
+    verto_del(req->hedge);
     krad_attrset_free(req->attrs);
     free(req->remotes);
     free(req);
@@ -128,8 +163,9 @@ request_new(krad_client *rc, krad_code code, const krad_attrset *attrs,
 {
     const struct addrinfo *tmp;
     krb5_error_code retval;
+    remote_state rs;
     request *rqst;
-    size_t i;
+    size_t i, j;
 
     if (ai == NULL)
         return EINVAL;
@@ -147,6 +183,7 @@ request_new(krad_client *rc, krad_code code, const krad_attrset *attrs,
     rqst->data = data;
     rqst->timeout = timeout / rqst->count;
     rqst->retries = retries;
+    rqst->current = -1;
 
     retval = krad_attrset_copy(attrs, &rqst->attrs);
     if (retval != 0) {
@@ -162,13 +199,23 @@ request_new(krad_client *rc, krad_code code, const krad_attrset *attrs,
 
     i = 0;
     for (tmp = ai; tmp != NULL; tmp = tmp->ai_next) {
-        retval = get_server(rc, tmp, secret, &rqst->remotes[i++].remote);
+        retval = get_server(rc, tmp, secret, &rqst->remotes[i++].srv);
         if (retval != 0) {
             request_free(rqst);
             return retval;
         }
     }
 
+    /* Try the servers in order of expected response time, keeping the
+     * resolved order among equals. */
+    for (i = 1; i < (size_t)rqst->count; i++) {
+        rs = rqst->remotes[i];
+        for (j = i; j > 0 && server_cost(rqst->remotes[j - 1].srv, timeout) >
+                 server_cost(rs.srv, timeout); j--)
+            rqst->remotes[j] = rqst->remotes[j - 1];
+        rqst->remotes[j] = rs;
+    }
+
     *req = rqst;
     return 0;
 }
@@ -188,12 +235,118 @@ age(struct server_head *head, time_t currtime)
     }
 }
 
+/* Return true if a remote of req is still awaiting a response. */
+static krb5_boolean
+request_pending(request *req)
+{
+    ssize_t i;
+
+    for (i = 0; i <= req->current; i++) {
+        if (req->remotes[i].pending)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+on_response(krb5_error_code retval, const krad_packet *reqp,
+            const krad_packet *rspp, void *data);
+
+/* Send req to the next remote which accepts it.  Return ENOENT if there are
+ * no remotes left to try. */
+static krb5_error_code
+send_next(request *req)
+{
+    krb5_error_code retval = ENOENT;
+    remote_state *rs;
+
+    while (req->remotes[req->current + 1].srv != NULL) {
+        rs = &req->remotes[++req->current];
+        retval = kr_remote_send(rs->srv->serv, req->code, req->attrs,
+                                on_response, req, req->timeout, req->retries,
+                                &rs->packet);
+        if (retval == 0) {
+            rs->sent = now_ms(req->rc->kctx);
+            rs->pending = TRUE;
+            rs->srv->outstanding++;
+            return 0;
+        }
+    }
+
+    return retval;
+}
+
+/* If the current remote has not responded by the time a response would
+ * normally have arrived, also send the request to the next one. */
+static void
+on_hedge(verto_ctx *ctx, verto_ev *ev)
+{
+    request *req = verto_get_private(ev);
+
+    req->hedge = NULL;
+    (void)send_next(req);
+}
+
+/* Start the hedging timer for req if its current remote's response time is
+ * known and there is another remote to try. */
+static void
+start_hedge(request *req)
+{
+    server *srv = req->remotes[req->current].srv;
+    int delay;
+
+    if (srv->srtt <= 0 || req->remotes[req->current + 1].srv == NULL)
+        return;
+
+    delay = srv->srtt * 2;
+    if (delay < HEDGE_MIN_DELAY)
+        delay = HEDGE_MIN_DELAY;
+    if (delay >= req->timeout)
+        return;
+
+    req->hedge = verto_add_timeout(req->rc->vctx, VERTO_EV_FLAG_NONE, on_hedge,
+                                   delay);
+    if (req->hedge != NULL)
+        verto_set_private(req->hedge, req, NULL);
+}
+
+/* Update the response time estimate of the remote which sent reqp. */
+static void
+record_result(request *req, const krad_packet *reqp, krb5_error_code retval)
+{
+    remote_state *rs;
+    int64_t rtt;
+    ssize_t i;
+
+    for (i = 0; i <= req->current; i++) {
+        rs = &req->remotes[i];
+        if (rs->packet != reqp || !rs->pending)
+            continue;
+
+        rs->pending = FALSE;
+        rs->srv->outstanding--;
+        if (retval == 0) {
+            rtt = now_ms(req->rc->kctx) - rs->sent;
+            if (rtt < 1)
+                rtt = 1;
+            else if (rtt > req->timeout)
+                rtt = req->timeout;
+            rs->srv->srtt = (rs->srv->srtt == 0) ? rtt :
+                (7 * rs->srv->srtt + rtt) / 8;
+        } else if (retval == ETIMEDOUT && rs->srv->srtt < req->timeout) {
+            rs->srv->srtt = req->timeout;
+        }
+        return;
+    }
+}
+
 /* Handle a response from a server (or related errors). */
 static void
 on_response(krb5_error_code retval, const krad_packet *reqp,
             const krad_packet *rspp, void *data)
 {
     request *req = data;
+    krb5_error_code ret;
     time_t currtime;
     size_t i;
 
@@ -201,14 +354,20 @@ on_response(krb5_error_code retval, const krad_packet *reqp,
     if (req->count < 0)
         return;
 
-    /* If we have timed out and have more remotes to try, do so. */
-    if (retval == ETIMEDOUT && req->remotes[++req->current].remote != NULL) {
-        retval = kr_remote_send(req->remotes[req->current].remote, req->code,
-                                req->attrs, on_response, req, req->timeout,
-                                req->retries,
-                                &req->remotes[req->current].packet);
-        if (retval == 0)
+    record_result(req, reqp, retval);
+
+    /* If we have timed out, try the next remote, or keep waiting if another
+     * remote may still respond. */
+    if (retval == ETIMEDOUT) {
+        ret = send_next(req);
+        if (ret == 0 || request_pending(req))
             return;
+        if (ret != ENOENT)
+            retval = ret;
+    } else if (retval != 0 && request_pending(req)) {
+        /* The request was also sent to another remote; let its answer
+         * decide the outcome. */
+        return;
     }
 
     /* Mark the request as complete. */
@@ -218,8 +377,13 @@ on_response(krb5_error_code retval, const krad_packet *reqp,
     req->cb(retval, reqp, rspp, req->data);
 
     /* Cancel the outstanding packets. */
-    for (i = 0; req->remotes[i].remote != NULL; i++)
-        kr_remote_cancel(req->remotes[i].remote, req->remotes[i].packet);
+    for (i = 0; req->remotes[i].srv != NULL; i++) {
+        if (req->remotes[i].pending) {
+            req->remotes[i].pending = FALSE;
+            req->remotes[i].srv->outstanding--;
+        }
+        kr_remote_cancel(req->remotes[i].srv->serv, req->remotes[i].packet);
+    }
 
     /* Age out servers that haven't been used in a while. */
     if (time(&currtime) != (time_t)-1)
@@ -323,13 +487,12 @@ krad_client_send(krad_client *rc, krad_code code, const krad_attrset *attrs,
     if (retval != 0)
         return retval;
 
-    retval = kr_remote_send(req->remotes[req->current].remote, req->code,
-                            req->attrs, on_response, req, req->timeout,
-                            req->retries, &req->remotes[req->current].packet);
+    retval = send_next(req);
     if (retval != 0) {
         request_free(req);
         return retval;
     }
 
+    start_hedge(req);
     return 0;
 }
@@ -41,12 +41,25 @@
 #define FLAGS_WRITE VERTO_EV_FLAG_IO_WRITE
 #define FLAGS_BASE  VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_ERROR
 
+/*
+ * A RADIUS packet id only has eight bits, so a single socket can have at most
+ * 256 outstanding requests.  Spread requests to a remote across up to
+ * MAX_CONNS sockets, opening another one once every open socket has at least
+ * CONN_LOAD outstanding requests.
+ */
+#define MAX_CONNS 8
+#define CONN_LOAD 32
+
+#define pkt_id(p) ((unsigned char)krad_packet_encode(p)->data[1])
+
 K5_TAILQ_HEAD(request_head, request_st);
 
 typedef struct request_st request;
+typedef struct conn_st conn;
+
 struct request_st {
     K5_TAILQ_ENTRY(request_st) list;
-    krad_remote *rr;
+    conn *conn;
     krad_packet *request;
     krad_cb cb;
     void *data;
@@ -56,40 +69,71 @@ struct request_st {
     size_t sent;
 };
 
-struct krad_remote_st {
-    krb5_context kctx;
-    verto_ctx *vctx;
+struct conn_st {
+    krad_remote *rr;
     int fd;
     verto_ev *io;
-    char *secret;
-    struct addrinfo *info;
     struct request_head list;
+    request *ids[UCHAR_MAX + 1];    /* Outstanding requests by packet id. */
+    size_t count;
     char buffer_[KRAD_PACKET_SIZE_MAX];
     krb5_data buffer;
 };
 
+struct krad_remote_st {
+    krb5_context kctx;
+    verto_ctx *vctx;
+    char *secret;
+    struct addrinfo *info;
+    conn *conns[MAX_CONNS];
+    size_t nconns;
+};
+
+/* State for iterating over the requests of a socket by packet id. */
+struct id_iter {
+    conn *conn;
+    int i;
+};
+
 static void
 on_io(verto_ctx *ctx, verto_ev *ev);
 
 static void
 on_timeout(verto_ctx *ctx, verto_ev *ev);
 
-/* Iterate over the set of outstanding packets. */
+/* Iterate over the set of outstanding packets of a socket. */
 static const krad_packet *
-iterator(request **out)
+iterator(struct id_iter *iter, krb5_boolean cancel)
 {
-    request *tmp = *out;
+    request *r;
 
-    if (tmp == NULL)
+    if (cancel)
         return NULL;
 
-    *out = K5_TAILQ_NEXT(tmp, list);
+    while (iter->i <= UCHAR_MAX) {
+        r = iter->conn->ids[iter->i++];
+        if (r != NULL)
+            return r->request;
+    }
+    return NULL;
+}
+
+/* Yield the single outstanding packet, if any, which could match a
+ * response. */
+static const krad_packet *
+match_iterator(request **out, krb5_boolean cancel)
+{
+    request *tmp = *out;
+
+    *out = NULL;
+    if (cancel || tmp == NULL)
+        return NULL;
     return tmp->request;
 }
 
 /* Create a new request. */
 static krb5_error_code
-request_new(krad_remote *rr, krad_packet *rqst, int timeout, size_t retries,
+request_new(conn *c, krad_packet *rqst, int timeout, size_t retries,
             krad_cb cb, void *data, request **out)
 {
     request *tmp;
@@ -98,7 +142,7 @@ request_new(krad_remote *rr, krad_packet *rqst, int timeout, size_t retries,
     if (tmp == NULL)
         return ENOMEM;
 
-    tmp->rr = rr;
+    tmp->conn = c;
     tmp->request = rqst;
     tmp->cb = cb;
     tmp->data = data;
@@ -114,8 +158,13 @@ static inline void
 request_finish(request *req, krb5_error_code retval,
                const krad_packet *response)
 {
-    if (retval != ETIMEDOUT)
-        K5_TAILQ_REMOVE(&req->rr->list, req, list);
+    conn *c = req->conn;
+
+    if (retval != ETIMEDOUT) {
+        K5_TAILQ_REMOVE(&c->list, req, list);
+        c->ids[pkt_id(req->request)] = NULL;
+        c->count--;
+    }
 
     req->cb(retval, req->request, response, req->data);
 
@@ -140,94 +189,93 @@ request_start_timer(request *r, verto_ctx *vctx)
     return (r->timer == NULL) ? ENOMEM : 0;
 }
 
-/* Disconnect from the remote host. */
+/* Disconnect a socket from the remote host. */
 static void
-remote_disconnect(krad_remote *rr)
+conn_disconnect(conn *c)
 {
-    if (rr->fd >= 0)
-        close(rr->fd);
-    verto_del(rr->io);
-    rr->fd = -1;
-    rr->io = NULL;
+    if (c->fd >= 0)
+        close(c->fd);
+    verto_del(c->io);
+    c->fd = -1;
+    c->io = NULL;
 }
 
-/* Add the specified flags to the remote. This automatically manages the
+/* Add the specified flags to a socket. This automatically manages the
  * lifecyle of the underlying event. Also connects if disconnected. */
 static krb5_error_code
-remote_add_flags(krad_remote *remote, verto_ev_flag flags)
+conn_add_flags(conn *c, verto_ev_flag flags)
 {
+    krad_remote *remote = c->rr;
     verto_ev_flag curflags = VERTO_EV_FLAG_NONE;
     int i;
 
     flags &= (FLAGS_READ | FLAGS_WRITE);
-    if (remote == NULL || flags == FLAGS_NONE)
+    if (flags == FLAGS_NONE)
         return EINVAL;
 
     /* If there is no connection, connect. */
-    if (remote->fd < 0) {
-        verto_del(remote->io);
-        remote->io = NULL;
+    if (c->fd < 0) {
+        verto_del(c->io);
+        c->io = NULL;
 
-        remote->fd = socket(remote->info->ai_family, remote->info->ai_socktype,
-                            remote->info->ai_protocol);
-        if (remote->fd < 0)
+        c->fd = socket(remote->info->ai_family, remote->info->ai_socktype,
+                       remote->info->ai_protocol);
+        if (c->fd < 0)
             return errno;
 
-        i = connect(remote->fd, remote->info->ai_addr,
-                    remote->info->ai_addrlen);
+        i = connect(c->fd, remote->info->ai_addr, remote->info->ai_addrlen);
         if (i < 0) {
             i = errno;
-            remote_disconnect(remote);
+            conn_disconnect(c);
             return i;
         }
     }
 
-    if (remote->io == NULL) {
-        remote->io = verto_add_io(remote->vctx, FLAGS_BASE | flags,
-                                  on_io, remote->fd);
-        if (remote->io == NULL)
+    if (c->io == NULL) {
+        c->io = verto_add_io(remote->vctx, FLAGS_BASE | flags, on_io, c->fd);
+        if (c->io == NULL)
             return ENOMEM;
-        verto_set_private(remote->io, remote, NULL);
+        verto_set_private(c->io, c, NULL);
     }
 
-    curflags = verto_get_flags(remote->io);
+    curflags = verto_get_flags(c->io);
     if ((curflags & flags) != flags)
-        verto_set_flags(remote->io, FLAGS_BASE | curflags | flags);
+        verto_set_flags(c->io, FLAGS_BASE | curflags | flags);
 
     return 0;
 }
 
-/* Remove the specified flags to the remote. This automatically manages the
+/* Remove the specified flags from a socket. This automatically manages the
  * lifecyle of the underlying event. */
 static void
-remote_del_flags(krad_remote *remote, verto_ev_flag flags)
+conn_del_flags(conn *c, verto_ev_flag flags)
 {
-    if (remote == NULL || remote->io == NULL)
+    if (c->io == NULL)
         return;
 
-    flags = verto_get_flags(remote->io) & (FLAGS_READ | FLAGS_WRITE) & ~flags;
+    flags = verto_get_flags(c->io) & (FLAGS_READ | FLAGS_WRITE) & ~flags;
     if (flags == FLAGS_NONE) {
-        verto_del(remote->io);
-        remote->io = NULL;
+        verto_del(c->io);
+        c->io = NULL;
         return;
     }
 
-    verto_set_flags(remote->io, FLAGS_BASE | flags);
+    verto_set_flags(c->io, FLAGS_BASE | flags);
 }
 
-/* Close the connection and start the timers of all outstanding requests. */
+/* Close a socket and start the timers of all its outstanding requests. */
 static void
-remote_shutdown(krad_remote *rr)
+conn_shutdown(conn *c)
 {
     krb5_error_code retval;
-    request *r;
+    request *r, *next;
 
-    remote_disconnect(rr);
+    conn_disconnect(c);
 
     /* Start timers for all unsent packets. */
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
+    K5_TAILQ_FOREACH_SAFE(r, &c->list, list, next) {
         if (r->timer == NULL) {
-            retval = request_start_timer(r, rr->vctx);
+            retval = request_start_timer(r, c->rr->vctx);
             if (retval != 0)
                 request_finish(r, retval, NULL);
         }
@@ -246,7 +294,7 @@ on_timeout(verto_ctx *ctx, verto_ev *ev)
     /* If we have more retries to perform, resend the packet. */
     if (req->retries-- > 0) {
         req->sent = 0;
-        retval = remote_add_flags(req->rr, FLAGS_WRITE);
+        retval = conn_add_flags(req->conn, FLAGS_WRITE);
         if (retval == 0)
             return;
     }
@@ -256,13 +304,13 @@ on_timeout(verto_ctx *ctx, verto_ev *ev)
 
 /* Write data to the socket. */
 static void
-on_io_write(krad_remote *rr)
+on_io_write(conn *c)
 {
     const krb5_data *tmp;
     ssize_t written;
     request *r;
 
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
+    K5_TAILQ_FOREACH(r, &c->list, list) {
         tmp = krad_packet_encode(r->request);
 
         /* If the packet has already been sent, do nothing. */
@@ -270,7 +318,7 @@ on_io_write(krad_remote *rr)
             continue;
 
         /* Send the packet. */
-        written = sendto(verto_get_fd(rr->io), tmp->data + r->sent,
+        written = sendto(verto_get_fd(c->io), tmp->data + r->sent,
                          tmp->length - r->sent, 0, NULL, 0);
         if (written < 0) {
             /* Should we try again? */
@@ -279,20 +327,20 @@ on_io_write(krad_remote *rr)
                 return;
 
             /* This error can't be worked around. */
-            remote_shutdown(rr);
+            conn_shutdown(c);
             return;
         }
 
         /* If the packet was completely sent, set a timeout. */
         r->sent += written;
         if (r->sent == tmp->length) {
-            if (request_start_timer(r, rr->vctx) != 0) {
+            if (request_start_timer(r, c->rr->vctx) != 0) {
                 request_finish(r, ENOMEM, NULL);
                 return;
             }
 
-            if (remote_add_flags(rr, FLAGS_READ) != 0) {
-                remote_shutdown(rr);
+            if (conn_add_flags(c, FLAGS_READ) != 0) {
+                conn_shutdown(c);
                 return;
             }
         }
@@ -300,34 +348,35 @@ on_io_write(krad_remote *rr)
         return;
     }
 
-    remote_del_flags(rr, FLAGS_WRITE);
+    conn_del_flags(c, FLAGS_WRITE);
     return;
 }
 
 /* Read data from the socket. */
 static void
-on_io_read(krad_remote *rr)
+on_io_read(conn *c)
 {
+    krad_remote *rr = c->rr;
     const krad_packet *req = NULL;
     krad_packet *rsp = NULL;
     krb5_error_code retval;
     ssize_t pktlen;
-    request *tmp, *r;
+    request *tmp;
     int i;
 
-    pktlen = sizeof(rr->buffer_) - rr->buffer.length;
+    pktlen = sizeof(c->buffer_) - c->buffer.length;
     if (rr->info->ai_socktype == SOCK_STREAM) {
-        pktlen = krad_packet_bytes_needed(&rr->buffer);
+        pktlen = krad_packet_bytes_needed(&c->buffer);
         if (pktlen < 0) {
             /* If we received a malformed packet on a stream socket,
              * assume the socket to be unrecoverable. */
-            remote_shutdown(rr);
+            conn_shutdown(c);
             return;
         }
     }
 
     /* Read the packet. */
-    i = recv(verto_get_fd(rr->io), rr->buffer.data + rr->buffer.length,
+    i = recv(verto_get_fd(c->io), c->buffer.data + c->buffer.length,
              pktlen, 0);
 
     /* On these errors, try again. */
@@ -336,34 +385,33 @@ on_io_read(krad_remote *rr)
 
     /* On any other errors or on EOF, the socket is unrecoverable. */
     if (i <= 0) {
-        remote_shutdown(rr);
+        conn_shutdown(c);
         return;
     }
 
     /* If we have a partial read or just the header, try again. */
-    rr->buffer.length += i;
-    pktlen = krad_packet_bytes_needed(&rr->buffer);
+    c->buffer.length += i;
+    pktlen = krad_packet_bytes_needed(&c->buffer);
     if (rr->info->ai_socktype == SOCK_STREAM && pktlen > 0)
         return;
 
-    /* Decode the packet. */
-    tmp = K5_TAILQ_FIRST(&rr->list);
-    retval = krad_packet_decode_response(rr->kctx, rr->secret, &rr->buffer,
-                                         (krad_packet_iter_cb)iterator, &tmp,
-                                         &req, &rsp);
-    rr->buffer.length = 0;
+    /* Decode the packet, checking it only against the outstanding request
+     * with the same id. */
+    tmp = (c->buffer.length > 1) ? c->ids[(unsigned char)c->buffer.data[1]] :
+        NULL;
+    retval = krad_packet_decode_response(rr->kctx, rr->secret, &c->buffer,
+                                         (krad_packet_iter_cb)match_iterator,
+                                         &tmp, &req, &rsp);
+    c->buffer.length = 0;
     if (retval != 0)
         return;
 
     /* Match the response with an outstanding request. */
     if (req != NULL) {
-        K5_TAILQ_FOREACH(r, &rr->list, list) {
-            if (r->request == req &&
-                r->sent == krad_packet_encode(req)->length) {
-                request_finish(r, 0, rsp);
-                break;
-            }
-        }
+        tmp = c->ids[pkt_id(req)];
+        if (tmp != NULL && tmp->request == req &&
+            tmp->sent == krad_packet_encode(req)->length)
+            request_finish(tmp, 0, rsp);
     }
 
     krad_packet_free(rsp);
@@ -373,14 +421,44 @@ on_io_read(krad_remote *rr)
 static void
 on_io(verto_ctx *ctx, verto_ev *ev)
 {
-    krad_remote *rr;
+    conn *c;
 
-    rr = verto_get_private(ev);
+    c = verto_get_private(ev);
 
     if (verto_get_fd_state(ev) & VERTO_EV_FLAG_IO_WRITE)
-        on_io_write(rr);
+        on_io_write(c);
     else
-        on_io_read(rr);
+        on_io_read(c);
+}
+
+/* Choose the least loaded socket of rr for a new request, opening another
+ * one if all are busy. */
+static krb5_error_code
+remote_get_conn(krad_remote *rr, conn **out)
+{
+    conn *c = NULL;
+    size_t i;
+
+    for (i = 0; i < rr->nconns; i++) {
+        if (c == NULL || rr->conns[i]->count < c->count)
+            c = rr->conns[i];
+    }
+    if (c != NULL && (c->count < CONN_LOAD || rr->nconns == MAX_CONNS)) {
+        *out = c;
+        return 0;
+    }
+
+    c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return ENOMEM;
+    c->rr = rr;
+    c->fd = -1;
+    c->buffer = make_data(c->buffer_, 0);
+    K5_TAILQ_INIT(&c->list);
+    rr->conns[rr->nconns++] = c;
+
+    *out = c;
+    return 0;
 }
 
 krb5_error_code
@@ -395,9 +473,6 @@ kr_remote_new(krb5_context kctx, verto_ctx *vctx, const struct addrinfo *info,
         goto error;
     tmp->kctx = kctx;
     tmp->vctx = vctx;
-    tmp->buffer = make_data(tmp->buffer_, 0);
-    K5_TAILQ_INIT(&tmp->list);
-    tmp->fd = -1;
 
     tmp->secret = strdup(secret);
     if (tmp->secret == NULL)
@@ -424,17 +499,26 @@ error:
 void
 kr_remote_free(krad_remote *rr)
 {
+    conn *c;
+    size_t i;
+
     if (rr == NULL)
         return;
 
-    while (!K5_TAILQ_EMPTY(&rr->list))
-        request_finish(K5_TAILQ_FIRST(&rr->list), ECANCELED, NULL);
+    for (i = 0; i < rr->nconns; i++) {
+        c = rr->conns[i];
+        while (!K5_TAILQ_EMPTY(&c->list))
+            request_finish(K5_TAILQ_FIRST(&c->list), ECANCELED, NULL);
+    }
 
     free(rr->secret);
     if (rr->info != NULL)
         free(rr->info->ai_addr);
     free(rr->info);
-    remote_disconnect(rr);
+    for (i = 0; i < rr->nconns; i++) {
+        conn_disconnect(rr->conns[i]);
+        free(rr->conns[i]);
+    }
     free(rr);
 }
 
@@ -445,34 +529,39 @@ kr_remote_send(krad_remote *rr, krad_code code, krad_attrset *attrs,
 {
     krad_packet *tmp = NULL;
     krb5_error_code retval;
+    struct id_iter iter;
     request *r;
+    conn *c;
 
     if (rr->info->ai_socktype == SOCK_STREAM)
         retries = 0;
 
-    r = K5_TAILQ_FIRST(&rr->list);
+    retval = remote_get_conn(rr, &c);
+    if (retval != 0)
+        return retval;
+
+    iter.conn = c;
+    iter.i = 0;
     retval = krad_packet_new_request(rr->kctx, rr->secret, code, attrs,
-                                     (krad_packet_iter_cb)iterator, &r, &tmp);
+                                     (krad_packet_iter_cb)iterator, &iter,
+                                     &tmp);
     if (retval != 0)
         goto error;
 
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
-        if (r->request == tmp) {
-            retval = EALREADY;
-            goto error;
-        }
-    }
-
     timeout = timeout / (retries + 1);
-    retval = request_new(rr, tmp, timeout, retries, cb, data, &r);
+    retval = request_new(c, tmp, timeout, retries, cb, data, &r);
     if (retval != 0)
         goto error;
 
-    retval = remote_add_flags(rr, FLAGS_WRITE);
-    if (retval != 0)
+    retval = conn_add_flags(c, FLAGS_WRITE);
+    if (retval != 0) {
+        free(r);
         goto error;
+    }
 
-    K5_TAILQ_INSERT_TAIL(&rr->list, r, list);
+    K5_TAILQ_INSERT_TAIL(&c->list, r, list);
+    c->ids[pkt_id(tmp)] = r;
+    c->count++;
     if (pkt != NULL)
         *pkt = tmp;
     return 0;
@@ -486,9 +575,14 @@ void
 kr_remote_cancel(krad_remote *rr, const krad_packet *pkt)
 {
     request *r;
+    size_t i;
+
+    if (pkt == NULL)
+        return;
 
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
-        if (r->request == pkt) {
+    for (i = 0; i < rr->nconns; i++) {
+        r = rr->conns[i]->ids[pkt_id(pkt)];
+        if (r != NULL && r->request == pkt) {
             request_finish(r, ECANCELED, NULL);
             return;
         }
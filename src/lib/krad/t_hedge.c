@@ -0,0 +1,267 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krad/t_hedge.c - Test krad client remote ordering and hedging */
+/*
+ * Copyright (C) 2017 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/*
+ * This test program runs two RADIUS servers on loopback UDP sockets within
+ * its own event loop, one answering immediately and one after a delay, and
+ * checks that the client tries the faster server first, hedges to the next
+ * server when the first one does not answer in time, and does not report an
+ * error from one server while another may still answer.  It includes
+ * client.c in order to give the request an address list naming both servers.
+ */
+
+#include "t_test.h"
+#include "client.c"
+
+#include <netinet/in.h>
+
+#define SECRET "foo"
+#define TIMEOUT 4000
+#define SLOW_DELAY 300
+
+struct test_server {
+    int fd;
+    struct sockaddr_in addr;
+    int delay;                  /* Milliseconds before answering, or -1 to
+                                 * never answer. */
+    krad_code code;             /* Code of the responses sent. */
+    int received;               /* Number of requests received. */
+};
+
+struct reply {
+    struct test_server *srv;
+    struct sockaddr_storage peer;
+    socklen_t peerlen;
+    size_t len;
+    char buf[KRAD_PACKET_SIZE_MAX];
+};
+
+static krb5_context kctx;
+static verto_ctx *vctx;
+static struct test_server slow, fast;
+static krad_attrset *attrs;
+static krb5_error_code result_retval;
+static krad_code result_code;
+static request *cancel_req;
+
+static void
+send_reply(struct reply *r)
+{
+    (void)sendto(r->srv->fd, r->buf, r->len, 0, (struct sockaddr *)&r->peer,
+                 r->peerlen);
+    free(r);
+}
+
+static void
+on_reply_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    send_reply(verto_get_private(ev));
+}
+
+/* Read a request and answer it, now or after the server's delay. */
+static void
+on_server_io(verto_ctx *ctx, verto_ev *ev)
+{
+    struct test_server *srv = verto_get_private(ev);
+    const krad_packet *dup;
+    krad_packet *req, *rsp;
+    const krb5_data *enc;
+    struct reply *r;
+    char buf[KRAD_PACKET_SIZE_MAX];
+    krb5_data d;
+    ssize_t len;
+    verto_ev *timer;
+
+    r = calloc(1, sizeof(*r));
+    insist(r != NULL);
+    r->srv = srv;
+    r->peerlen = sizeof(r->peer);
+    len = recvfrom(srv->fd, buf, sizeof(buf), 0, (struct sockaddr *)&r->peer,
+                   &r->peerlen);
+    insist(len > 0);
+    srv->received++;
+
+    d = make_data(buf, len);
+    noerror(krad_packet_decode_request(kctx, SECRET, &d, NULL, NULL, &dup,
+                                       &req));
+    noerror(krad_packet_new_response(kctx, SECRET, srv->code, attrs, req,
+                                     &rsp));
+    enc = krad_packet_encode(rsp);
+    memcpy(r->buf, enc->data, enc->length);
+    r->len = enc->length;
+    krad_packet_free(req);
+    krad_packet_free(rsp);
+
+    if (srv->delay < 0) {
+        free(r);
+    } else if (srv->delay == 0) {
+        send_reply(r);
+    } else {
+        timer = verto_add_timeout(vctx, VERTO_EV_FLAG_NONE, on_reply_timeout,
+                                  srv->delay);
+        insist(timer != NULL);
+        verto_set_private(timer, r, NULL);
+    }
+}
+
+static void
+start_server(struct test_server *srv, krad_code code, int delay)
+{
+    socklen_t len = sizeof(srv->addr);
+    verto_ev *ev;
+
+    memset(srv, 0, sizeof(*srv));
+    srv->code = code;
+    srv->delay = delay;
+    srv->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    insist(srv->fd >= 0);
+    srv->addr.sin_family = AF_INET;
+    srv->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    insist(bind(srv->fd, (struct sockaddr *)&srv->addr, len) == 0);
+    insist(getsockname(srv->fd, (struct sockaddr *)&srv->addr, &len) == 0);
+
+    ev = verto_add_io(vctx, VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_READ,
+                      on_server_io, srv->fd);
+    insist(ev != NULL);
+    verto_set_private(ev, srv, NULL);
+}
+
+static void
+callback(krb5_error_code retval, const krad_packet *reqp,
+         const krad_packet *rspp, void *data)
+{
+    result_retval = retval;
+    result_code = (retval == 0) ? krad_packet_get_code(rspp) : 0;
+    verto_break(vctx);
+}
+
+/* Cancel the packet sent to the first remote of cancel_req, as if that
+ * remote had failed. */
+static void
+on_cancel_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    remote_state *rs = &cancel_req->remotes[0];
+
+    kr_remote_cancel(rs->srv->serv, rs->packet);
+}
+
+/* Send a request to the given servers, as krad_client_send() would for a
+ * name resolving to their addresses, and return once it is answered.  If
+ * cancel_ms is positive, make the first remote tried fail after that many
+ * milliseconds. */
+static void
+do_request(krad_client *rc, struct test_server *s1, struct test_server *s2,
+           int cancel_ms)
+{
+    struct addrinfo ai[2];
+    request *req;
+    verto_ev *ev;
+
+    memset(ai, 0, sizeof(ai));
+    ai[0].ai_family = ai[1].ai_family = AF_INET;
+    ai[0].ai_socktype = ai[1].ai_socktype = SOCK_DGRAM;
+    ai[0].ai_addr = (struct sockaddr *)&s1->addr;
+    ai[0].ai_addrlen = sizeof(s1->addr);
+    if (s2 != NULL) {
+        ai[1].ai_addr = (struct sockaddr *)&s2->addr;
+        ai[1].ai_addrlen = sizeof(s2->addr);
+        ai[0].ai_next = &ai[1];
+    }
+
+    noerror(request_new(rc, krad_code_name2num("Access-Request"), attrs, ai,
+                        SECRET, TIMEOUT, 0, callback, NULL, &req));
+    noerror(send_next(req));
+    start_hedge(req);
+
+    if (cancel_ms > 0) {
+        cancel_req = req;
+        ev = verto_add_timeout(vctx, VERTO_EV_FLAG_NONE, on_cancel_timeout,
+                               cancel_ms);
+        insist(ev != NULL);
+    }
+
+    result_retval = -1;
+    verto_run(vctx);
+}
+
+int
+main(int argc, const char **argv)
+{
+    krad_code accept, reject;
+    krad_client *rc;
+    int64_t start;
+    int count;
+
+    noerror(krb5_init_context(&kctx));
+    vctx = verto_new(NULL, VERTO_EV_TYPE_IO | VERTO_EV_TYPE_TIMEOUT);
+    insist(vctx != NULL);
+    noerror(krad_client_new(kctx, vctx, &rc));
+    noerror(krad_attrset_new(kctx, &attrs));
+
+    /* The slow server rejects and the fast one accepts, so the response code
+     * tells which one answered. */
+    accept = krad_code_name2num("Access-Accept");
+    reject = krad_code_name2num("Access-Reject");
+    start_server(&slow, reject, SLOW_DELAY);
+    start_server(&fast, accept, 0);
+
+    /* Learn the response time of each server. */
+    do_request(rc, &slow, NULL, 0);
+    insist(result_retval == 0 && result_code == reject);
+    do_request(rc, &fast, NULL, 0);
+    insist(result_retval == 0 && result_code == accept);
+
+    /* The fast server is tried first even though it is listed second, and
+     * answers before the request is hedged to the slow one. */
+    count = slow.received;
+    do_request(rc, &slow, &fast, 0);
+    insist(result_retval == 0 && result_code == accept);
+    insist(slow.received == count);
+
+    /* If the fast server stops answering, the request is hedged to the slow
+     * server well before it times out on the fast one. */
+    fast.delay = -1;
+    start = now_ms(kctx);
+    do_request(rc, &slow, &fast, 0);
+    insist(result_retval == 0 && result_code == reject);
+    insist(now_ms(kctx) - start < TIMEOUT / 2);
+
+    /* An error from the fast server after the request has been hedged does
+     * not end the request while the slow server may still answer. */
+    do_request(rc, &slow, &fast, SLOW_DELAY / 3);
+    insist(result_retval == 0 && result_code == reject);
+
+    krad_attrset_free(attrs);
+    krad_client_free(rc);
+    verto_free(vctx);
+    krb5_free_context(kctx);
+    return 0;
+}
@@ -30,6 +30,7 @@
 #include "t_daemon.h"
 
 #define EVENT_COUNT 6
+#define BURST_COUNT 600
 
 static struct
 {
@@ -40,6 +41,7 @@ static struct
 static krad_attrset *set;
 static krad_remote *rr;
 static verto_ctx *vctx;
+static int burst_accepted, burst_done;
 
 static void
 callback(krb5_error_code retval, const krad_packet *request,
@@ -56,6 +58,17 @@ callback(krb5_error_code retval, const krad_packet *request,
     verto_break(vctx);
 }
 
+static void
+burst_callback(krb5_error_code retval, const krad_packet *request,
+               const krad_packet *response, void *data)
+{
+    if (retval == 0 &&
+        krad_packet_get_code(response) == krad_code_name2num("Access-Accept"))
+        burst_accepted++;
+    if (++burst_done == BURST_COUNT)
+        verto_break(vctx);
+}
+
 static void
 remote_new(krb5_context kctx, krad_remote **remote)
 {
@@ -93,6 +106,23 @@ do_auth(const char *password, const krad_packet **pkt)
     return 0;
 }
 
+/* Send more requests at once than there are packet ids. */
+static void
+test_burst(void)
+{
+    krb5_data tmp = string2data("accept");
+    int i;
+
+    noerror(krad_attrset_add(set, krad_attr_name2num("User-Password"), &tmp));
+    for (i = 0; i < BURST_COUNT; i++) {
+        noerror(kr_remote_send(rr, krad_code_name2num("Access-Request"), set,
+                               burst_callback, NULL, 5000, 3, NULL));
+    }
+    krad_attrset_del(set, krad_attr_name2num("User-Password"), 0);
+    verto_run(vctx);
+    insist(burst_accepted == BURST_COUNT);
+}
+
 static void
 test_timeout(verto_ctx *ctx, verto_ev *ev)
 {
@@ -132,6 +162,9 @@ main(int argc, const char **argv)
     noerror(do_auth("reject", NULL));
     verto_run(vctx);
 
+    /* Send many packets concurrently. */
+    test_burst();
+
     /* Send canceled packet. */
     insist(verto_add_timeout(vctx, VERTO_EV_FLAG_NONE, test_timeout, 0) !=
            NULL);
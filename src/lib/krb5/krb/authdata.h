@@ -60,10 +60,20 @@ typedef struct _PACTYPE {
     PAC_INFO_BUFFER Buffers[1];
 } PACTYPE;
 
+/*
+ * PAC data may be shared between copies of a PAC (see k5_pac_copy()).  Shared
+ * data is never modified; writers must call k5_pac_unshare() first.
+ */
+struct k5_pac_ref {
+    k5_mutex_t lock;
+    unsigned int count;
+};
+
 struct krb5_pac_data {
     PACTYPE *pac;       /* PAC header + info buffer array */
     krb5_data data;     /* PAC data (including uninitialised header) */
     krb5_boolean verified;
+    struct k5_pac_ref *ref;     /* reference count for data */
 };
 
 
@@ -100,6 +110,9 @@ k5_pac_add_buffer(krb5_context context,
                   krb5_boolean zerofill,
                   krb5_data *out_data);
 
+krb5_error_code
+k5_pac_unshare(krb5_context context, krb5_pac pac);
+
 krb5_error_code
 k5_seconds_since_1970_to_time(krb5_timestamp elapsedSeconds, uint64_t *ntTime);
 
@@ -29,6 +29,87 @@
 
 /* draft-brezak-win2k-krb-authz-00 */
 
+/* Allocate a reference count for PAC data with a single owner. */
+static krb5_error_code
+alloc_ref(struct k5_pac_ref **ref_out)
+{
+    struct k5_pac_ref *ref;
+
+    *ref_out = NULL;
+    ref = malloc(sizeof(*ref));
+    if (ref == NULL)
+        return ENOMEM;
+    if (k5_mutex_init(&ref->lock) != 0) {
+        free(ref);
+        return ENOMEM;
+    }
+    ref->count = 1;
+    *ref_out = ref;
+    return 0;
+}
+
+static void
+free_ref(struct k5_pac_ref *ref)
+{
+    k5_mutex_destroy(&ref->lock);
+    free(ref);
+}
+
+/* Release pac's reference to its data, freeing the data if it was the last
+ * one. */
+static void
+release_data(krb5_pac pac)
+{
+    unsigned int count = 0;
+
+    if (pac->ref != NULL) {
+        k5_mutex_lock(&pac->ref->lock);
+        count = --pac->ref->count;
+        k5_mutex_unlock(&pac->ref->lock);
+        if (count == 0)
+            free_ref(pac->ref);
+    }
+    if (count == 0)
+        zapfree(pac->data.data, pac->data.length);
+    pac->ref = NULL;
+    pac->data = empty_data();
+}
+
+/*
+ * Give pac a private copy of its data if it is shared with other PACs, so
+ * that it can be modified.
+ */
+krb5_error_code
+k5_pac_unshare(krb5_context context, krb5_pac pac)
+{
+    krb5_error_code ret;
+    krb5_boolean shared;
+    struct k5_pac_ref *ref;
+    krb5_data copy;
+
+    k5_mutex_lock(&pac->ref->lock);
+    shared = (pac->ref->count > 1);
+    k5_mutex_unlock(&pac->ref->lock);
+    if (!shared)
+        return 0;
+
+    ret = alloc_ref(&ref);
+    if (ret != 0)
+        return ret;
+
+    ret = krb5int_copy_data_contents(context, &pac->data, &copy);
+    if (ret != 0) {
+        free_ref(ref);
+        return ret;
+    }
+
+    release_data(pac);
+    pac->data = copy;
+    pac->ref = ref;
+
+    return 0;
+}
+
 /*
  * Add a buffer to the provided PAC and update header.
  */
@@ -40,6 +121,7 @@ k5_pac_add_buffer(krb5_context context,
                   krb5_boolean zerofill,
                   krb5_data *out_data)
 {
+    krb5_error_code ret;
     PACTYPE *header;
     size_t header_len, i, pad = 0;
     char *pac_data;
@@ -51,6 +133,10 @@ k5_pac_add_buffer(krb5_context context,
         return EEXIST;
     }
 
+    ret = k5_pac_unshare(context, pac);
+    if (ret != 0)
+        return ret;
+
     header = (PACTYPE *)realloc(pac->pac,
                                 sizeof(PACTYPE) +
                                 (pac->pac->cBuffers * sizeof(PAC_INFO_BUFFER)));
@@ -125,10 +211,7 @@ krb5_pac_free(krb5_context context,
               krb5_pac pac)
 {
     if (pac != NULL) {
-        if (pac->data.data != NULL) {
-            memset(pac->data.data, 0, pac->data.length);
-            free(pac->data.data);
-        }
+        release_data(pac);
         if (pac->pac != NULL)
             free(pac->pac);
         memset(pac, 0, sizeof(*pac));
@@ -224,6 +307,7 @@ krb5_error_code KRB5_CALLCONV
 krb5_pac_init(krb5_context context,
               krb5_pac *ppac)
 {
+    krb5_error_code ret;
     krb5_pac pac;
 
     pac = (krb5_pac)malloc(sizeof(*pac));
@@ -238,6 +322,7 @@ krb5_pac_init(krb5_context context,
 
     pac->pac->cBuffers = 0;
     pac->pac->Version = 0;
+    pac->ref = NULL;
 
     pac->data.length = PACTYPE_LENGTH;
     pac->data.data = calloc(1, pac->data.length);
@@ -246,6 +331,12 @@ krb5_pac_init(krb5_context context,
         return ENOMEM;
     }
 
+    ret = alloc_ref(&pac->ref);
+    if (ret != 0) {
+        krb5_pac_free(context, pac);
+        return ret;
+    }
+
     pac->verified = FALSE;
 
     *ppac = pac;
@@ -253,6 +344,7 @@ krb5_pac_init(krb5_context context,
     return 0;
 }
 
+/* Copy src into *dst.  The PAC data is shared with src rather than copied. */
 static krb5_error_code
 k5_pac_copy(krb5_context context,
             krb5_pac src,
@@ -279,12 +371,11 @@ k5_pac_copy(krb5_context context,
         return code;
     }
 
-    code = krb5int_copy_data_contents(context, &src->data, &pac->data);
-    if (code != 0) {
-        free(pac->pac);
-        free(pac);
-        return ENOMEM;
-    }
+    k5_mutex_lock(&src->ref->lock);
+    src->ref->count++;
+    k5_mutex_unlock(&src->ref->lock);
+    pac->ref = src->ref;
+    pac->data = src->data;
 
     pac->verified = src->verified;
     *dst = pac;
@@ -467,18 +558,21 @@ k5_pac_validate_client(krb5_context context,
     return ret;
 }
 
+/*
+ * Find the first signature buffer of the given type in pac and set *start and
+ * *end to the bounds of its checksum bytes within the PAC data.
+ */
 static krb5_error_code
-k5_pac_zero_signature(krb5_context context,
-                      const krb5_pac pac,
-                      krb5_ui_4 type,
-                      krb5_data *data)
+k5_pac_locate_signature(const krb5_pac pac,
+                        krb5_ui_4 type,
+                        size_t *start,
+                        size_t *end)
 {
     PAC_INFO_BUFFER *buffer = NULL;
     size_t i;
 
     assert(type == KRB5_PAC_SERVER_CHECKSUM ||
            type == KRB5_PAC_PRIVSVR_CHECKSUM);
-    assert(data->length >= pac->data.length);
 
     for (i = 0; i < pac->pac->cBuffers; i++) {
         if (pac->pac->Buffers[i].ulType == type) {
@@ -496,25 +590,29 @@ k5_pac_zero_signature(krb5_context context,
     if (buffer->cbBufferSize < PAC_SIGNATURE_DATA_LENGTH)
         return KRB5_BAD_MSIZE;
 
-    /* Zero out the data portion of the checksum only */
-    memset(data->data + buffer->Offset + PAC_SIGNATURE_DATA_LENGTH,
-           0,
-           buffer->cbBufferSize - PAC_SIGNATURE_DATA_LENGTH);
+    *start = buffer->Offset + PAC_SIGNATURE_DATA_LENGTH;
+    *end = buffer->Offset + buffer->cbBufferSize;
 
     return 0;
 }
 
+/*
+ * Verify the server checksum, which is computed over the PAC with the checksum
+ * bytes of both signatures zeroed.  Rather than copying the PAC, checksum it
+ * as a sequence of IOVs with a zero buffer substituted for the signatures.
+ */
 static krb5_error_code
 k5_pac_verify_server_checksum(krb5_context context,
                               const krb5_pac pac,
                               const krb5_keyblock *server)
 {
     krb5_error_code ret;
-    krb5_data pac_data; /* PAC with zeroed checksums */
-    krb5_checksum checksum;
+    krb5_cksumtype cksumtype;
     krb5_data checksum_data;
+    krb5_crypto_iov iov[6];
     krb5_boolean valid;
-    krb5_octet *p;
+    size_t start[2], end[2], tmp, pos, zlen = 0, nsigs = 2, niov = 0, i;
+    char *zeros;
 
     ret = k5_pac_locate_buffer(context, pac, KRB5_PAC_SERVER_CHECKSUM,
                                &checksum_data);
@@ -524,42 +622,64 @@ k5_pac_verify_server_checksum(krb5_context context,
     if (checksum_data.length < PAC_SIGNATURE_DATA_LENGTH)
         return KRB5_BAD_MSIZE;
 
-    p = (krb5_octet *)checksum_data.data;
-    checksum.checksum_type = load_32_le(p);
-    checksum.length = checksum_data.length - PAC_SIGNATURE_DATA_LENGTH;
-    checksum.contents = p + PAC_SIGNATURE_DATA_LENGTH;
-    if (!krb5_c_is_keyed_cksum(checksum.checksum_type))
+    cksumtype = load_32_le(checksum_data.data);
+    if (!krb5_c_is_keyed_cksum(cksumtype))
         return KRB5KRB_AP_ERR_INAPP_CKSUM;
 
-    pac_data.length = pac->data.length;
-    pac_data.data = k5memdup(pac->data.data, pac->data.length, &ret);
-    if (pac_data.data == NULL)
+    ret = k5_pac_locate_signature(pac, KRB5_PAC_SERVER_CHECKSUM,
+                                  &start[0], &end[0]);
+    if (ret != 0)
         return ret;
 
-    /* Zero out both checksum buffers */
-    ret = k5_pac_zero_signature(context, pac, KRB5_PAC_SERVER_CHECKSUM,
-                                &pac_data);
-    if (ret != 0) {
-        free(pac_data.data);
+    ret = k5_pac_locate_signature(pac, KRB5_PAC_PRIVSVR_CHECKSUM,
+                                  &start[1], &end[1]);
+    if (ret != 0)
         return ret;
+
+    /* Order the two signature regions, merging them if they overlap. */
+    if (start[1] < start[0]) {
+        tmp = start[0], start[0] = start[1], start[1] = tmp;
+        tmp = end[0], end[0] = end[1], end[1] = tmp;
+    }
+    if (start[1] <= end[0]) {
+        end[0] = (end[1] > end[0]) ? end[1] : end[0];
+        nsigs = 1;
     }
 
-    ret = k5_pac_zero_signature(context, pac, KRB5_PAC_PRIVSVR_CHECKSUM,
-                                &pac_data);
-    if (ret != 0) {
-        free(pac_data.data);
+    for (i = 0; i < nsigs; i++) {
+        if (end[i] - start[i] > zlen)
+            zlen = end[i] - start[i];
+    }
+    zeros = k5alloc(zlen, &ret);
+    if (zeros == NULL)
         return ret;
+
+    pos = 0;
+    for (i = 0; i < nsigs; i++) {
+        iov[niov].flags = KRB5_CRYPTO_TYPE_DATA;
+        iov[niov++].data = make_data(pac->data.data + pos, start[i] - pos);
+        iov[niov].flags = KRB5_CRYPTO_TYPE_DATA;
+        iov[niov++].data = make_data(zeros, end[i] - start[i]);
+        pos = end[i];
     }
+    iov[niov].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[niov++].data = make_data(pac->data.data + pos,
+                                 pac->data.length - pos);
 
-    ret = krb5_c_verify_checksum(context, server,
-                                 KRB5_KEYUSAGE_APP_DATA_CKSUM,
-                                 &pac_data, &checksum, &valid);
+    iov[niov].flags = KRB5_CRYPTO_TYPE_CHECKSUM;
+    iov[niov++].data = make_data(checksum_data.data +
+                                 PAC_SIGNATURE_DATA_LENGTH,
+                                 checksum_data.length -
+                                 PAC_SIGNATURE_DATA_LENGTH);
 
-    free(pac_data.data);
+    ret = krb5_c_verify_checksum_iov(context, cksumtype, server,
+                                     KRB5_KEYUSAGE_APP_DATA_CKSUM,
+                                     iov, niov, &valid);
 
-    if (ret != 0) {
+    free(zeros);
+
+    if (ret != 0)
         return ret;
-    }
 
     if (valid == FALSE)
         ret = KRB5KRB_AP_ERR_BAD_INTEGRITY;
@@ -1070,12 +1190,9 @@ mspac_export_internal(krb5_context kcontext,
     if (restrict_authenticated && (pacctx->pac->verified) == FALSE)
         return ENOENT;
 
-    code = krb5_pac_parse(kcontext, pacctx->pac->data.data,
-                          pacctx->pac->data.length, &pac);
-    if (code == 0) {
-        pac->verified = pacctx->pac->verified;
+    code = k5_pac_copy(kcontext, pacctx->pac, &pac);
+    if (code == 0)
         *ptr = pac;
-    }
 
     return code;
 }
@@ -192,6 +192,11 @@ krb5_pac_sign(krb5_context context, krb5_pac pac, krb5_timestamp authtime,
     data->length = 0;
     data->data = NULL;
 
+    /* Signing modifies the PAC data in place. */
+    ret = k5_pac_unshare(context, pac);
+    if (ret != 0)
+        return ret;
+
     if (principal != NULL) {
         ret = k5_insert_client_info(context, pac, authtime, principal);
         if (ret != 0)
@@ -69,6 +69,7 @@
 #define KDB_DB2_DATABASE_NAME "database_name"
 
 #define SUFFIX_DB ""
+#define SUFFIX_DB_NEW ".new"
 #define SUFFIX_LOCK ".ok"
 #define SUFFIX_POLICY ".kadm5"
 #define SUFFIX_POLICY_LOCK ".kadm5.lock"
@@ -115,6 +116,14 @@
  * update on the master would be somewhat more serious, but this would
  * likely be noticed by an administrator, who could fix the problem and
  * retry the operation.
+ *
+ * If the snapshot_reads option is set, the principal database file is
+ * never modified once it has been put in place.  A writer copies it to a
+ * working file after acquiring the exclusive lock, makes its changes there,
+ * and renames the working file over the database before releasing the lock.
+ * Principal lookups then need no lock: they read whichever version of the
+ * database was in place when it was opened, and reopen it when a newer one
+ * is published.
  */
 
 /* Evaluate to true if the krb5_context c contains an initialized db2
@@ -170,6 +179,7 @@ ctx_clear(krb5_db2_context *dbc)
     dbc->db_name = NULL;
     dbc->db_nb_locks = FALSE;
     dbc->tempdb = FALSE;
+    dbc->page_size = 4096;
 }
 
 /* Set *dbc_out to the db2 database context for context.  If one does not
@@ -205,7 +215,7 @@ configure_context(krb5_context context, char *conf_section, char **db_args)
     krb5_db2_context *dbc;
     char **t_ptr, *opt = NULL, *val = NULL, *pval = NULL;
     profile_t profile = KRB5_DB_GET_PROFILE(context);
-    int bval;
+    int bval, ival;
 
     status = ctx_get(context, &dbc);
     if (status != 0)
@@ -276,6 +286,42 @@ configure_context(krb5_context context, char *conf_section, char **db_args)
         goto cleanup;
     dbc->disable_lockout = bval;
 
+    status = profile_get_boolean(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_SNAPSHOT_READS, FALSE, &bval);
+    if (status != 0)
+        goto cleanup;
+    dbc->snapshot = bval && !dbc->tempdb;
+
+    /* libdb2 requires a page size which is a power of two between 512 and
+     * 65536 bytes.  It only applies when a database is created. */
+    status = profile_get_integer(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_PAGE_SIZE, 4096, &ival);
+    if (status != 0)
+        goto cleanup;
+    if (ival < 512 || ival > 65536 || (ival & (ival - 1)) != 0) {
+        status = EINVAL;
+        k5_setmsg(context, status, _("Invalid DB2 page size %d"), ival);
+        goto cleanup;
+    }
+    dbc->page_size = ival;
+
+    status = profile_get_integer(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_CACHE_SIZE, 0, &ival);
+    if (status != 0)
+        goto cleanup;
+    if (ival < 0) {
+        status = EINVAL;
+        k5_setmsg(context, status, _("Invalid DB2 cache size %d"), ival);
+        goto cleanup;
+    }
+    dbc->cache_size = ival;
+
+    status = profile_get_boolean(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_MMAP_READS, FALSE, &bval);
+    if (status != 0)
+        goto cleanup;
+    dbc->mmap_reads = bval;
+
 cleanup:
     free(opt);
     free(val);
@@ -338,28 +384,29 @@ error:
  * indicated the wrong type, update it to indicate the correct type.
  */
 static krb5_error_code
-open_db(krb5_context context, krb5_db2_context *dbc, int flags, int mode,
-        DB **db_out)
+open_db_file(krb5_context context, krb5_db2_context *dbc, const char *fname,
+             int flags, int mode, DB **db_out)
 {
-    char *fname = NULL;
     DB *db;
     BTREEINFO bti;
     HASHINFO hashi;
     bti.flags = 0;
-    bti.cachesize = 0;
-    bti.psize = 4096;
+    bti.cachesize = dbc->cache_size;
+    bti.psize = dbc->page_size;
     bti.lorder = 0;
     bti.minkeypage = 0;
     bti.compare = NULL;
     bti.prefix = NULL;
+#ifdef R_MMAP
+    /* Read btree pages in place rather than copying them into the cache. */
+    if (dbc->mmap_reads && (flags & O_ACCMODE) == O_RDONLY)
+        bti.flags |= R_MMAP;
+#endif
 
     *db_out = NULL;
 
-    if (ctx_dbsuffix(dbc, SUFFIX_DB, &fname) != 0)
-        return ENOMEM;
-
     hashi.bsize = 4096;
-    hashi.cachesize = 0;
+    hashi.cachesize = dbc->cache_size;
     hashi.ffactor = 40;
     hashi.hash = NULL;
     hashi.lorder = 0;
@@ -389,29 +436,259 @@ open_db(krb5_context context, krb5_db2_context *dbc, int flags, int mode,
     }
 
     *db_out = db;
-    free(fname);
     return (db == NULL) ? errno : 0;
 }
 
+/* Open the DB2 database described by dbc as with open_db_file(). */
+static krb5_error_code
+open_db(krb5_context context, krb5_db2_context *dbc, int flags, int mode,
+        DB **db_out)
+{
+    krb5_error_code retval;
+    char *fname;
+
+    *db_out = NULL;
+    if (ctx_dbsuffix(dbc, SUFFIX_DB, &fname) != 0)
+        return ENOMEM;
+    retval = open_db_file(context, dbc, fname, flags, mode, db_out);
+    free(fname);
+    return retval;
+}
+
+/* Copy the file src to dst, creating or truncating dst, with the permissions
+ * of src. */
+static krb5_error_code
+copy_file(const char *src, const char *dst)
+{
+    krb5_error_code retval = 0;
+    int sfd, dfd;
+    struct stat st;
+    char buf[32768];
+    ssize_t nread, nwritten, pos;
+
+    sfd = open(src, O_RDONLY);
+    if (sfd == -1)
+        return errno;
+    if (fstat(sfd, &st) == -1) {
+        retval = errno;
+        close(sfd);
+        return retval;
+    }
+    dfd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+    if (dfd == -1) {
+        retval = errno;
+        close(sfd);
+        return retval;
+    }
+    while ((nread = read(sfd, buf, sizeof(buf))) != 0) {
+        if (nread == -1) {
+            if (errno == EINTR)
+                continue;
+            retval = errno;
+            break;
+        }
+        for (pos = 0; pos < nread; pos += nwritten) {
+            nwritten = write(dfd, buf + pos, nread - pos);
+            if (nwritten == -1) {
+                if (errno != EINTR) {
+                    retval = errno;
+                    goto cleanup;
+                }
+                nwritten = 0;
+            }
+        }
+    }
+    if (retval == 0 && fchmod(dfd, st.st_mode & 0777) == -1)
+        retval = errno;
+
+cleanup:
+    close(sfd);
+    if (close(dfd) == -1 && retval == 0)
+        retval = errno;
+    return retval;
+}
+
+/* Copy the database described by dbc to its working file and open the copy
+ * for writing as dbc->db. */
+static krb5_error_code
+open_snapshot_copy(krb5_context context, krb5_db2_context *dbc)
+{
+    krb5_error_code retval;
+    char *fname = NULL, *newname = NULL;
+
+    retval = ctx_dbsuffix(dbc, SUFFIX_DB, &fname);
+    if (retval)
+        goto cleanup;
+    retval = ctx_dbsuffix(dbc, SUFFIX_DB SUFFIX_DB_NEW, &newname);
+    if (retval)
+        goto cleanup;
+    retval = copy_file(fname, newname);
+    if (retval) {
+        k5_setmsg(context, retval, _("Cannot copy DB2 database '%s' to '%s'"),
+                  fname, newname);
+        goto cleanup;
+    }
+    retval = open_db_file(context, dbc, newname, O_RDWR, 0600, &dbc->db);
+    if (retval) {
+        (void)unlink(newname);
+        goto cleanup;
+    }
+    dbc->snapshot_dirty = FALSE;
+
+cleanup:
+    free(fname);
+    free(newname);
+    return retval;
+}
+
+/*
+ * Close the working copy of the database opened by open_snapshot_copy() and,
+ * if it was changed, rename it into place so that readers see the changes.
+ * Otherwise discard it.
+ */
+static krb5_error_code
+publish_snapshot(krb5_context context, krb5_db2_context *dbc)
+{
+    krb5_error_code retval = 0;
+    char *fname = NULL, *newname = NULL;
+    DB *db = dbc->db;
+
+    dbc->db = NULL;
+    if (dbc->snapshot_dirty &&
+        (db->sync(db, 0) != 0 || fsync(db->fd(db)) != 0))
+        retval = errno;
+    if (db->close(db) != 0 && retval == 0)
+        retval = errno;
+
+    if (ctx_dbsuffix(dbc, SUFFIX_DB, &fname) != 0 ||
+        ctx_dbsuffix(dbc, SUFFIX_DB SUFFIX_DB_NEW, &newname) != 0) {
+        retval = ENOMEM;
+        goto cleanup;
+    }
+    if (retval == 0 && dbc->snapshot_dirty && rename(newname, fname) != 0) {
+        retval = errno;
+        k5_setmsg(context, retval, _("Cannot rename '%s' to '%s'"),
+                  newname, fname);
+    }
+    if (retval != 0 || !dbc->snapshot_dirty)
+        (void)unlink(newname);
+
+cleanup:
+    dbc->snapshot_dirty = FALSE;
+    free(fname);
+    free(newname);
+    return retval;
+}
+
+/* Close the DB handle of dbc, if one is open. */
+static void
+ctx_close_db(krb5_db2_context *dbc)
+{
+    if (dbc->db != NULL)
+        dbc->db->close(dbc->db);
+    dbc->db = NULL;
+}
+
+/*
+ * Record the identity of the DB file opened as dbc->db and the current
+ * modification time of the lock file.  Every change to the database updates
+ * the lock file time (see ctx_update_age()) and replacing the database
+ * changes its inode, so comparing these later tells us whether a read-only
+ * handle is still current.
+ */
+static void
+ctx_stamp_db(krb5_db2_context *dbc)
+{
+    struct stat st;
+
+    dbc->db_pid = getpid();
+    dbc->db_dev = 0;
+    dbc->db_ino = 0;
+    dbc->db_lf_mtime = 0;
+    if (fstat(dbc->db->fd(dbc->db), &st) == 0) {
+        dbc->db_dev = st.st_dev;
+        dbc->db_ino = st.st_ino;
+    }
+    if (fstat(dbc->db_lf_file, &st) == 0)
+        dbc->db_lf_mtime = st.st_mtime;
+}
+
+/* Return true if the read-only handle dbc->db was opened by this process on
+ * the file which is currently in place as the database. */
+static krb5_boolean
+ctx_db_in_place(krb5_db2_context *dbc)
+{
+    struct stat st;
+    char *fname;
+    int ret;
+
+    /* A handle inherited across fork() shares its file offset with the
+     * parent. */
+    if (dbc->db_pid != getpid() || dbc->db_ino == 0)
+        return FALSE;
+    if (ctx_dbsuffix(dbc, SUFFIX_DB, &fname) != 0)
+        return FALSE;
+    ret = stat(fname, &st);
+    free(fname);
+    return ret == 0 && st.st_dev == dbc->db_dev && st.st_ino == dbc->db_ino;
+}
+
+/* Return true if the read-only handle dbc->db, kept open since a previous
+ * lock, can be reused.  The caller must hold the lock. */
+static krb5_boolean
+ctx_db_current(krb5_db2_context *dbc)
+{
+    struct stat st;
+
+    if (fstat(dbc->db_lf_file, &st) != 0 || st.st_mtime != dbc->db_lf_mtime)
+        return FALSE;
+    return ctx_db_in_place(dbc);
+}
+
+/*
+ * Make dbc->db a read-only handle on the database currently in place, without
+ * locking it.  Only valid in snapshot mode, in which the file is not modified
+ * once in place.  The caller must not hold the lock.
+ */
+static krb5_error_code
+ctx_open_snapshot(krb5_context context, krb5_db2_context *dbc)
+{
+    krb5_error_code retval;
+
+    if (dbc->db != NULL && ctx_db_in_place(dbc))
+        return 0;
+    ctx_close_db(dbc);
+    retval = open_db(context, dbc, O_RDONLY, 0, &dbc->db);
+    if (retval)
+        return retval;
+    ctx_stamp_db(dbc);
+    return 0;
+}
+
 static krb5_error_code
 ctx_unlock(krb5_context context, krb5_db2_context *dbc)
 {
-    krb5_error_code retval, retval2;
-    DB *db;
+    krb5_error_code retval, retval2, pubret = 0;
 
     retval = osa_adb_release_lock(dbc->policy_db);
 
     if (!dbc->db_locks_held) /* lock already unlocked */
         return KRB5_KDB_NOTLOCKED;
 
-    db = dbc->db;
     if (--(dbc->db_locks_held) == 0) {
-        db->close(db);
-        dbc->db = NULL;
+        /* Keep a read-only handle open for reuse by the next lock, saving
+         * the cost of reopening the database for each lookup.  Publish any
+         * snapshot changes while we still hold the lock. */
+        if (dbc->snapshot && dbc->db_lock_mode == KRB5_LOCKMODE_EXCLUSIVE)
+            pubret = publish_snapshot(context, dbc);
+        else if (dbc->db_lock_mode != KRB5_LOCKMODE_SHARED)
+            ctx_close_db(dbc);
         dbc->db_lock_mode = 0;
 
         retval2 = krb5_lock_file(context, dbc->db_lf_file,
                                 KRB5_LOCKMODE_UNLOCK);
+        if (pubret)
+            return pubret;
         if (retval2)
             return retval2;
     }
@@ -447,12 +724,22 @@ ctx_lock(krb5_context context, krb5_db2_context *dbc, int lockmode)
         else if (retval)
             return retval;
 
-        /* Open the DB (or re-open it for read/write). */
-        if (dbc->db != NULL)
-            dbc->db->close(dbc->db);
-        retval = open_db(context, dbc,
-                         kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY : O_RDWR,
-                         0600, &dbc->db);
+        /* Open the DB (or re-open it for read/write), unless we have a
+         * current read-only handle and only need to read. */
+        if (dbc->db != NULL && dbc->db_locks_held == 0 &&
+            kmode == KRB5_LOCKMODE_SHARED && ctx_db_current(dbc)) {
+            retval = 0;
+        } else if (dbc->snapshot && kmode == KRB5_LOCKMODE_EXCLUSIVE) {
+            ctx_close_db(dbc);
+            retval = open_snapshot_copy(context, dbc);
+        } else {
+            ctx_close_db(dbc);
+            retval = open_db(context, dbc,
+                             kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY : O_RDWR,
+                             0600, &dbc->db);
+            if (retval == 0)
+                ctx_stamp_db(dbc);
+        }
         if (retval) {
             dbc->db_locks_held = 0;
             dbc->db_lock_mode = 0;
@@ -522,6 +809,7 @@ cleanup:
 static void
 ctx_fini(krb5_db2_context *dbc)
 {
+    ctx_close_db(dbc);
     if (dbc->db_lf_file != -1)
         (void) close(dbc->db_lf_file);
     if (dbc->policy_db)
@@ -761,6 +1049,7 @@ krb5_db2_get_principal(krb5_context context, krb5_const_principal searchfor,
     DBT     key, contents;
     krb5_data keydata, contdata;
     int     dbret;
+    krb5_boolean locked;
 
     *entry = NULL;
     if (!inited(context))
@@ -768,7 +1057,13 @@ krb5_db2_get_principal(krb5_context context, krb5_const_principal searchfor,
 
     dbc = context->dal_handle->db_context;
 
-    retval = ctx_lock(context, dbc, KRB5_LOCKMODE_SHARED);
+    /* In snapshot mode, read the published database without locking it,
+     * unless we already hold the lock and may have changes of our own. */
+    locked = !dbc->snapshot || dbc->db_locks_held > 0;
+    if (locked)
+        retval = ctx_lock(context, dbc, KRB5_LOCKMODE_SHARED);
+    else
+        retval = ctx_open_snapshot(context, dbc);
     if (retval)
         return retval;
 
@@ -798,7 +1093,8 @@ krb5_db2_get_principal(krb5_context context, krb5_const_principal searchfor,
     }
 
 cleanup:
-    (void) krb5_db2_unlock(context); /* unlock read lock */
+    if (locked)
+        (void) krb5_db2_unlock(context); /* unlock read lock */
     return retval;
 }
 
@@ -810,7 +1106,7 @@ krb5_db2_put_principal(krb5_context context, krb5_db_entry *entry,
     DB     *db;
     DBT     key, contents;
     krb5_data contdata, keydata;
-    krb5_error_code retval;
+    krb5_error_code retval, retval2;
     krb5_db2_context *dbc;
 
     krb5_clear_error_message (context);
@@ -847,17 +1143,19 @@ krb5_db2_put_principal(krb5_context context, krb5_db_entry *entry,
     retval = dbret ? errno : 0;
     krb5_free_data_contents(context, &keydata);
     krb5_free_data_contents(context, &contdata);
+    if (retval == 0)
+        dbc->snapshot_dirty = TRUE;
 
 cleanup:
     ctx_update_age(dbc);
-    (void) krb5_db2_unlock(context); /* unlock database */
-    return (retval);
+    retval2 = krb5_db2_unlock(context); /* unlock database */
+    return retval ? retval : retval2;
 }
 
 krb5_error_code
 krb5_db2_delete_principal(krb5_context context, krb5_const_principal searchfor)
 {
-    krb5_error_code retval;
+    krb5_error_code retval, retval2;
     krb5_db_entry *entry;
     krb5_db2_context *dbc;
     DB     *db;
@@ -918,13 +1216,15 @@ krb5_db2_delete_principal(krb5_context context, krb5_const_principal searchfor)
         goto cleankey;
     dbret = (*db->del) (db, &key, 0);
     retval = dbret ? errno : 0;
+    if (retval == 0)
+        dbc->snapshot_dirty = TRUE;
 cleankey:
     krb5_free_data_contents(context, &keydata);
 
 cleanup:
     ctx_update_age(dbc);
-    (void) krb5_db2_unlock(context); /* unlock write lock */
-    return retval;
+    retval2 = krb5_db2_unlock(context); /* unlock write lock */
+    return retval ? retval : retval2;
 }
 
 typedef krb5_error_code (*ctx_iterate_cb)(krb5_pointer, krb5_db_entry *);
@@ -940,6 +1240,9 @@ typedef struct iter_curs {
     krb5_db2_context *dbc;
     int lockmode;
     krb5_boolean islocked;
+    krb5_boolean namesonly;
+    char *prefix;
+    size_t prefixlen;
 } iter_curs;
 
 /* Lock DB handle of curs, updating curs->islocked. */
@@ -963,11 +1266,45 @@ curs_unlock(iter_curs *curs)
     curs->islocked = FALSE;
 }
 
-/* Set up curs and lock DB. */
+/*
+ * Set *prefix_out to the literal characters at the start of the shell-style
+ * glob match_expr, removing the backslashes which quote metacharacters.
+ */
+static krb5_error_code
+glob_prefix(const char *match_expr, char **prefix_out, size_t *len_out)
+{
+    const char *p;
+    char *prefix;
+    size_t len = 0;
+
+    *prefix_out = NULL;
+    *len_out = 0;
+    prefix = malloc(strlen(match_expr) + 1);
+    if (prefix == NULL)
+        return ENOMEM;
+    for (p = match_expr; *p != '\0' && strchr("*?[", *p) == NULL; p++) {
+        if (*p == '\\') {
+            if (p[1] == '\0')
+                break;
+            p++;
+        }
+        prefix[len++] = *p;
+    }
+    *prefix_out = prefix;
+    *len_out = len;
+    return 0;
+}
+
+/*
+ * Set up curs and lock DB.  If match_expr (a shell-style glob) begins with
+ * literal characters and the database is a btree iterated in forward order,
+ * restrict the cursor to the keys beginning with those characters.
+ */
 static krb5_error_code
 curs_init(iter_curs *curs, krb5_context ctx, krb5_db2_context *dbc,
-          krb5_flags iterflags)
+          const char *match_expr, krb5_flags iterflags)
 {
+    krb5_error_code retval;
     int isrecurse = iterflags & KRB5_DB_ITER_RECURSE;
     unsigned int prevflag = R_PREV;
     unsigned int nextflag = R_NEXT;
@@ -977,6 +1314,22 @@ curs_init(iter_curs *curs, krb5_context ctx, krb5_db2_context *dbc,
     curs->islocked = FALSE;
     curs->ctx = ctx;
     curs->dbc = dbc;
+    curs->namesonly = (iterflags & KRB5_DB_ITER_NAMES_ONLY) != 0;
+    curs->prefix = NULL;
+    curs->prefixlen = 0;
+    if (match_expr != NULL && !dbc->hashfirst &&
+        !(iterflags & (KRB5_DB_ITER_REV | KRB5_DB_ITER_RECURSE))) {
+        retval = glob_prefix(match_expr, &curs->prefix, &curs->prefixlen);
+        if (retval)
+            return retval;
+    } else if (iterflags & KRB5_DB_ITER_PREFIX) {
+        k5_setmsg(ctx, KRB5_PLUGIN_OP_NOTSUPP,
+                  dbc->hashfirst ?
+                  _("Prefix iteration is not supported for hash databases") :
+                  _("Prefix iteration is not supported in reverse or "
+                    "recursive order"));
+        return KRB5_PLUGIN_OP_NOTSUPP;
+    }
 
     if (iterflags & KRB5_DB_ITER_WRITE)
         curs->lockmode = KRB5_LOCKMODE_EXCLUSIVE;
@@ -1014,9 +1367,48 @@ curs_start(iter_curs *curs)
 {
     DB *db = curs->dbc->db;
 
+    if (curs->prefixlen > 0) {
+        /* Position the btree cursor at the first key not less than the
+         * prefix. */
+        curs->key.data = curs->prefix;
+        curs->key.size = curs->prefixlen;
+        return db->seq(db, &curs->key, &curs->data, R_CURSOR);
+    }
     return db->seq(db, &curs->key, &curs->data, curs->startflag);
 }
 
+/* Return true if the current key of curs is within the iteration range. */
+static krb5_boolean
+curs_in_range(iter_curs *curs)
+{
+    return curs->key.size >= curs->prefixlen &&
+        memcmp(curs->key.data, curs->prefix, curs->prefixlen) == 0;
+}
+
+/* Create an entry containing only the principal name from the current key of
+ * curs. */
+static krb5_error_code
+curs_name_entry(iter_curs *curs, krb5_db_entry **entry_out)
+{
+    krb5_error_code retval;
+    krb5_db_entry *entry;
+    const char *name = curs->key.data;
+
+    *entry_out = NULL;
+    if (curs->key.size == 0 || name[curs->key.size - 1] != '\0')
+        return KRB5_KDB_TRUNCATED_RECORD;
+    entry = k5alloc(sizeof(*entry), &retval);
+    if (entry == NULL)
+        return retval;
+    retval = krb5_parse_name(curs->ctx, name, &entry->princ);
+    if (retval) {
+        free(entry);
+        return retval;
+    }
+    *entry_out = entry;
+    return 0;
+}
+
 /* Save iteration state so DB can be unlocked/closed. */
 static krb5_error_code
 curs_save(iter_curs *curs)
@@ -1072,8 +1464,12 @@ curs_run_cb(iter_curs *curs, ctx_iterate_cb func, krb5_pointer func_arg)
     krb5_context ctx = curs->ctx;
     krb5_data contdata;
 
-    contdata = make_data(curs->data.data, curs->data.size);
-    retval = krb5_decode_princ_entry(ctx, &contdata, &entry);
+    if (curs->namesonly) {
+        retval = curs_name_entry(curs, &entry);
+    } else {
+        contdata = make_data(curs->data.data, curs->data.size);
+        retval = krb5_decode_princ_entry(ctx, &contdata, &entry);
+    }
     if (retval)
         return retval;
     /* Save libdb key across possible DB closure. */
@@ -1101,23 +1497,25 @@ static void
 curs_fini(iter_curs *curs)
 {
     curs_free(curs);
+    free(curs->prefix);
+    curs->prefix = NULL;
     if (curs->islocked)
         curs_unlock(curs);
 }
 
 static krb5_error_code
-ctx_iterate(krb5_context context, krb5_db2_context *dbc,
+ctx_iterate(krb5_context context, krb5_db2_context *dbc, const char *match_expr,
             ctx_iterate_cb func, krb5_pointer func_arg, krb5_flags iterflags)
 {
     krb5_error_code retval;
     int dbret;
     iter_curs curs;
 
-    retval = curs_init(&curs, context, dbc, iterflags);
+    retval = curs_init(&curs, context, dbc, match_expr, iterflags);
     if (retval)
-        return retval;
+        goto cleanup;
     dbret = curs_start(&curs);
-    while (dbret == 0) {
+    while (dbret == 0 && curs_in_range(&curs)) {
         retval = curs_run_cb(&curs, func, func_arg);
         if (retval)
             goto cleanup;
@@ -1142,8 +1540,8 @@ krb5_db2_iterate(krb5_context context, char *match_expr, ctx_iterate_cb func,
 {
     if (!inited(context))
         return KRB5_KDB_DBNOTINITED;
-    return ctx_iterate(context, context->dal_handle->db_context, func,
-                       func_arg, iterflags);
+    return ctx_iterate(context, context->dal_handle->db_context, match_expr,
+                       func, func_arg, iterflags);
 }
 
 krb5_boolean
@@ -1415,7 +1813,8 @@ ctx_merge_nra(krb5_context context, krb5_db2_context *dbc_temp,
 
     nra.kcontext = context;
     nra.db_context = dbc_real;
-    return ctx_iterate(context, dbc_temp, krb5_db2_merge_nra_iterator, &nra, 0);
+    return ctx_iterate(context, dbc_temp, NULL, krb5_db2_merge_nra_iterator,
+                       &nra, 0);
 }
 
 /*
@@ -37,6 +37,10 @@ typedef struct _krb5_db2_context {
     krb5_boolean        db_inited;      /* Context initialized          */
     char *              db_name;        /* Name of database             */
     DB *                db;             /* DB handle                    */
+    pid_t               db_pid;         /* Process which opened db      */
+    dev_t               db_dev;         /* Device of opened DB file     */
+    ino_t               db_ino;         /* Inode of opened DB file      */
+    time_t              db_lf_mtime;    /* Lock file mtime at open      */
     krb5_boolean        hashfirst;      /* Try hash database type first */
     char *              db_lf_name;     /* Name of lock file            */
     int                 db_lf_file;     /* File descriptor of lock file */
@@ -48,6 +52,11 @@ typedef struct _krb5_db2_context {
     krb5_boolean        disable_last_success;
     krb5_boolean        disable_lockout;
     krb5_boolean        unlockiter;
+    krb5_boolean        snapshot;       /* Copy-on-write, lock-free reads */
+    krb5_boolean        snapshot_dirty; /* Working copy has been changed */
+    unsigned int        page_size;      /* Page size for new databases  */
+    unsigned int        cache_size;     /* Bytes of pages to cache      */
+    krb5_boolean        mmap_reads;     /* Map pages of read-only handles */
 } krb5_db2_context;
 
 krb5_error_code krb5_db2_init(krb5_context);
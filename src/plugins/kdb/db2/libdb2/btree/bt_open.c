@@ -116,8 +116,8 @@ __bt_open(fname, flags, mode, openinfo, dflags)
 	if (openinfo) {
 		b = *openinfo;
 
-		/* Flags: R_DUP. */
-		if (b.flags & ~(R_DUP))
+		/* Flags: R_DUP, R_MMAP. */
+		if (b.flags & ~(R_DUP | R_MMAP))
 			goto einval;
 
 		/*
@@ -312,6 +312,15 @@ __bt_open(fname, flags, mode, openinfo, dflags)
 	if (!F_ISSET(t, B_INMEM))
 		mpool_filter(t->bt_mp, __bt_pgin, __bt_pgout, t);
 
+	/*
+	 * Map the pages of a read-only tree if asked to, unless they need
+	 * byte-swapping.  If the mapping fails, fall back to reading pages
+	 * into the cache.
+	 */
+	if (b.flags & R_MMAP && F_ISSET(t, B_RDONLY) &&
+	    !F_ISSET(t, B_NEEDSWAP))
+		(void)mpool_mmap(t->bt_mp);
+
 	/* Create a root page if new tree. */
 	if (nroot(t) == RET_ERROR)
 		goto err;
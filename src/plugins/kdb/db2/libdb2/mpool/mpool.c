@@ -37,6 +37,7 @@ static char sccsid[] = "@(#)mpool.c	8.7 (Berkeley) 11/2/95";
 
 #include <sys/param.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <errno.h>
 #include <stdio.h>
@@ -51,6 +52,11 @@ static BKT *mpool_bkt __P((MPOOL *));
 static BKT *mpool_look __P((MPOOL *, db_pgno_t));
 static int  mpool_write __P((MPOOL *, BKT *));
 
+/* True if page is an address within the file mapping of mp. */
+#define	MPOOL_MAPPED(mp, page)						\
+	((mp)->map != NULL && (char *)(page) >= (mp)->map &&		\
+	    (char *)(page) < (mp)->map + (mp)->mappages * (mp)->pagesize)
+
 /*
  * mpool_open --
  *	Initialize a memory pool.
@@ -91,6 +97,35 @@ mpool_open(key, fd, pagesize, maxcache)
 	return (mp);
 }
 
+/*
+ * mpool_mmap --
+ *	Map the pages currently in the file, so that mpool_get can return
+ *	them in place instead of reading them into the cache.  Only valid
+ *	for a pool which is never written and has no input filter which
+ *	changes the pages.  Pages added to the file later are read through
+ *	the cache as usual.
+ */
+int
+mpool_mmap(mp)
+	MPOOL *mp;
+{
+	void *map;
+
+	if (mp->map != NULL || mp->npages == 0)
+		return (RET_SUCCESS);
+	if (mp->npages > (size_t)-1 / mp->pagesize) {
+		errno = E2BIG;
+		return (RET_ERROR);
+	}
+	map = mmap(NULL, (size_t)mp->npages * mp->pagesize, PROT_READ,
+	    MAP_SHARED, mp->fd, 0);
+	if (map == MAP_FAILED)
+		return (RET_ERROR);
+	mp->map = map;
+	mp->mappages = mp->npages;
+	return (RET_SUCCESS);
+}
+
 /*
  * mpool_filter --
  *	Initialize input/output filters.
@@ -156,6 +191,10 @@ mpool_delete(mp, page)
 	struct _hqh *head;
 	BKT *bp;
 
+	if (MPOOL_MAPPED(mp, page)) {
+		errno = EPERM;
+		return (RET_ERROR);
+	}
 	bp = (void *)((char *)page - sizeof(BKT));
 
 #ifdef DEBUG
@@ -194,6 +233,14 @@ mpool_get(mp, pgno, flags)
 	++mp->pageget;
 #endif
 
+	/* Return a mapped page in place. */
+	if (pgno < mp->mappages) {
+#ifdef STATISTICS
+		++mp->cachehit;
+#endif
+		return (mp->map + (size_t)pgno * mp->pagesize);
+	}
+
 	/* Check for a page that is cached. */
 	if ((bp = mpool_look(mp, pgno)) != NULL) {
 #ifdef DEBUG
@@ -288,6 +335,13 @@ mpool_put(mp, page, flags)
 #ifdef STATISTICS
 	++mp->pageput;
 #endif
+	if (MPOOL_MAPPED(mp, page)) {
+		if (flags & MPOOL_DIRTY) {
+			errno = EPERM;
+			return (RET_ERROR);
+		}
+		return (RET_SUCCESS);
+	}
 	bp = (void *)((char *)page - sizeof(BKT));
 #ifdef DEBUG
 	if (!(bp->flags & MPOOL_PINNED)) {
@@ -318,6 +372,10 @@ mpool_close(mp)
 		free(bp);
 	}
 
+	/* Release the file mapping. */
+	if (mp->map != NULL)
+		(void)munmap(mp->map, (size_t)mp->mappages * mp->pagesize);
+
 	/* Free the MPOOL cookie. */
 	free(mp);
 	return (RET_SUCCESS);
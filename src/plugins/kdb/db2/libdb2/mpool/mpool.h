@@ -67,6 +67,8 @@ typedef struct MPOOL {
 	db_pgno_t	npages;			/* number of pages in the file */
 	u_long	pagesize;		/* file page size */
 	int	fd;			/* file descriptor */
+	char	*map;			/* read-only file mapping */
+	db_pgno_t	mappages;		/* number of pages mapped */
 					/* page in conversion routine */
 	void    (*pgin) __P((void *, db_pgno_t, void *));
 					/* page out conversion routine */
@@ -99,6 +101,7 @@ typedef struct MPOOL {
 #define mpool_put	kdb2_mpool_put
 #define mpool_sync	kdb2_mpool_sync
 #define mpool_close	kdb2_mpool_close
+#define mpool_mmap	kdb2_mpool_mmap
 #define mpool_stat	kdb2_mpool_stat
 
 __BEGIN_DECLS
@@ -111,6 +114,7 @@ int	 mpool_delete __P((MPOOL *, void *));
 int	 mpool_put __P((MPOOL *, void *, u_int));
 int	 mpool_sync __P((MPOOL *));
 int	 mpool_close __P((MPOOL *));
+int	 mpool_mmap __P((MPOOL *));
 
 void	 mpool_stat __P((MPOOL *));
 
@@ -60,6 +60,9 @@
 extern struct timeval timelimit;
 
 #define  DEFAULT_CONNS_PER_SERVER    5
+#define  DEFAULT_POLICY_CACHE_LIFETIME 60
+#define  POLICY_CACHE_MAX_ENTRIES    1024
+#define  ITERATE_PAGE_SIZE           1000
 #define  REALM_READ_REFRESH_INTERVAL (5 * 60)
 
 #if !defined(LDAP_OPT_RESULT_CODE) && defined(LDAP_OPT_ERROR_NUMBER)
@@ -192,6 +195,26 @@ struct _krb5_ldap_server_info {
 
 typedef enum {SERVICE_DN_TYPE_SERVER, SERVICE_DN_TYPE_CLIENT} krb5_ldap_servicetype;
 
+/* Cached values from a ticket or password policy object. */
+typedef enum {TKT_POLICY_CACHE, PWD_POLICY_CACHE} krb5_ldap_policy_cache_type;
+
+typedef struct _krb5_ldap_cached_policy {
+    struct _krb5_ldap_cached_policy *next;
+    krb5_ldap_policy_cache_type   type;
+    char                          *name;
+    time_t                        expires;
+    /* Ticket policy values; mask holds the LDAP_POLICY_* bits of the ones
+     * present in the object. */
+    int                           mask;
+    long                          maxtktlife;
+    long                          maxrenewlife;
+    long                          tktflags;
+    /* Password policy lockout values. */
+    krb5_kvno                     pw_max_fail;
+    krb5_deltat                   pw_failcnt_interval;
+    krb5_deltat                   pw_lockout_duration;
+} krb5_ldap_cached_policy;
+
 typedef struct _krb5_ldap_context {
     krb5_ldap_servicetype         service_type;
     krb5_ldap_server_info         **server_info_list;
@@ -213,6 +236,10 @@ typedef struct _krb5_ldap_context {
     krb5_boolean                  disable_lockout;
     int                           ldap_debug;
     krb5_context                  kcontext;   /* to set the error code and message */
+    int                           srv_type;
+    k5_mutex_t                    policy_cache_lock;
+    krb5_ldap_cached_policy       *policy_cache;
+    krb5_ui_4                     policy_cache_lifetime;
 } krb5_ldap_context;
 
 
@@ -328,6 +328,11 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
     if (k5_mutex_init(&(ldap_context->hndl_lock)) != 0)
         return KRB5_KDB_SERVER_INTERNAL_ERR;
 
+    /* This mutex protects the ticket and password policy cache. */
+    if (k5_mutex_init(&ldap_context->policy_cache_lock) != 0)
+        return KRB5_KDB_SERVER_INTERNAL_ERR;
+    ldap_context->srv_type = srv_type;
+
     /* Read the maximum number of LDAP connections per server. */
     if (ldap_context->max_server_conns == 0) {
         ret = prof_get_integer_def(context, conf_section,
@@ -344,6 +349,14 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
         return EINVAL;
     }
 
+    /* Read how long policy objects may be cached, in seconds. */
+    ret = prof_get_integer_def(context, conf_section,
+                               KRB5_CONF_LDAP_POLICY_CACHE_LIFETIME,
+                               DEFAULT_POLICY_CACHE_LIFETIME,
+                               &ldap_context->policy_cache_lifetime);
+    if (ret)
+        return ret;
+
     /* Read the DN used to connect to the LDAP server. */
     if (ldap_context->bind_dn == NULL) {
         name = choose_var(srv_type, KRB5_CONF_LDAP_KDC_DN,
@@ -477,10 +490,119 @@ krb5_ldap_free_server_params(krb5_ldap_context *ctx)
     if (ctx == NULL)
         return;
     krb5_ldap_free_server_context_params(ctx);
+    if (ctx->policy_cache != NULL)
+        krb5_ldap_policy_cache_flush(ctx, NULL);
     k5_mutex_destroy(&ctx->hndl_lock);
+    k5_mutex_destroy(&ctx->policy_cache_lock);
     free(ctx);
 }
 
+/*
+ * Look up the cached policy object of type pol->type named pol->name.  If an
+ * unexpired entry is found, copy its values into *pol and return true.
+ */
+krb5_boolean
+krb5_ldap_policy_cache_lookup(krb5_ldap_context *ctx,
+                              krb5_ldap_cached_policy *pol)
+{
+    krb5_ldap_cached_policy *p;
+    krb5_boolean found = FALSE;
+    time_t now = time(NULL);
+
+    k5_mutex_lock(&ctx->policy_cache_lock);
+    for (p = ctx->policy_cache; p != NULL; p = p->next) {
+        if (p->type == pol->type && strcmp(p->name, pol->name) == 0) {
+            if (p->expires > now) {
+                pol->mask = p->mask;
+                pol->maxtktlife = p->maxtktlife;
+                pol->maxrenewlife = p->maxrenewlife;
+                pol->tktflags = p->tktflags;
+                pol->pw_max_fail = p->pw_max_fail;
+                pol->pw_failcnt_interval = p->pw_failcnt_interval;
+                pol->pw_lockout_duration = p->pw_lockout_duration;
+                found = TRUE;
+            }
+            break;
+        }
+    }
+    k5_mutex_unlock(&ctx->policy_cache_lock);
+    return found;
+}
+
+/* Add or replace the cache entry for the policy object values in *pol.
+ * Expired entries are discarded along the way.  Failures are ignored, as the
+ * cache is only an optimization. */
+void
+krb5_ldap_policy_cache_store(krb5_ldap_context *ctx,
+                             const krb5_ldap_cached_policy *pol)
+{
+    krb5_ldap_cached_policy *p, **pp, *entry;
+    time_t now = time(NULL);
+    unsigned int count = 0;
+
+    if (ctx->policy_cache_lifetime == 0)
+        return;
+
+    entry = malloc(sizeof(*entry));
+    if (entry == NULL)
+        return;
+    *entry = *pol;
+    entry->name = strdup(pol->name);
+    if (entry->name == NULL) {
+        free(entry);
+        return;
+    }
+    entry->expires = now + ctx->policy_cache_lifetime;
+
+    k5_mutex_lock(&ctx->policy_cache_lock);
+    pp = &ctx->policy_cache;
+    while (*pp != NULL) {
+        p = *pp;
+        if (p->expires <= now ||
+            (p->type == pol->type && strcmp(p->name, pol->name) == 0)) {
+            *pp = p->next;
+            free(p->name);
+            free(p);
+        } else {
+            count++;
+            pp = &p->next;
+        }
+    }
+    if (count < POLICY_CACHE_MAX_ENTRIES) {
+        entry->next = ctx->policy_cache;
+        ctx->policy_cache = entry;
+        entry = NULL;
+    }
+    k5_mutex_unlock(&ctx->policy_cache_lock);
+
+    if (entry != NULL) {
+        free(entry->name);
+        free(entry);
+    }
+}
+
+/* Discard cached policy objects named name, or all of them if name is
+ * NULL. */
+void
+krb5_ldap_policy_cache_flush(krb5_ldap_context *ctx, const char *name)
+{
+    krb5_ldap_cached_policy *p, **pp;
+
+    k5_mutex_lock(&ctx->policy_cache_lock);
+    pp = &ctx->policy_cache;
+    while (*pp != NULL) {
+        p = *pp;
+        if (name == NULL || strcmp(p->name, name) == 0) {
+            *pp = p->next;
+            free(p->name);
+            free(p);
+        } else {
+            pp = &p->next;
+        }
+    }
+    k5_mutex_unlock(&ctx->policy_cache_lock);
+}
+
 /* Return true if princ is in the default realm of ldap_context or is a
  * cross-realm TGS principal for that realm. */
 krb5_boolean
@@ -78,6 +78,16 @@ krb5_ldap_read_server_params(krb5_context , char *, int);
 void
 krb5_ldap_free_server_params(krb5_ldap_context *);
 
+krb5_boolean
+krb5_ldap_policy_cache_lookup(krb5_ldap_context *, krb5_ldap_cached_policy *);
+
+void
+krb5_ldap_policy_cache_store(krb5_ldap_context *,
+                             const krb5_ldap_cached_policy *);
+
+void
+krb5_ldap_policy_cache_flush(krb5_ldap_context *, const char *);
+
 krb5_error_code
 krb5_ldap_list(krb5_context, char ***, char *, char *);
 
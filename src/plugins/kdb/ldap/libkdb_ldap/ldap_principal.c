@@ -63,6 +63,36 @@ char     *principal_attributes[] = { "krbprincipalname",
                                      "krbPwdHistory",
                                      NULL };
 
+/* The KDC never changes keys, so it does not fetch the password history,
+ * which can be much larger than the rest of the entry. */
+char     *kdc_principal_attributes[] = { "krbprincipalname",
+                                         "krbcanonicalname",
+                                         "objectclass",
+                                         "krbprincipalkey",
+                                         "krbmaxrenewableage",
+                                         "krbmaxticketlife",
+                                         "krbticketflags",
+                                         "krbprincipalexpiration",
+                                         "krbticketpolicyreference",
+                                         "krbUpEnabled",
+                                         "krbpwdpolicyreference",
+                                         "krbpasswordexpiration",
+                                         "krbLastFailedAuth",
+                                         "krbLoginFailedCount",
+                                         "krbLastSuccessfulAuth",
+                                         "krbLastPwdChange",
+                                         "krbLastAdminUnlock",
+                                         "krbPrincipalAuthInd",
+                                         "krbExtraData",
+                                         "krbObjectReferences",
+                                         "krbAllowedToDelegateTo",
+                                         NULL };
+
+/* Principal listing only needs the names. */
+static char *name_attributes[] = { "krbprincipalname",
+                                   "krbcanonicalname",
+                                   NULL };
+
 /* Must match KDB_*_ATTR macros in ldap_principal.h.  */
 static char *attributes_set[] = { "krbmaxticketlife",
                                   "krbmaxrenewableage",
@@ -128,27 +158,257 @@ krb5_dbe_free_contents(krb5_context context, krb5_db_entry *entry)
 }
 
 
+/* State of the paged principal search of one subtree. */
+struct subtree_search {
+    char *base;
+    krb5_ldap_server_handle *handle;
+    int msgid;
+    struct berval cookie;
+};
+
+/*
+ * Send the request for the next page of search s, continuing from s->cookie.
+ * If the directory server or the LDAP library does not support paged
+ * results, the first page contains the whole result.
+ */
+static krb5_error_code
+send_page_request(krb5_context context, krb5_ldap_context *ldap_context,
+                  struct subtree_search *s, char *filter, char **attrs)
+{
+    LDAPControl *ctrls[2] = { NULL, NULL };
+    krb5_boolean first = (s->cookie.bv_val == NULL);
+    int st;
+
+#ifdef HAVE_LDAP_CREATE_PAGE_CONTROL
+    st = ldap_create_page_control(s->handle->ldap_handle, ITERATE_PAGE_SIZE,
+                                  first ? NULL : &s->cookie, 0, &ctrls[0]);
+    if (st != LDAP_SUCCESS)
+        return set_ldap_error(context, st, OP_SEARCH);
+#endif
+
+    st = ldap_search_ext(s->handle->ldap_handle, s->base,
+                         ldap_context->lrparams->search_scope, filter,
+                         attrs, 0, ctrls, NULL, &timelimit, LDAP_NO_LIMIT,
+                         &s->msgid);
+    /* Reconnect if the first page request fails, as LDAP_SEARCH does.  A
+     * paged search can't move to another connection once started. */
+    if (first && translate_ldap_error(st, OP_SEARCH) == KRB5_KDB_ACCESS_ERROR) {
+        if (krb5_ldap_rebind(ldap_context, &s->handle) != 0 ||
+            s->handle == NULL) {
+            s->msgid = -1;
+#ifdef HAVE_LDAP_CREATE_PAGE_CONTROL
+            ldap_control_free(ctrls[0]);
+#endif
+            k5_wrapmsg(context, st, KRB5_KDB_ACCESS_ERROR,
+                       "LDAP handle unavailable");
+            return KRB5_KDB_ACCESS_ERROR;
+        }
+        st = ldap_search_ext(s->handle->ldap_handle, s->base,
+                             ldap_context->lrparams->search_scope, filter,
+                             attrs, 0, ctrls, NULL, &timelimit, LDAP_NO_LIMIT,
+                             &s->msgid);
+    }
+#ifdef HAVE_LDAP_CREATE_PAGE_CONTROL
+    ldap_control_free(ctrls[0]);
+#endif
+    if (st != LDAP_SUCCESS) {
+        s->msgid = -1;
+        return set_ldap_error(context, st, OP_SEARCH);
+    }
+    return 0;
+}
+
+/*
+ * Wait for the page of search s requested last.  Replace s->cookie with the
+ * cookie for the next page, which is empty if this page was the last one.
+ */
+static krb5_error_code
+receive_page(krb5_context context, struct subtree_search *s,
+             LDAPMessage **result_out)
+{
+    LDAP *ld = s->handle->ldap_handle;
+    LDAPMessage *result = NULL;
+    LDAPControl **ctrls = NULL;
+    int ret, st;
+#ifdef HAVE_LDAP_CREATE_PAGE_CONTROL
+    LDAPControl *ctrl;
+    ber_int_t count;
+#endif
+
+    *result_out = NULL;
+    ber_memfree(s->cookie.bv_val);
+    s->cookie.bv_val = NULL;
+    s->cookie.bv_len = 0;
+
+    ret = ldap_result(ld, s->msgid, LDAP_MSG_ALL, &timelimit, &result);
+    if (ret == 0)
+        return set_ldap_error(context, LDAP_TIMEOUT, OP_SEARCH);
+    s->msgid = -1;
+    if (ret == -1) {
+        ldap_get_option(ld, LDAP_OPT_RESULT_CODE, &st);
+        return set_ldap_error(context, st, OP_SEARCH);
+    }
+
+    ret = ldap_parse_result(ld, result, &st, NULL, NULL, NULL, &ctrls, 0);
+    if (ret != LDAP_SUCCESS)
+        st = ret;
+    if (st != LDAP_SUCCESS) {
+        ldap_controls_free(ctrls);
+        ldap_msgfree(result);
+        return set_ldap_error(context, st, OP_SEARCH);
+    }
+
+#ifdef HAVE_LDAP_CREATE_PAGE_CONTROL
+    ctrl = ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, ctrls, NULL);
+    if (ctrl != NULL &&
+        ldap_parse_pageresponse_control(ld, ctrl, &count,
+                                        &s->cookie) != LDAP_SUCCESS) {
+        s->cookie.bv_val = NULL;
+        s->cookie.bv_len = 0;
+    }
+#endif
+    ldap_controls_free(ctrls);
+
+    *result_out = result;
+    return 0;
+}
+
+/* Pass the principals of realm in the search result to func.  If namesonly
+ * is true, set only the principal name of the entries. */
+static krb5_error_code
+iterate_result(krb5_context context, krb5_ldap_context *ldap_context,
+               LDAP *ld, LDAPMessage *result, krb5_boolean namesonly,
+               krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
+               krb5_pointer func_arg)
+{
+    krb5_error_code st;
+    krb5_db_entry entry;
+    krb5_principal principal;
+    LDAPMessage *ent;
+    char **values, *princ_name;
+    unsigned int i;
+
+    memset(&entry, 0, sizeof(entry));
+    for (ent = ldap_first_entry(ld, result); ent != NULL;
+         ent = ldap_next_entry(ld, ent)) {
+        values = ldap_get_values(ld, ent, "krbcanonicalname");
+        if (values == NULL)
+            values = ldap_get_values(ld, ent, "krbprincipalname");
+        if (values == NULL)
+            continue;
+        for (i = 0; values[i] != NULL; ++i) {
+            if (krb5_ldap_parse_principal_name(values[i], &princ_name) != 0)
+                continue;
+            if (krb5_parse_name(context, princ_name, &principal) != 0) {
+                free(princ_name);
+                continue;
+            }
+            free(princ_name);
+            if (is_principal_in_realm(ldap_context, principal)) {
+                if (namesonly) {
+                    entry.princ = principal;
+                    principal = NULL;
+                    st = 0;
+                } else {
+                    st = populate_krb5_db_entry(context, ldap_context, ld, ent,
+                                                principal, &entry);
+                }
+                krb5_free_principal(context, principal);
+                if (st) {
+                    ldap_value_free(values);
+                    return st;
+                }
+                (*func)(func_arg, &entry);
+                krb5_dbe_free_contents(context, &entry);
+                break;
+            }
+            krb5_free_principal(context, principal);
+        }
+        ldap_value_free(values);
+    }
+    return 0;
+}
+
+/*
+ * Convert the shell-style glob match_expr into an LDAP substring filter value
+ * matching a superset of the names matched by the glob.  Literal characters
+ * are escaped; wildcards, character classes and quoted characters all become
+ * "*", and a trailing "*" is added so that a glob without a realm matches
+ * names in any realm.
+ */
+static krb5_error_code
+glob_to_filter(const char *match_expr, char **filter_out)
+{
+    struct k5buf buf;
+    const char *p;
+    krb5_boolean star = FALSE;
+
+    *filter_out = NULL;
+    k5_buf_init_dynamic(&buf);
+    k5_buf_add(&buf, FILTER);
+    for (p = match_expr; *p != '\0'; p++) {
+        if (*p == '\\' && p[1] != '\0') {
+            /* Quoted characters may be stored differently in the
+             * directory. */
+            p++;
+        } else if (*p == '[') {
+            /* Skip the character class, including a leading negation and a
+             * leading ']'. */
+            if (p[1] == '!' || p[1] == '^')
+                p++;
+            if (p[1] == ']')
+                p++;
+            while (p[1] != '\0' && p[1] != ']')
+                p++;
+            if (p[1] != '\0')
+                p++;
+        } else if (*p != '*' && *p != '?') {
+            if (*p == '(' || *p == ')' || *p == '\\')
+                k5_buf_add_fmt(&buf, "\\%02x", (unsigned char)*p);
+            else
+                k5_buf_add_len(&buf, p, 1);
+            star = FALSE;
+            continue;
+        }
+        if (!star)
+            k5_buf_add(&buf, "*");
+        star = TRUE;
+    }
+    if (!star)
+        k5_buf_add(&buf, "*");
+    k5_buf_add(&buf, "))");
+    if (k5_buf_status(&buf) != 0)
+        return ENOMEM;
+    *filter_out = buf.data;
+    return 0;
+}
+
+/*
+ * Iterate over the principals of the realm.  The subtrees are searched
+ * concurrently, each on its own connection, and their results are retrieved
+ * in pages so that no single result is limited by the server's size limit.
+ * Principals are passed to func in no particular order.
+ */
 krb5_error_code
 krb5_ldap_iterate(krb5_context context, char *match_expr,
                   krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
                   krb5_pointer func_arg, krb5_flags iterflags)
 {
-    krb5_db_entry            entry;
-    krb5_principal           principal;
-    char                     **subtree=NULL, *princ_name=NULL, *realm=NULL, **values=NULL, *filter=NULL;
-    unsigned int             tree=0, ntree=1, i=0;
-    krb5_error_code          st=0, tempst=0;
-    LDAP                     *ld=NULL;
-    LDAPMessage              *result=NULL, *ent=NULL;
+    char                     **subtree=NULL, *realm=NULL, *filter=NULL;
+    unsigned int             tree=0, ntree=1;
+    krb5_error_code          st=0;
+    krb5_boolean             active;
+    LDAPMessage              *result=NULL;
     kdb5_dal_handle          *dal_handle=NULL;
     krb5_ldap_context        *ldap_context=NULL;
-    krb5_ldap_server_handle  *ldap_server_handle=NULL;
+    struct subtree_search    *searches=NULL, *s;
     char                     *default_match_expr = "*";
+    char                     **attrs;
+    krb5_boolean             namesonly;
 
     /* Clear the global error string */
     krb5_clear_error_message(context);
 
-    memset(&entry, 0, sizeof(krb5_db_entry));
     SETUP_CONTEXT();
 
     realm = ldap_context->lrparams->realm_name;
@@ -167,59 +427,85 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
     if (match_expr == NULL)
         match_expr = default_match_expr;
 
-    if (asprintf(&filter, FILTER"%s))", match_expr) < 0)
-        filter = NULL;
-    CHECK_NULL(filter);
+    st = glob_to_filter(match_expr, &filter);
+    if (st)
+        goto cleanup;
+
+    namesonly = (iterflags & KRB5_DB_ITER_NAMES_ONLY) != 0;
+    attrs = namesonly ? name_attributes : principal_attributes;
 
     if ((st = krb5_get_subtree_info(ldap_context, &subtree, &ntree)) != 0)
         goto cleanup;
 
-    GET_HANDLE();
+    searches = k5calloc(ntree, sizeof(*searches), &st);
+    if (searches == NULL)
+        goto cleanup;
+    for (tree = 0; tree < ntree; tree++) {
+        searches[tree].base = subtree[tree];
+        searches[tree].msgid = -1;
+    }
 
-    for (tree=0; tree < ntree; ++tree) {
-
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
-        for (ent=ldap_first_entry(ld, result); ent != NULL; ent=ldap_next_entry(ld, ent)) {
-            values=ldap_get_values(ld, ent, "krbcanonicalname");
-            if (values == NULL)
-                values=ldap_get_values(ld, ent, "krbprincipalname");
-            if (values != NULL) {
-                for (i=0; values[i] != NULL; ++i) {
-                    if (krb5_ldap_parse_principal_name(values[i], &princ_name) != 0)
-                        continue;
-                    if (krb5_parse_name(context, princ_name, &principal) != 0)
-                        continue;
-                    if (is_principal_in_realm(ldap_context, principal)) {
-                        if ((st = populate_krb5_db_entry(context, ldap_context, ld, ent, principal,
-                                                         &entry)) != 0)
-                            goto cleanup;
-                        (*func)(func_arg, &entry);
-                        krb5_dbe_free_contents(context, &entry);
-                        (void) krb5_free_principal(context, principal);
-                        free(princ_name);
-                        break;
-                    }
-                    (void) krb5_free_principal(context, principal);
-                    free(princ_name);
-                }
-                ldap_value_free(values);
+    /* Start the search of every subtree on a separate connection. */
+    for (tree = 0; tree < ntree; tree++) {
+        s = &searches[tree];
+        st = krb5_ldap_request_handle_from_pool(ldap_context, &s->handle);
+        if (st != 0) {
+            k5_wrapmsg(context, st, KRB5_KDB_ACCESS_ERROR,
+                       "LDAP handle unavailable");
+            st = KRB5_KDB_ACCESS_ERROR;
+            goto cleanup;
+        }
+        st = send_page_request(context, ldap_context, s, filter, attrs);
+        if (st)
+            goto cleanup;
+    }
+
+    /* Take a page from each search in turn.  Request the next page of a
+     * search before processing the current one, so that the server can
+     * prepare it in the meantime. */
+    do {
+        active = FALSE;
+        for (tree = 0; tree < ntree; tree++) {
+            s = &searches[tree];
+            if (s->msgid == -1)
+                continue;
+            st = receive_page(context, s, &result);
+            if (st)
+                goto cleanup;
+            if (s->cookie.bv_len > 0) {
+                st = send_page_request(context, ldap_context, s, filter, attrs);
+                if (st)
+                    goto cleanup;
+                active = TRUE;
             }
-        } /* end of for (ent= ... */
-        ldap_msgfree(result);
-        result = NULL;
-    } /* end of for (tree= ... */
+            st = iterate_result(context, ldap_context, s->handle->ldap_handle,
+                                result, namesonly, func, func_arg);
+            if (st)
+                goto cleanup;
+            ldap_msgfree(result);
+            result = NULL;
+        }
+    } while (active);
 
 cleanup:
     if (filter)
         free (filter);
 
-    for (;ntree; --ntree)
+    ldap_msgfree(result);
+    for (tree = 0; searches != NULL && tree < ntree; tree++) {
+        s = &searches[tree];
+        if (s->msgid != -1)
+            ldap_abandon_ext(s->handle->ldap_handle, s->msgid, NULL, NULL);
+        ber_memfree(s->cookie.bv_val);
+        krb5_ldap_put_handle_to_pool(ldap_context, s->handle);
+    }
+    free(searches);
+
+    for (;subtree != NULL && ntree; --ntree)
         if (subtree[ntree-1])
             free (subtree[ntree-1]);
     free(subtree);
 
-    ldap_msgfree(result);
-    krb5_ldap_put_handle_to_pool(ldap_context, ldap_server_handle);
     return st;
 }
 
@@ -72,6 +72,7 @@
 #include <time.h>
 
 extern char* principal_attributes[];
+extern char* kdc_principal_attributes[];
 extern char* max_pwd_life_attr[];
 
 static char *
@@ -98,6 +99,100 @@ berval2tl_data(struct berval *in, krb5_tl_data **out)
     return 0;
 }
 
+/*
+ * Send principal searches of all ntrees subtrees on the connection of
+ * *handle without waiting for the results, so that the directory server can
+ * process them concurrently.  Place the message IDs in *msgids_out.
+ */
+static krb5_error_code
+send_subtree_searches(krb5_context context, krb5_ldap_context *ldap_context,
+                      krb5_ldap_server_handle **handle, char **subtree,
+                      unsigned int ntrees, char *filter, char **attrs,
+                      int **msgids_out)
+{
+    krb5_error_code st = 0;
+    unsigned int i;
+    int *msgids;
+
+    *msgids_out = NULL;
+
+    msgids = k5calloc(ntrees, sizeof(*msgids), &st);
+    if (msgids == NULL)
+        return st;
+    for (i = 0; i < ntrees; i++)
+        msgids[i] = -1;
+
+    for (i = 0; i < ntrees; i++) {
+        st = ldap_search_ext((*handle)->ldap_handle, subtree[i],
+                             ldap_context->lrparams->search_scope, filter,
+                             attrs, 0, NULL, NULL, &timelimit,
+                             LDAP_NO_LIMIT, &msgids[i]);
+        /* Reconnect if the first send fails, as LDAP_SEARCH does.  Later
+         * failures can't be retried since earlier searches would be lost. */
+        if (i == 0 &&
+            translate_ldap_error(st, OP_SEARCH) == KRB5_KDB_ACCESS_ERROR) {
+            if (krb5_ldap_rebind(ldap_context, handle) != 0) {
+                k5_wrapmsg(context, st, KRB5_KDB_ACCESS_ERROR,
+                           "LDAP handle unavailable");
+                st = KRB5_KDB_ACCESS_ERROR;
+                goto cleanup;
+            }
+            st = ldap_search_ext((*handle)->ldap_handle, subtree[i],
+                                 ldap_context->lrparams->search_scope, filter,
+                                 attrs, 0, NULL, NULL, &timelimit,
+                                 LDAP_NO_LIMIT, &msgids[i]);
+        }
+        if (st != LDAP_SUCCESS) {
+            msgids[i] = -1;
+            st = set_ldap_error(context, st, OP_SEARCH);
+            goto cleanup;
+        }
+    }
+
+    *msgids_out = msgids;
+    msgids = NULL;
+
+cleanup:
+    if (msgids != NULL) {
+        for (i = 0; i < ntrees; i++) {
+            if (msgids[i] != -1)
+                ldap_abandon_ext((*handle)->ldap_handle, msgids[i], NULL, NULL);
+        }
+        free(msgids);
+    }
+    return st;
+}
+
+/* Wait for the complete result of the search with message ID *msgid.  Set
+ * *msgid to -1 once the search is no longer outstanding. */
+static krb5_error_code
+wait_search_result(krb5_context context, LDAP *ld, int *msgid,
+                   LDAPMessage **result_out)
+{
+    LDAPMessage *result = NULL;
+    int ret, st;
+
+    *result_out = NULL;
+
+    ret = ldap_result(ld, *msgid, LDAP_MSG_ALL, &timelimit, &result);
+    if (ret == 0)
+        return set_ldap_error(context, LDAP_TIMEOUT, OP_SEARCH);
+    *msgid = -1;
+    if (ret == -1) {
+        ldap_get_option(ld, LDAP_OPT_RESULT_CODE, &st);
+        return set_ldap_error(context, st, OP_SEARCH);
+    }
+
+    st = ldap_result2error(ld, result, 0);
+    if (st != LDAP_SUCCESS) {
+        ldap_msgfree(result);
+        return set_ldap_error(context, st, OP_SEARCH);
+    }
+
+    *result_out = result;
+    return 0;
+}
+
 /*
  * look up a principal in the directory.
  */
@@ -110,6 +205,7 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     unsigned int                tree=0, ntrees=1, princlen=0;
     krb5_error_code             tempst=0, st=0;
     char                        **values=NULL, **subtree=NULL, *cname=NULL;
+    char                        **attrs=principal_attributes;
     LDAP                        *ld=NULL;
     LDAPMessage                 *result=NULL, *ent=NULL;
     krb5_ldap_context           *ldap_context=NULL;
@@ -118,6 +214,7 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     krb5_principal              cprinc=NULL;
     krb5_boolean                found=FALSE;
     krb5_db_entry               *entry = NULL;
+    int                         *msgids = NULL;
 
     *entry_ptr = NULL;
 
@@ -160,10 +257,31 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st = krb5_get_subtree_info(ldap_context, &subtree, &ntrees)) != 0)
         goto cleanup;
 
+    if (ldap_context->srv_type == KRB5_KDB_SRV_TYPE_KDC)
+        attrs = kdc_principal_attributes;
+
     GET_HANDLE();
+
+    /* With multiple subtrees, pipeline the searches instead of paying a
+     * round trip for each one in turn. */
+    if (ntrees > 1) {
+        st = send_subtree_searches(context, ldap_context, &ldap_server_handle,
+                                   subtree, ntrees, filter, attrs, &msgids);
+        if (st != 0)
+            goto cleanup;
+        ld = ldap_server_handle->ldap_handle;
+    }
+
     for (tree=0; tree < ntrees && !found; ++tree) {
 
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
+        if (msgids != NULL) {
+            st = wait_search_result(context, ld, &msgids[tree], &result);
+            if (st != 0)
+                goto cleanup;
+        } else {
+            LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope,
+                        filter, attrs);
+        }
         for (ent=ldap_first_entry(ld, result); ent != NULL && !found; ent=ldap_next_entry(ld, ent)) {
 
             /* get the associated directory user information */
@@ -226,6 +344,15 @@ cleanup:
     ldap_msgfree(result);
     krb5_db_free_principal(context, entry);
 
+    /* Abandon the searches of any subtrees we didn't need. */
+    if (msgids != NULL) {
+        for (tree = 0; tree < ntrees; tree++) {
+            if (msgids[tree] != -1)
+                ldap_abandon_ext(ld, msgids[tree], NULL, NULL);
+        }
+        free(msgids);
+    }
+
     if (filter)
         free (filter);
 
@@ -1495,7 +1622,9 @@ krb5_read_tkt_policy(krb5_context context, krb5_ldap_context *ldap_context,
     krb5_error_code             st=0;
     int                         mask=0, omask=0;
     int                         tkt_mask=(KDB_MAX_LIFE_ATTR | KDB_MAX_RLIFE_ATTR | KDB_TKT_FLAGS_ATTR);
-    krb5_ldap_policy_params     *tktpoldnparam=NULL;
+    krb5_ldap_cached_policy     tktpol;
+
+    memset(&tktpol, 0, sizeof(tktpol));
 
     if ((st=krb5_get_attributes_mask(context, entries, &mask)) != 0)
         goto cleanup;
@@ -1504,36 +1633,37 @@ krb5_read_tkt_policy(krb5_context context, krb5_ldap_context *ldap_context,
         goto cleanup;
 
     if (policy != NULL) {
-        st = krb5_ldap_read_policy(context, policy, &tktpoldnparam, &omask);
+        st = krb5_ldap_read_policy_cached(context, policy, &tktpol);
         if (st && st != KRB5_KDB_NOENTRY) {
             k5_prependmsg(context, st, _("Error reading ticket policy"));
             goto cleanup;
         }
+        if (st == 0)
+            omask = tktpol.mask;
 
         st = 0; /* reset the return status */
     }
 
     if ((mask & KDB_MAX_LIFE_ATTR) == 0) {
         if ((omask & KDB_MAX_LIFE_ATTR) ==  KDB_MAX_LIFE_ATTR)
-            entries->max_life = tktpoldnparam->maxtktlife;
+            entries->max_life = tktpol.maxtktlife;
         else if (ldap_context->lrparams->max_life)
             entries->max_life = ldap_context->lrparams->max_life;
     }
 
     if ((mask & KDB_MAX_RLIFE_ATTR) == 0) {
         if ((omask & KDB_MAX_RLIFE_ATTR) == KDB_MAX_RLIFE_ATTR)
-            entries->max_renewable_life = tktpoldnparam->maxrenewlife;
+            entries->max_renewable_life = tktpol.maxrenewlife;
         else if (ldap_context->lrparams->max_renewable_life)
             entries->max_renewable_life = ldap_context->lrparams->max_renewable_life;
     }
 
     if ((mask & KDB_TKT_FLAGS_ATTR) == 0) {
         if ((omask & KDB_TKT_FLAGS_ATTR) == KDB_TKT_FLAGS_ATTR)
-            entries->attributes = tktpoldnparam->tktflags;
+            entries->attributes = tktpol.tktflags;
         else if (ldap_context->lrparams->tktflags)
             entries->attributes |= ldap_context->lrparams->tktflags;
     }
-    krb5_ldap_free_policy(context, tktpoldnparam);
 
 cleanup:
     return st;
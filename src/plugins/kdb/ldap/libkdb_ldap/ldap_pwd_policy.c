@@ -224,6 +224,7 @@ krb5_ldap_put_password_policy(krb5_context context, osa_policy_ent_t policy)
         st = set_ldap_error (context, st, OP_MOD);
         goto cleanup;
     }
+    krb5_ldap_policy_cache_flush(ldap_context, policy->name);
 
 cleanup:
     free(policy_dn);
@@ -365,6 +366,39 @@ cleanup:
     return st;
 }
 
+/*
+ * Read the lockout values of the password policy name into *pol, using the
+ * policy cache if an entry for it is present.
+ */
+krb5_error_code
+krb5_ldap_get_password_policy_cached(krb5_context context, char *name,
+                                     krb5_ldap_cached_policy *pol)
+{
+    krb5_error_code st;
+    osa_policy_ent_t policy = NULL;
+    kdb5_dal_handle *dal_handle = NULL;
+    krb5_ldap_context *ldap_context = NULL;
+
+    SETUP_CONTEXT();
+
+    memset(pol, 0, sizeof(*pol));
+    pol->type = PWD_POLICY_CACHE;
+    pol->name = name;
+    if (krb5_ldap_policy_cache_lookup(ldap_context, pol))
+        return 0;
+
+    st = krb5_ldap_get_password_policy(context, name, &policy);
+    if (st)
+        return st;
+    pol->pw_max_fail = policy->pw_max_fail;
+    pol->pw_failcnt_interval = policy->pw_failcnt_interval;
+    pol->pw_lockout_duration = policy->pw_lockout_duration;
+    krb5_db_free_policy(context, policy);
+
+    krb5_ldap_policy_cache_store(ldap_context, pol);
+    return 0;
+}
+
 krb5_error_code
 krb5_ldap_delete_password_policy(krb5_context context, char *policy)
 {
@@ -403,6 +437,7 @@ krb5_ldap_delete_password_policy(krb5_context context, char *policy)
         st = set_ldap_error (context, st, OP_DEL);
         goto cleanup;
     }
+    krb5_ldap_policy_cache_flush(ldap_context, policy);
 
 cleanup:
     krb5_ldap_put_handle_to_pool(ldap_context, ldap_server_handle);
@@ -34,6 +34,10 @@
 krb5_error_code
 krb5_ldap_get_password_policy(krb5_context, char *, osa_policy_ent_t *);
 
+krb5_error_code
+krb5_ldap_get_password_policy_cached(krb5_context, char *,
+                                     krb5_ldap_cached_policy *);
+
 krb5_error_code
 krb5_ldap_create_password_policy(krb5_context, osa_policy_ent_t);
 
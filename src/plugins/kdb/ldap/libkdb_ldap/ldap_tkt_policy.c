@@ -182,6 +182,7 @@ krb5_ldap_modify_policy(krb5_context context, krb5_ldap_policy_params *policy,
         st = set_ldap_error (context, st, OP_MOD);
         goto cleanup;
     }
+    krb5_ldap_policy_cache_flush(ldap_context, policy->policy);
 
 cleanup:
     if (policy_dn != NULL)
@@ -280,6 +281,42 @@ cleanup:
 }
 
 
+/*
+ * Read the ticket lifetime and flag values of the ticket policy object
+ * policyname into *pol, using the policy cache if an entry for it is present.
+ */
+krb5_error_code
+krb5_ldap_read_policy_cached(krb5_context context, char *policyname,
+                             krb5_ldap_cached_policy *pol)
+{
+    krb5_error_code st;
+    int omask = 0;
+    krb5_ldap_policy_params *lpolicy = NULL;
+    kdb5_dal_handle *dal_handle = NULL;
+    krb5_ldap_context *ldap_context = NULL;
+
+    SETUP_CONTEXT();
+
+    memset(pol, 0, sizeof(*pol));
+    pol->type = TKT_POLICY_CACHE;
+    pol->name = policyname;
+    if (krb5_ldap_policy_cache_lookup(ldap_context, pol))
+        return 0;
+
+    st = krb5_ldap_read_policy(context, policyname, &lpolicy, &omask);
+    if (st)
+        return st;
+    pol->mask = omask;
+    pol->maxtktlife = lpolicy->maxtktlife;
+    pol->maxrenewlife = lpolicy->maxrenewlife;
+    pol->tktflags = lpolicy->tktflags;
+    krb5_ldap_free_policy(context, lpolicy);
+
+    krb5_ldap_policy_cache_store(ldap_context, pol);
+    return 0;
+}
+
+
 /*
  * Function to delete ticket policy object from the directory.  Before
  * calling this function krb5_ldap_read_policy should be called to
@@ -332,6 +369,7 @@ krb5_ldap_delete_policy(krb5_context context, char *policyname)
 
             goto cleanup;
         }
+        krb5_ldap_policy_cache_flush(ldap_context, policyname);
     } else {
         st = EINVAL;
         k5_prependmsg(context, st,
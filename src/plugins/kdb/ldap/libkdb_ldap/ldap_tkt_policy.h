@@ -57,6 +57,9 @@ krb5_ldap_modify_policy(krb5_context, krb5_ldap_policy_params *, int);
 krb5_error_code
 krb5_ldap_read_policy(krb5_context, char *, krb5_ldap_policy_params **, int *);
 
+krb5_error_code
+krb5_ldap_read_policy_cached(krb5_context, char *, krb5_ldap_cached_policy *);
+
 krb5_error_code
 krb5_ldap_delete_policy(krb5_context, char *);
 
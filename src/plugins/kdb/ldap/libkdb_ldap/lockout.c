@@ -63,15 +63,15 @@ lookup_lockout_policy(krb5_context context,
         return code;
 
     if (adb.policy != NULL) {
-        osa_policy_ent_t policy = NULL;
+        krb5_ldap_cached_policy policy;
 
-        code = krb5_ldap_get_password_policy(context, adb.policy, &policy);
+        code = krb5_ldap_get_password_policy_cached(context, adb.policy,
+                                                    &policy);
         if (code == 0) {
-            *pw_max_fail = policy->pw_max_fail;
-            *pw_failcnt_interval = policy->pw_failcnt_interval;
-            *pw_lockout_duration = policy->pw_lockout_duration;
+            *pw_max_fail = policy.pw_max_fail;
+            *pw_failcnt_interval = policy.pw_failcnt_interval;
+            *pw_lockout_duration = policy.pw_lockout_duration;
         }
-        krb5_db_free_policy(context, policy);
     }
 
     xdrmem_create(&xdrs, NULL, 0, XDR_FREE);
@@ -61,6 +61,8 @@
 #define PKINIT_DEFAULT_DH_MIN_BITS  2048
 #define PKINIT_DH_MIN_CONFIG_BITS   1024
 
+#define PKINIT_DEFAULT_WORKER_THREADS   2
+
 #define KRB5_CONF_KDCDEFAULTS                   "kdcdefaults"
 #define KRB5_CONF_LIBDEFAULTS                   "libdefaults"
 #define KRB5_CONF_REALMS                        "realms"
@@ -77,6 +79,7 @@
 #define KRB5_CONF_PKINIT_POOL                   "pkinit_pool"
 #define KRB5_CONF_PKINIT_REQUIRE_CRL_CHECKING   "pkinit_require_crl_checking"
 #define KRB5_CONF_PKINIT_REVOKE                 "pkinit_revoke"
+#define KRB5_CONF_PKINIT_WORKER_THREADS         "pkinit_worker_threads"
 
 /* Make pkiDebug(fmt,...) print, or not.  */
 #ifdef DEBUG
@@ -148,6 +151,7 @@ typedef struct _pkinit_plg_opts {
     int dh_or_rsa;	    /* selects DH or RSA based pkinit */
     int require_crl_checking; /* require CRL for a CA (default is false) */
     int dh_min_bits;	    /* minimum DH modulus size allowed */
+    int worker_threads;	    /* threads for verifying requests (KDC) */
 } pkinit_plg_opts;
 
 /*
@@ -228,6 +232,7 @@ struct _pkinit_kdc_context {
     char *realmname;
     unsigned int realmname_len;
     char **auth_indicators;
+    struct pkinit_worker_pool *pool; /* created on first use */
 };
 typedef struct _pkinit_kdc_context *pkinit_kdc_context;
 
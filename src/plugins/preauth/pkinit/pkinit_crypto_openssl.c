@@ -239,6 +239,9 @@ static void compat_dh_get0_key(const DH *dh, const BIGNUM **pub,
         *priv = dh->priv_key;
 }
 
+#define DH_set_length(dh, len) ((dh)->length = (len), 1)
+#define X509_get0_notAfter X509_get_notAfter
+
 /* Return true if the cert c includes a key usage which doesn't include u.
  * Define using direct member access for pre-1.1. */
 #define ku_reject(c, u)                                                 \
@@ -576,6 +579,108 @@ pkinit_fini_plg_crypto(pkinit_plg_crypto_context cryptoctx)
     free(cryptoctx);
 }
 
+static void
+chain_cache_clear(pkinit_identity_crypto_context idctx)
+{
+    int i;
+
+    for (i = 0; i < CHAIN_CACHE_SIZE; i++) {
+        sk_X509_pop_free(idctx->chain_cache[i].chain, X509_free);
+        idctx->chain_cache[i].chain = NULL;
+    }
+}
+
+/*
+ * Compute into key a digest identifying the verification of cert x using the
+ * untrusted certificates sent with it, under the CRL checking mode
+ * require_crl.  Return 0 on failure.
+ */
+static int
+chain_cache_key(X509 *x, STACK_OF(X509) *sent, int require_crl,
+                unsigned char *key)
+{
+    EVP_MD_CTX *ctx;
+    unsigned char md[EVP_MAX_MD_SIZE], mode = require_crl;
+    unsigned int md_len;
+    int i, ok;
+
+    ctx = EVP_MD_CTX_new();
+    if (ctx == NULL)
+        return 0;
+    ok = EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+        EVP_DigestUpdate(ctx, &mode, 1) &&
+        X509_digest(x, EVP_sha256(), md, &md_len) &&
+        EVP_DigestUpdate(ctx, md, md_len);
+    for (i = 0; ok && i < sk_X509_num(sent); i++) {
+        ok = X509_digest(sk_X509_value(sent, i), EVP_sha256(), md, &md_len) &&
+            EVP_DigestUpdate(ctx, md, md_len);
+    }
+    ok = ok && EVP_DigestFinal_ex(ctx, key, NULL);
+    EVP_MD_CTX_free(ctx);
+    return ok;
+}
+
+/* Return a new reference to the cached verified chain for key, or NULL if
+ * there is none which is still current.  The KDC may verify requests on
+ * worker threads, so the cache is accessed under chain_cache_lock. */
+static STACK_OF(X509) *
+chain_cache_lookup(pkinit_identity_crypto_context idctx,
+                   const unsigned char *key)
+{
+    struct chain_cache_entry *ent;
+    STACK_OF(X509) *chain = NULL;
+    time_t now = time(NULL);
+    int i, j;
+
+    k5_mutex_lock(&idctx->chain_cache_lock);
+    for (i = 0; i < CHAIN_CACHE_SIZE; i++) {
+        ent = &idctx->chain_cache[i];
+        if (ent->chain == NULL || ent->expires <= now ||
+            memcmp(ent->key, key, sizeof(ent->key)) != 0)
+            continue;
+        for (j = 0; j < sk_X509_num(ent->chain); j++) {
+            if (X509_cmp_time(X509_get0_notAfter(sk_X509_value(ent->chain, j)),
+                              &now) <= 0)
+                break;
+        }
+        if (j == sk_X509_num(ent->chain))
+            chain = X509_chain_up_ref(ent->chain);
+        break;
+    }
+    k5_mutex_unlock(&idctx->chain_cache_lock);
+    return chain;
+}
+
+/* Remember chain as the result of the verification identified by key,
+ * replacing the entry closest to expiry if the cache is full. */
+static void
+chain_cache_store(pkinit_identity_crypto_context idctx,
+                  const unsigned char *key, STACK_OF(X509) *chain)
+{
+    struct chain_cache_entry *ent, *victim = &idctx->chain_cache[0];
+    STACK_OF(X509) *ref;
+    int i;
+
+    ref = X509_chain_up_ref(chain);
+    if (ref == NULL)
+        return;
+    k5_mutex_lock(&idctx->chain_cache_lock);
+    for (i = 0; i < CHAIN_CACHE_SIZE; i++) {
+        ent = &idctx->chain_cache[i];
+        if (ent->chain == NULL) {
+            victim = ent;
+            break;
+        }
+        if (ent->expires < victim->expires)
+            victim = ent;
+    }
+    sk_X509_pop_free(victim->chain, X509_free);
+    memcpy(victim->key, key, sizeof(victim->key));
+    victim->expires = time(NULL) + CHAIN_CACHE_LIFETIME;
+    victim->chain = ref;
+    k5_mutex_unlock(&idctx->chain_cache_lock);
+}
+
 krb5_error_code
 pkinit_init_identity_crypto(pkinit_identity_crypto_context *idctx)
 {
@@ -587,6 +692,13 @@ pkinit_init_identity_crypto(pkinit_identity_crypto_context *idctx)
         goto out;
     memset(ctx, 0, sizeof(*ctx));
 
+    retval = k5_mutex_init(&ctx->chain_cache_lock);
+    if (retval) {
+        free(ctx);
+        ctx = NULL;
+        goto out;
+    }
+
     ctx->identity = NULL;
 
     retval = pkinit_init_certs(ctx);
@@ -619,6 +731,8 @@ pkinit_fini_identity_crypto(pkinit_identity_crypto_context idctx)
     if (idctx->deferred_ids != NULL)
         pkinit_free_deferred_ids(idctx->deferred_ids);
     free(idctx->identity);
+    chain_cache_clear(idctx);
+    k5_mutex_destroy(&idctx->chain_cache_lock);
     pkinit_fini_certs(idctx);
     pkinit_fini_pkcs11(idctx);
     free(idctx);
@@ -1465,7 +1579,8 @@ cms_signeddata_verify(krb5_context context,
     CMS_ContentInfo *cms = NULL;
     BIO *out = NULL;
     int flags = CMS_NO_SIGNER_CERT_VERIFY;
-    int valid_oid = 0;
+    int valid_oid = 0, use_chain_cache = 0;
+    unsigned char chain_key[SHA256_DIGEST_LENGTH];
     unsigned int i = 0;
     unsigned int vflags = 0, size = 0;
     const unsigned char *p = signed_data;
@@ -1617,6 +1732,17 @@ cms_signeddata_verify(krb5_context context,
             }
         }
 
+        /* The KDC can skip verifying a client certificate chain it has
+         * verified recently, unless the request carries CRLs. */
+        if ((cms_msg_type == CMS_SIGN_CLIENT ||
+             cms_msg_type == CMS_SIGN_DRAFT9) && signerRevoked == NULL &&
+            chain_cache_key(x, signerCerts, require_crl_checking, chain_key)) {
+            use_chain_cache = 1;
+            verified_chain = chain_cache_lookup(idctx, chain_key);
+            if (verified_chain != NULL)
+                goto chain_verified;
+        }
+
         /* initialize x509 context with the received certificate and
          * trusted and intermediate CA chains and CRLs
          */
@@ -1712,6 +1838,10 @@ cms_signeddata_verify(krb5_context context,
         X509_STORE_CTX_free(cert_ctx);
         if (i <= 0)
             goto cleanup;
+        if (use_chain_cache && verified_chain != NULL)
+            chain_cache_store(idctx, chain_key, verified_chain);
+
+    chain_verified:
         out = BIO_new(BIO_s_mem());
         if (cms_msg_type == CMS_SIGN_DRAFT9)
             flags |= CMS_NOATTR;
@@ -2891,27 +3021,44 @@ cleanup:
     return retval;
 }
 
-/* Duplicate a DH handle (parameters only, not public or private key). */
+/*
+ * Return the private exponent length to use in a MODP group with a prime of
+ * prime_bits.  An exponent of at least twice the group's security strength is
+ * as strong as a full-length one (RFC 3526 section 8), and makes the modular
+ * exponentiations several times cheaper.
+ */
+static int
+dh_private_bits(int prime_bits)
+{
+    if (prime_bits <= 1024)
+        return 256;
+    if (prime_bits <= 2048)
+        return 320;
+    return 480;
+}
+
+/* Create a DH handle in the group of src (parameters only, not public or
+ * private key) for generating a server key with a short exponent. */
 static DH *
 dup_dh_params(const DH *src)
 {
-    const BIGNUM *oldp, *oldq, *oldg;
-    BIGNUM *p = NULL, *q = NULL, *g = NULL;
+    const BIGNUM *oldp, *oldg;
+    BIGNUM *p = NULL, *g = NULL;
     DH *dh;
 
-    DH_get0_pqg(src, &oldp, &oldq, &oldg);
+    DH_get0_pqg(src, &oldp, NULL, &oldg);
     p = BN_dup(oldp);
-    q = BN_dup(oldq);
     g = BN_dup(oldg);
     dh = DH_new();
-    if (p == NULL || q == NULL || g == NULL || dh == NULL) {
+    if (p == NULL || g == NULL || dh == NULL) {
         BN_free(p);
-        BN_free(q);
         BN_free(g);
         DH_free(dh);
         return NULL;
     }
-    DH_set0_pqg(dh, p, q, g);
+    /* Leave out q, which would make OpenSSL pick an exponent below q. */
+    DH_set0_pqg(dh, p, NULL, g);
+    DH_set_length(dh, dh_private_bits(BN_num_bits(p)));
     return dh;
 }
 
@@ -2991,6 +3138,7 @@ server_process_dh(krb5_context context,
 
     retval = 0;
 
+    BN_free(client_pubkey);
     if (dh_server != NULL)
         DH_free(dh_server);
     return retval;
@@ -66,6 +66,17 @@ struct _pkinit_cred_info {
 };
 typedef struct _pkinit_cred_info * pkinit_cred_info;
 
+/* Results of recent successful verifications of client certificate chains,
+ * used by the KDC. */
+#define CHAIN_CACHE_SIZE 64
+#define CHAIN_CACHE_LIFETIME 300
+
+struct chain_cache_entry {
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    time_t expires;
+    STACK_OF(X509) *chain;      /* verified chain, or NULL if unused */
+};
+
 struct _pkinit_identity_crypto_context {
     pkinit_cred_info creds[MAX_CREDS_ALLOWED+1];
     STACK_OF(X509) *my_certs;   /* available user certs */
@@ -93,6 +104,8 @@ struct _pkinit_identity_crypto_context {
 #endif
     krb5_boolean defer_id_prompt;
     pkinit_deferred_id *deferred_ids;
+    k5_mutex_t chain_cache_lock;
+    struct chain_cache_entry chain_cache[CHAIN_CACHE_SIZE];
 };
 
 struct _pkinit_plg_crypto_context {
@@ -31,6 +31,7 @@
 
 #include <k5-int.h>
 #include "pkinit.h"
+#include <verto.h>
 
 static krb5_error_code
 pkinit_init_kdc_req_context(krb5_context, pkinit_kdc_req_context *blob);
@@ -271,118 +272,128 @@ out:
     return retval;
 }
 
+/*
+ * State of a pkinit_server_verify_padata() call.  Checking the CMS signature
+ * and the client's certificate chain is the expensive part of verifying a
+ * request, so when a realm has worker threads configured, that step is run on
+ * a worker thread and the rest of the verification is completed on the KDC's
+ * event loop once it finishes.
+ */
+struct verify_job {
+    struct verify_job *next;
+    krb5_context context;
+    krb5_data *req_pkt;
+    krb5_kdc_req *request;
+    krb5_enc_tkt_part *enc_tkt_reply;
+    krb5_preauthtype pa_type;
+    krb5_kdcpreauth_callbacks cb;
+    krb5_kdcpreauth_rock rock;
+    krb5_kdcpreauth_verify_respond_fn respond;
+    void *arg;
+    pkinit_kdc_context plgctx;
+    pkinit_kdc_req_context reqctx;
+    krb5_pa_pk_as_req *reqp;
+    krb5_pa_pk_as_req_draft9 *reqp9;
+
+    /* Results of the signature check. */
+    krb5_error_code retval;
+    char *errmsg;
+    krb5_data authp_data;
+    krb5_data krb5_authz;
+    int is_signed;
+};
+
+/* Verify the signed auth pack of job's request using context, storing the
+ * result in job. */
 static void
-pkinit_server_verify_padata(krb5_context context,
-                            krb5_data *req_pkt,
-                            krb5_kdc_req * request,
-                            krb5_enc_tkt_part * enc_tkt_reply,
-                            krb5_pa_data * data,
-                            krb5_kdcpreauth_callbacks cb,
-                            krb5_kdcpreauth_rock rock,
-                            krb5_kdcpreauth_moddata moddata,
-                            krb5_kdcpreauth_verify_respond_fn respond,
-                            void *arg)
+verify_signature(krb5_context context, struct verify_job *job)
 {
-    krb5_error_code retval = 0;
-    krb5_data authp_data = {0, 0, NULL}, krb5_authz = {0, 0, NULL};
-    krb5_pa_pk_as_req *reqp = NULL;
-    krb5_pa_pk_as_req_draft9 *reqp9 = NULL;
+    pkinit_kdc_context plgctx = job->plgctx;
+
+    if (job->pa_type == KRB5_PADATA_PK_AS_REQ) {
+        job->retval = cms_signeddata_verify(context, plgctx->cryptoctx,
+                                            job->reqctx->cryptoctx,
+                                            plgctx->idctx, CMS_SIGN_CLIENT,
+                                            plgctx->opts->require_crl_checking,
+                                            (unsigned char *)
+                                            job->reqp->signedAuthPack.data,
+                                            job->reqp->signedAuthPack.length,
+                                            (unsigned char **)
+                                            &job->authp_data.data,
+                                            &job->authp_data.length,
+                                            (unsigned char **)
+                                            &job->krb5_authz.data,
+                                            &job->krb5_authz.length,
+                                            &job->is_signed);
+    } else {
+        job->retval = cms_signeddata_verify(context, plgctx->cryptoctx,
+                                            job->reqctx->cryptoctx,
+                                            plgctx->idctx, CMS_SIGN_DRAFT9,
+                                            plgctx->opts->require_crl_checking,
+                                            (unsigned char *)
+                                            job->reqp9->signedAuthPack.data,
+                                            job->reqp9->signedAuthPack.length,
+                                            (unsigned char **)
+                                            &job->authp_data.data,
+                                            &job->authp_data.length,
+                                            (unsigned char **)
+                                            &job->krb5_authz.data,
+                                            &job->krb5_authz.length, NULL);
+    }
+}
+
+/* Release the request data held by job, without responding. */
+static void
+free_verify_job(struct verify_job *job)
+{
+    krb5_context context = job->context;
+
+    switch ((int)job->pa_type) {
+    case KRB5_PADATA_PK_AS_REQ:
+        free_krb5_pa_pk_as_req(&job->reqp);
+        break;
+    case KRB5_PADATA_PK_AS_REP_OLD:
+    case KRB5_PADATA_PK_AS_REQ_OLD:
+        free_krb5_pa_pk_as_req_draft9(&job->reqp9);
+    }
+    free(job->authp_data.data);
+    free(job->krb5_authz.data);
+    free(job->errmsg);
+    if (job->reqctx != NULL)
+        pkinit_fini_kdc_req_context(context, job->reqctx);
+    free(job);
+}
+
+/* Complete the verification of job's request after the signature check, and
+ * respond to the KDC. */
+static void
+verify_padata_finish(struct verify_job *job)
+{
+    krb5_context context = job->context;
+    krb5_error_code retval = job->retval;
+    krb5_kdc_req *request = job->request;
+    krb5_kdcpreauth_callbacks cb = job->cb;
+    krb5_kdcpreauth_rock rock = job->rock;
+    krb5_kdcpreauth_verify_respond_fn respond = job->respond;
+    void *arg = job->arg;
+    pkinit_kdc_context plgctx = job->plgctx;
+    pkinit_kdc_req_context reqctx = job->reqctx;
+    krb5_pa_pk_as_req *reqp = job->reqp;
     krb5_auth_pack *auth_pack = NULL;
     krb5_auth_pack_draft9 *auth_pack9 = NULL;
-    pkinit_kdc_context plgctx = NULL;
-    pkinit_kdc_req_context reqctx = NULL;
     krb5_checksum cksum = {0, 0, 0, NULL};
     krb5_data *der_req = NULL;
     int valid_eku = 0, valid_san = 0;
     krb5_data k5data;
-    int is_signed = 1;
+    int is_signed = job->is_signed;
     krb5_pa_data **e_data = NULL;
     krb5_kdcpreauth_modreq modreq = NULL;
     char **sp;
 
-    pkiDebug("pkinit_verify_padata: entered!\n");
-    if (data == NULL || data->length <= 0 || data->contents == NULL) {
-        (*respond)(arg, EINVAL, NULL, NULL, NULL);
-        return;
-    }
-
-
-    if (moddata == NULL) {
-        (*respond)(arg, EINVAL, NULL, NULL, NULL);
-        return;
-    }
-
-    plgctx = pkinit_find_realm_context(context, moddata, request->server);
-    if (plgctx == NULL) {
-        (*respond)(arg, EINVAL, NULL, NULL, NULL);
-        return;
-    }
-
-#ifdef DEBUG_ASN1
-    print_buffer_bin(data->contents, data->length, "/tmp/kdc_as_req");
-#endif
-    /* create a per-request context */
-    retval = pkinit_init_kdc_req_context(context, &reqctx);
-    if (retval)
-        goto cleanup;
-    reqctx->pa_type = data->pa_type;
-
-    PADATA_TO_KRB5DATA(data, &k5data);
-
-    switch ((int)data->pa_type) {
-    case KRB5_PADATA_PK_AS_REQ:
-        pkiDebug("processing KRB5_PADATA_PK_AS_REQ\n");
-        retval = k5int_decode_krb5_pa_pk_as_req(&k5data, &reqp);
-        if (retval) {
-            pkiDebug("decode_krb5_pa_pk_as_req failed\n");
-            goto cleanup;
-        }
-#ifdef DEBUG_ASN1
-        print_buffer_bin(reqp->signedAuthPack.data,
-                         reqp->signedAuthPack.length,
-                         "/tmp/kdc_signed_data");
-#endif
-        retval = cms_signeddata_verify(context, plgctx->cryptoctx,
-                                       reqctx->cryptoctx, plgctx->idctx, CMS_SIGN_CLIENT,
-                                       plgctx->opts->require_crl_checking,
-                                       (unsigned char *)
-                                       reqp->signedAuthPack.data, reqp->signedAuthPack.length,
-                                       (unsigned char **)&authp_data.data,
-                                       &authp_data.length,
-                                       (unsigned char **)&krb5_authz.data,
-                                       &krb5_authz.length, &is_signed);
-        break;
-    case KRB5_PADATA_PK_AS_REP_OLD:
-    case KRB5_PADATA_PK_AS_REQ_OLD:
-        pkiDebug("processing KRB5_PADATA_PK_AS_REQ_OLD\n");
-        retval = k5int_decode_krb5_pa_pk_as_req_draft9(&k5data, &reqp9);
-        if (retval) {
-            pkiDebug("decode_krb5_pa_pk_as_req_draft9 failed\n");
-            goto cleanup;
-        }
-#ifdef DEBUG_ASN1
-        print_buffer_bin(reqp9->signedAuthPack.data,
-                         reqp9->signedAuthPack.length,
-                         "/tmp/kdc_signed_data_draft9");
-#endif
-
-        retval = cms_signeddata_verify(context, plgctx->cryptoctx,
-                                       reqctx->cryptoctx, plgctx->idctx, CMS_SIGN_DRAFT9,
-                                       plgctx->opts->require_crl_checking,
-                                       (unsigned char *)
-                                       reqp9->signedAuthPack.data, reqp9->signedAuthPack.length,
-                                       (unsigned char **)&authp_data.data,
-                                       &authp_data.length,
-                                       (unsigned char **)&krb5_authz.data,
-                                       &krb5_authz.length, NULL);
-        break;
-    default:
-        pkiDebug("unrecognized pa_type = %d\n", data->pa_type);
-        retval = EINVAL;
-        goto cleanup;
-    }
     if (retval) {
         pkiDebug("pkcs7_signeddata_verify failed\n");
+        if (job->errmsg != NULL)
+            krb5_set_error_message(context, retval, "%s", job->errmsg);
         goto cleanup;
     }
     if (is_signed) {
@@ -418,11 +429,12 @@ pkinit_server_verify_padata(krb5_context context,
         }
     }
 #ifdef DEBUG_ASN1
-    print_buffer_bin(authp_data.data, authp_data.length, "/tmp/kdc_auth_pack");
+    print_buffer_bin(job->authp_data.data, job->authp_data.length,
+                     "/tmp/kdc_auth_pack");
 #endif
 
-    OCTETDATA_TO_KRB5DATA(&authp_data, &k5data);
-    switch ((int)data->pa_type) {
+    OCTETDATA_TO_KRB5DATA(&job->authp_data, &k5data);
+    switch ((int)job->pa_type) {
     case KRB5_PADATA_PK_AS_REQ:
         retval = k5int_decode_krb5_auth_pack(&k5data, &auth_pack);
         if (retval) {
@@ -468,8 +480,8 @@ pkinit_server_verify_padata(krb5_context context,
             pkiDebug("failed to match the checksum\n");
 #ifdef DEBUG_CKSUM
             pkiDebug("calculating checksum on buf size (%d)\n",
-                     req_pkt->length);
-            print_buffer(req_pkt->data, req_pkt->length);
+                     job->req_pkt->length);
+            print_buffer(job->req_pkt->data, job->req_pkt->length);
             pkiDebug("received checksum type=%d size=%d ",
                      auth_pack->pkAuthenticator.paChecksum.checksum_type,
                      auth_pack->pkAuthenticator.paChecksum.length);
@@ -536,35 +548,401 @@ pkinit_server_verify_padata(krb5_context context,
     }
 
     /* remember to set the PREAUTH flag in the reply */
-    enc_tkt_reply->flags |= TKT_FLG_PRE_AUTH;
+    job->enc_tkt_reply->flags |= TKT_FLG_PRE_AUTH;
     modreq = (krb5_kdcpreauth_modreq)reqctx;
-    reqctx = NULL;
+    job->reqctx = NULL;
 
 cleanup:
-    if (retval && data->pa_type == KRB5_PADATA_PK_AS_REQ) {
+    if (retval && job->pa_type == KRB5_PADATA_PK_AS_REQ && reqctx != NULL) {
         pkiDebug("pkinit_verify_padata failed: creating e-data\n");
         if (pkinit_create_edata(context, plgctx->cryptoctx, reqctx->cryptoctx,
                                 plgctx->idctx, plgctx->opts, retval, &e_data))
             pkiDebug("pkinit_create_edata failed\n");
     }
 
+    free(cksum.contents);
+    free_krb5_auth_pack(&auth_pack);
+    free_krb5_auth_pack_draft9(context, &auth_pack9);
+    free_verify_job(job);
+
+    (*respond)(arg, retval, modreq, e_data, NULL);
+}
+
+#ifdef ENABLE_THREADS
+
+/* Maximum number of requests queued or in progress per worker thread.  When
+ * a realm's pool is this busy, further requests are verified inline. */
+#define WORKER_QUEUE_DEPTH 16
+
+struct pkinit_worker_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int nthreads;
+    pthread_t *threads;
+    krb5_context *contexts;     /* one per thread */
+    struct verify_job *queue;   /* jobs waiting for a thread */
+    struct verify_job **queue_tail;
+    struct verify_job *done;    /* jobs waiting to be finished */
+    int shutdown;
+    unsigned int pending;       /* jobs submitted but not finished */
+    int notify[2];              /* pipe signalling done jobs to the loop */
+    verto_ev *ev;
+};
+
+struct worker_arg {
+    struct pkinit_worker_pool *pool;
+    krb5_context context;
+};
+
+static void *
+worker_main(void *ptr)
+{
+    struct pkinit_worker_pool *pool = ((struct worker_arg *)ptr)->pool;
+    krb5_context context = ((struct worker_arg *)ptr)->context;
+    struct verify_job *job;
+    const char *msg;
+
+    free(ptr);
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && pool->queue == NULL)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        if (pool->shutdown)
+            break;
+        job = pool->queue;
+        pool->queue = job->next;
+        if (pool->queue == NULL)
+            pool->queue_tail = &pool->queue;
+        pthread_mutex_unlock(&pool->lock);
+
+        verify_signature(context, job);
+        if (job->retval) {
+            msg = krb5_get_error_message(context, job->retval);
+            job->errmsg = strdup(msg);
+            krb5_free_error_message(context, msg);
+            krb5_clear_error_message(context);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        job->next = pool->done;
+        pool->done = job;
+        /* If the pipe is full, the loop has not yet drained it and will see
+         * this job anyway. */
+        (void)write(pool->notify[1], "", 1);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Finish the jobs completed by the worker threads. */
+static void
+worker_done_cb(verto_ctx *vctx, verto_ev *ev)
+{
+    struct pkinit_worker_pool *pool = verto_get_private(ev);
+    struct verify_job *job, *next;
+    char buf[64];
+
+    while (read(pool->notify[0], buf, sizeof(buf)) > 0);
+
+    pthread_mutex_lock(&pool->lock);
+    job = pool->done;
+    pool->done = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    for (; job != NULL; job = next) {
+        next = job->next;
+        pool->pending--;
+        verify_padata_finish(job);
+    }
+}
+
+/*
+ * Stop pool's threads and free it, discarding any unfinished jobs.  The I/O
+ * event is not deleted, as the KDC frees its event context before unloading
+ * preauth modules.
+ */
+static void
+worker_pool_free(struct pkinit_worker_pool *pool)
+{
+    struct verify_job *job, *next;
+    int i;
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+    for (i = 0; pool->contexts != NULL && i < pool->nthreads; i++)
+        krb5_free_context(pool->contexts[i]);
+
+    for (job = pool->queue; job != NULL; job = next) {
+        next = job->next;
+        free_verify_job(job);
+    }
+    for (job = pool->done; job != NULL; job = next) {
+        next = job->next;
+        free_verify_job(job);
+    }
+    if (pool->notify[0] != -1) {
+        close(pool->notify[0]);
+        close(pool->notify[1]);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->contexts);
+    free(pool);
+}
+
+/*
+ * Create a pool of nthreads worker threads, each with its own copy of context,
+ * reporting completed jobs via an I/O event on vctx.  This is done on first
+ * use rather than at module initialization, since the KDC may fork worker
+ * processes after loading modules.
+ */
+static krb5_error_code
+worker_pool_create(krb5_context context, verto_ctx *vctx, int nthreads,
+                   struct pkinit_worker_pool **pool_out)
+{
+    krb5_error_code ret;
+    struct pkinit_worker_pool *pool;
+    struct worker_arg *warg;
+    int i = 0, flags;
+
+    *pool_out = NULL;
+
+    pool = k5alloc(sizeof(*pool), &ret);
+    if (pool == NULL)
+        return ret;
+    pool->notify[0] = pool->notify[1] = -1;
+    pool->queue_tail = &pool->queue;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    pool->threads = k5calloc(nthreads, sizeof(*pool->threads), &ret);
+    if (pool->threads == NULL)
+        goto error;
+    pool->contexts = k5calloc(nthreads, sizeof(*pool->contexts), &ret);
+    if (pool->contexts == NULL)
+        goto error;
+
+    if (pipe(pool->notify) == -1) {
+        ret = errno;
+        pool->notify[0] = pool->notify[1] = -1;
+        goto error;
+    }
+    for (i = 0; i < 2; i++) {
+        set_cloexec_fd(pool->notify[i]);
+        flags = fcntl(pool->notify[i], F_GETFL);
+        (void)fcntl(pool->notify[i], F_SETFL, flags | O_NONBLOCK);
+    }
+
+    pool->ev = verto_add_io(vctx, VERTO_EV_FLAG_PERSIST |
+                            VERTO_EV_FLAG_IO_READ, worker_done_cb,
+                            pool->notify[0]);
+    if (pool->ev == NULL) {
+        ret = ENOMEM;
+        goto error;
+    }
+    verto_set_private(pool->ev, pool, NULL);
+
+    for (i = 0; i < nthreads; i++) {
+        ret = krb5_copy_context(context, &pool->contexts[i]);
+        if (ret)
+            goto error;
+        warg = k5alloc(sizeof(*warg), &ret);
+        if (warg == NULL)
+            goto error;
+        warg->pool = pool;
+        warg->context = pool->contexts[i];
+        ret = pthread_create(&pool->threads[i], NULL, worker_main, warg);
+        if (ret) {
+            free(warg);
+            goto error;
+        }
+        pool->nthreads++;
+    }
+
+    *pool_out = pool;
+    return 0;
+
+error:
+    if (pool->ev != NULL)
+        verto_del(pool->ev);
+    /* Free the context copy which has no thread, if any. */
+    if (pool->contexts != NULL && i < nthreads && pool->contexts[i] != NULL) {
+        krb5_free_context(pool->contexts[i]);
+        pool->contexts[i] = NULL;
+    }
+    worker_pool_free(pool);
+    return ret;
+}
+
+/*
+ * Queue job for its signature check on the realm's worker pool, creating the
+ * pool if necessary.  Return false if the job should be processed inline
+ * instead.
+ */
+static krb5_boolean
+submit_verify_job(struct verify_job *job)
+{
+    pkinit_kdc_context plgctx = job->plgctx;
+    struct pkinit_worker_pool *pool;
+    verto_ctx *vctx;
+
+    if (plgctx->opts->worker_threads <= 0)
+        return FALSE;
+
+    if (plgctx->pool == NULL) {
+        vctx = job->cb->event_context(job->context, job->rock);
+        if (worker_pool_create(job->context, vctx, plgctx->opts->worker_threads,
+                               &plgctx->pool) != 0) {
+            pkiDebug("%s: unable to start worker threads for realm %s\n",
+                     __FUNCTION__, plgctx->realmname);
+            plgctx->opts->worker_threads = 0;
+            return FALSE;
+        }
+    }
+    pool = plgctx->pool;
+
+    if (pool->pending >= (unsigned int)pool->nthreads * WORKER_QUEUE_DEPTH)
+        return FALSE;
+
+    pool->pending++;
+    job->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    *pool->queue_tail = job;
+    pool->queue_tail = &job->next;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return TRUE;
+}
+
+#else /* !ENABLE_THREADS */
+
+static void
+worker_pool_free(struct pkinit_worker_pool *pool)
+{
+}
+
+static krb5_boolean
+submit_verify_job(struct verify_job *job)
+{
+    return FALSE;
+}
+
+#endif /* !ENABLE_THREADS */
+
+static void
+pkinit_server_verify_padata(krb5_context context,
+                            krb5_data *req_pkt,
+                            krb5_kdc_req * request,
+                            krb5_enc_tkt_part * enc_tkt_reply,
+                            krb5_pa_data * data,
+                            krb5_kdcpreauth_callbacks cb,
+                            krb5_kdcpreauth_rock rock,
+                            krb5_kdcpreauth_moddata moddata,
+                            krb5_kdcpreauth_verify_respond_fn respond,
+                            void *arg)
+{
+    krb5_error_code retval = 0;
+    pkinit_kdc_context plgctx = NULL;
+    struct verify_job *job;
+    krb5_data k5data;
+
+    pkiDebug("pkinit_verify_padata: entered!\n");
+    if (data == NULL || data->length <= 0 || data->contents == NULL) {
+        (*respond)(arg, EINVAL, NULL, NULL, NULL);
+        return;
+    }
+
+
+    if (moddata == NULL) {
+        (*respond)(arg, EINVAL, NULL, NULL, NULL);
+        return;
+    }
+
+    plgctx = pkinit_find_realm_context(context, moddata, request->server);
+    if (plgctx == NULL) {
+        (*respond)(arg, EINVAL, NULL, NULL, NULL);
+        return;
+    }
+
+    job = k5alloc(sizeof(*job), &retval);
+    if (job == NULL) {
+        (*respond)(arg, retval, NULL, NULL, NULL);
+        return;
+    }
+    job->context = context;
+    job->req_pkt = req_pkt;
+    job->request = request;
+    job->enc_tkt_reply = enc_tkt_reply;
+    job->pa_type = data->pa_type;
+    job->cb = cb;
+    job->rock = rock;
+    job->respond = respond;
+    job->arg = arg;
+    job->plgctx = plgctx;
+    job->is_signed = 1;
+
+#ifdef DEBUG_ASN1
+    print_buffer_bin(data->contents, data->length, "/tmp/kdc_as_req");
+#endif
+    /* create a per-request context */
+    retval = pkinit_init_kdc_req_context(context, &job->reqctx);
+    if (retval)
+        goto error;
+    job->reqctx->pa_type = data->pa_type;
+
+    PADATA_TO_KRB5DATA(data, &k5data);
+
     switch ((int)data->pa_type) {
     case KRB5_PADATA_PK_AS_REQ:
-        free_krb5_pa_pk_as_req(&reqp);
-        free(cksum.contents);
+        pkiDebug("processing KRB5_PADATA_PK_AS_REQ\n");
+        retval = k5int_decode_krb5_pa_pk_as_req(&k5data, &job->reqp);
+        if (retval) {
+            pkiDebug("decode_krb5_pa_pk_as_req failed\n");
+            goto error;
+        }
+#ifdef DEBUG_ASN1
+        print_buffer_bin(job->reqp->signedAuthPack.data,
+                         job->reqp->signedAuthPack.length,
+                         "/tmp/kdc_signed_data");
+#endif
         break;
     case KRB5_PADATA_PK_AS_REP_OLD:
     case KRB5_PADATA_PK_AS_REQ_OLD:
-        free_krb5_pa_pk_as_req_draft9(&reqp9);
+        pkiDebug("processing KRB5_PADATA_PK_AS_REQ_OLD\n");
+        retval = k5int_decode_krb5_pa_pk_as_req_draft9(&k5data, &job->reqp9);
+        if (retval) {
+            pkiDebug("decode_krb5_pa_pk_as_req_draft9 failed\n");
+            goto error;
+        }
+#ifdef DEBUG_ASN1
+        print_buffer_bin(job->reqp9->signedAuthPack.data,
+                         job->reqp9->signedAuthPack.length,
+                         "/tmp/kdc_signed_data_draft9");
+#endif
+        break;
+    default:
+        pkiDebug("unrecognized pa_type = %d\n", data->pa_type);
+        retval = EINVAL;
+        goto error;
     }
-    free(authp_data.data);
-    free(krb5_authz.data);
-    if (reqctx != NULL)
-        pkinit_fini_kdc_req_context(context, reqctx);
-    free_krb5_auth_pack(&auth_pack);
-    free_krb5_auth_pack_draft9(context, &auth_pack9);
 
-    (*respond)(arg, retval, modreq, e_data, NULL);
+    if (submit_verify_job(job))
+        return;
+    verify_signature(context, job);
+    verify_padata_finish(job);
+    return;
+
+error:
+    job->retval = retval;
+    verify_padata_finish(job);
 }
 static krb5_error_code
 return_pkinit_kx(krb5_context context, krb5_kdc_req *request,
@@ -1231,6 +1609,11 @@ pkinit_init_kdc_profile(krb5_context context, pkinit_kdc_context plgctx)
                               KRB5_CONF_PKINIT_INDICATOR,
                               &plgctx->auth_indicators);
 
+    pkinit_kdcdefault_integer(context, plgctx->realmname,
+                              KRB5_CONF_PKINIT_WORKER_THREADS,
+                              PKINIT_DEFAULT_WORKER_THREADS,
+                              &plgctx->opts->worker_threads);
+
     return 0;
 errout:
     pkinit_fini_kdc_profile(context, plgctx);
@@ -1387,6 +1770,7 @@ pkinit_server_plugin_fini_realm(krb5_context context, pkinit_kdc_context plgctx)
     if (plgctx == NULL)
         return;
 
+    worker_pool_free(plgctx->pool);
     pkinit_fini_kdc_profile(context, plgctx);
     pkinit_fini_identity_opts(plgctx->idopts);
     pkinit_fini_identity_crypto(plgctx->idctx);
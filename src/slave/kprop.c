@@ -36,6 +36,9 @@
 #include <sys/param.h>
 #include <netdb.h>
 #include <fcntl.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "com_err.h"
 #include "fake-addrinfo.h"
@@ -45,8 +48,6 @@
 #define GETSOCKNAME_ARG3_TYPE unsigned int
 #endif
 
-static char *kprop_version = KPROP_PROT_VERSION;
-
 static char *progname = NULL;
 static int debug = 0;
 static char *srvtab = NULL;
@@ -68,14 +69,20 @@ static void parse_args(krb5_context context, int argc, char **argv);
 static void get_tickets(krb5_context context);
 static void usage(void);
 static void open_connection(krb5_context context, char *host, int *fd_out);
-static void kerberos_authenticate(krb5_context context,
-                                  krb5_auth_context *auth_context, int fd,
-                                  krb5_principal me, krb5_creds **new_creds);
-static int open_database(krb5_context context, char *data_fn, int *size);
+static krb5_boolean kerberos_authenticate(krb5_context context,
+                                          krb5_auth_context *auth_context,
+                                          int fd, krb5_principal me,
+                                          char *version,
+                                          krb5_creds **new_creds);
+static int open_database(krb5_context context, char *data_fn, off_t *size);
 static void close_database(krb5_context context, int fd);
 static void xmit_database(krb5_context context,
                           krb5_auth_context auth_context, krb5_creds *my_creds,
-                          int fd, int database_fd, int in_database_size);
+                          int fd, int database_fd, off_t in_database_size);
+static void xmit_database_v2(krb5_context context,
+                             krb5_auth_context auth_context,
+                             krb5_creds *my_creds, int fd, int database_fd,
+                             off_t database_size);
 static void send_error(krb5_context context, krb5_creds *my_creds, int fd,
                        char *err_text, krb5_error_code err_code);
 static void update_last_prop_file(char *hostname, char *file_name);
@@ -90,7 +97,8 @@ static void usage()
 int
 main(int argc, char **argv)
 {
-    int fd, database_fd, database_size;
+    int fd, database_fd;
+    off_t database_size;
     krb5_error_code retval;
     krb5_context context;
     krb5_creds *my_creds;
@@ -107,9 +115,25 @@ main(int argc, char **argv)
 
     database_fd = open_database(context, file, &database_size);
     open_connection(context, slave_host, &fd);
-    kerberos_authenticate(context, &auth_context, fd, my_principal, &my_creds);
-    xmit_database(context, auth_context, my_creds, fd, database_fd,
-                  database_size);
+    if (kerberos_authenticate(context, &auth_context, fd, my_principal,
+                              KPROP_PROT_VERSION2, &my_creds)) {
+        xmit_database_v2(context, auth_context, my_creds, fd, database_fd,
+                         database_size);
+    } else {
+        /* The slave doesn't know protocol version 2; reconnect and use
+         * version 1. */
+        if (debug)
+            fprintf(stderr, _("Falling back to protocol version 1\n"));
+        close(fd);
+        krb5_auth_con_free(context, auth_context);
+        krb5_free_address(context, sender_addr);
+        krb5_free_address(context, receiver_addr);
+        open_connection(context, slave_host, &fd);
+        (void)kerberos_authenticate(context, &auth_context, fd, my_principal,
+                                    KPROP_PROT_VERSION, &my_creds);
+        xmit_database(context, auth_context, my_creds, fd, database_fd,
+                      database_size);
+    }
     update_last_prop_file(slave_host, file);
     printf(_("Database propagation to %s: SUCCEEDED\n"), slave_host);
     krb5_free_cred_contents(context, my_creds);
@@ -303,9 +327,13 @@ open_connection(krb5_context context, char *host, int *fd_out)
     }
 }
 
-static void
+/* Authenticate to the slave using the protocol version string version.
+ * Return false if the slave does not accept version; exit on any other
+ * error. */
+static krb5_boolean
 kerberos_authenticate(krb5_context context, krb5_auth_context *auth_context,
-                      int fd, krb5_principal me, krb5_creds **new_creds)
+                      int fd, krb5_principal me, char *version,
+                      krb5_creds **new_creds)
 {
     krb5_error_code retval;
     krb5_error *error = NULL;
@@ -325,9 +353,12 @@ kerberos_authenticate(krb5_context context, krb5_auth_context *auth_context,
         exit(1);
     }
 
-    retval = krb5_sendauth(context, auth_context, &fd, kprop_version,
+    retval = krb5_sendauth(context, auth_context, &fd, version,
                            me, creds.server, AP_OPTS_MUTUAL_REQUIRED, NULL,
                            &creds, NULL, &error, &rep_result, new_creds);
+    if (retval == KRB5_SENDAUTH_BADAPPLVERS &&
+        strcmp(version, KPROP_PROT_VERSION) != 0)
+        return FALSE;
     if (retval) {
         com_err(progname, retval, _("while authenticating to server"));
         if (error != NULL) {
@@ -350,6 +381,7 @@ kerberos_authenticate(krb5_context context, krb5_auth_context *auth_context,
         exit(1);
     }
     krb5_free_ap_rep_enc_part(context, rep_result);
+    return TRUE;
 }
 
 /*
@@ -361,7 +393,7 @@ kerberos_authenticate(krb5_context context, krb5_auth_context *auth_context,
  * in the size of the database file.
  */
 static int
-open_database(krb5_context context, char *data_fn, int *size)
+open_database(krb5_context context, char *data_fn, off_t *size)
 {
     struct stat stbuf, stbuf_ok;
     char *data_ok_fn;
@@ -423,6 +455,58 @@ close_database(krb5_context context, int fd)
     close(fd);
 }
 
+/* Read a KRB_SAFE reply from the slave into *data_out, displaying the error
+ * and exiting if the slave sent an error instead. */
+static void
+recv_reply(krb5_context context, krb5_auth_context auth_context, int fd,
+           krb5_data *data_out)
+{
+    krb5_data inbuf;
+    krb5_error_code retval;
+    krb5_error *error;
+
+    retval = krb5_read_message(context, &fd, &inbuf);
+    if (retval) {
+        com_err(progname, retval, _("while reading response from server"));
+        exit(1);
+    }
+    /*
+     * If we got an error response back from the server, display
+     * the error message
+     */
+    if (krb5_is_krb_error(&inbuf)) {
+        retval = krb5_rd_error(context, &inbuf, &error);
+        if (retval) {
+            com_err(progname, retval,
+                    _("while decoding error response from server"));
+            exit(1);
+        }
+        if (error->error == KRB_ERR_GENERIC) {
+            if (error->text.data) {
+                fprintf(stderr, _("Generic remote error: %s\n"),
+                        error->text.data);
+            }
+        } else if (error->error) {
+            com_err(progname,
+                    (krb5_error_code)error->error + ERROR_TABLE_BASE_krb5,
+                    _("signalled from server"));
+            if (error->text.data) {
+                fprintf(stderr, _("Error text from server: %s\n"),
+                        error->text.data);
+            }
+        }
+        krb5_free_error(context, error);
+        exit(1);
+    }
+
+    retval = krb5_rd_safe(context, auth_context, &inbuf, data_out, NULL);
+    if (retval) {
+        com_err(progname, retval, "while decoding response from server");
+        exit(1);
+    }
+    free(inbuf.data);
+}
+
 /*
  * Now we send over the database.  We use the following protocol:
  * Send over a KRB_SAFE message with the size.  Then we send over the
@@ -435,15 +519,19 @@ close_database(krb5_context context, int fd)
 static void
 xmit_database(krb5_context context, krb5_auth_context auth_context,
               krb5_creds *my_creds, int fd, int database_fd,
-              int in_database_size)
+              off_t in_database_size)
 {
     krb5_int32 n;
     krb5_data inbuf, outbuf;
     char buf[KPROP_BUFSIZ];
     krb5_error_code retval;
-    krb5_error *error;
     krb5_ui_4 database_size = in_database_size, send_size, sent_size;
 
+    if ((off_t)database_size != in_database_size) {
+        com_err(progname, EFBIG, _("while sending database size"));
+        exit(1);
+    }
+
     /* Send over the size. */
     send_size = htonl(database_size);
     inbuf.data = (char *)&send_size;
@@ -466,7 +554,7 @@ xmit_database(krb5_context context, krb5_auth_context auth_context,
     krb5_free_data_contents(context, &outbuf);
 
     /* Initialize the initial vector. */
-    retval = krb5_auth_con_initivector(context, auth_context);
+    retval = kprop_init_ivector(context, auth_context);
     if (retval) {
         send_error(context, my_creds, fd,
                    "failed while initializing i_vector", retval);
@@ -514,56 +602,202 @@ xmit_database(krb5_context context, krb5_auth_context auth_context,
      * OK, we've sent the database; now let's wait for a success
      * indication from the remote end.
      */
-    retval = krb5_read_message(context, &fd, &inbuf);
+    recv_reply(context, auth_context, fd, &outbuf);
+    if (outbuf.length != sizeof(send_size)) {
+        com_err(progname, KRB5KRB_ERR_GENERIC,
+                _("while decoding final size packet from server"));
+        exit(1);
+    }
+    memcpy(&send_size, outbuf.data, sizeof(send_size));
+    send_size = ntohl(send_size);
+    if (send_size != database_size) {
+        com_err(progname, 0, _("Kpropd sent database size %d, expecting %d"),
+                send_size, database_size);
+        exit(1);
+    }
+    free(outbuf.data);
+}
+
+/*
+ * Encode up to KPROP_CHUNK_SIZE bytes of database data for protocol version 2
+ * into out, which must have room for KPROP_V2_CHUNK_HDR plus
+ * chunk_bound() bytes.  Use encoding enc if it makes the chunk smaller.
+ * Return the length of the encoded chunk.
+ */
+static size_t
+encode_chunk(const unsigned char *data, size_t len, int enc,
+             unsigned char *out)
+{
+#ifdef HAVE_ZLIB
+    uLongf zlen = compressBound(len);
+
+    if (enc == KPROP_ENC_ZLIB &&
+        compress2(out + KPROP_V2_CHUNK_HDR, &zlen, data, len,
+                  Z_DEFAULT_COMPRESSION) == Z_OK && zlen < len) {
+        out[0] = KPROP_ENC_ZLIB;
+        store_32_be(len, out + 1);
+        return KPROP_V2_CHUNK_HDR + zlen;
+    }
+#endif
+    out[0] = KPROP_ENC_RAW;
+    store_32_be(len, out + 1);
+    memcpy(out + KPROP_V2_CHUNK_HDR, data, len);
+    return KPROP_V2_CHUNK_HDR + len;
+}
+
+/* Return the most space an encoded chunk of len bytes can occupy after its
+ * header. */
+static size_t
+chunk_bound(size_t len)
+{
+#ifdef HAVE_ZLIB
+    return compressBound(len);
+#else
+    return len;
+#endif
+}
+
+/*
+ * Send the database using protocol version 2.  All integers are big-endian.
+ *
+ * Start message (KRB_SAFE, KPROP_V2_START_LEN bytes): the 64-bit database
+ * size, the 32-byte digest computed by kprop_dump_digest(), and a 32-bit
+ * mask of the chunk encodings we can produce.
+ *
+ * Resume reply (KRB_SAFE, KPROP_V2_RESUME_LEN bytes): the 64-bit offset to
+ * start sending from, and the 32-bit mask of encodings the slave accepts.
+ * The offset is nonzero only if the slave holds the leading part of a dump
+ * with the same size and digest from an interrupted transfer.
+ *
+ * Chunks (KRB_PRIV, one per message): a KPROP_V2_CHUNK_HDR byte header
+ * holding the one-byte encoding and the 32-bit length of the chunk's data
+ * after decoding, followed by the encoded data.  Each chunk holds up to
+ * KPROP_CHUNK_SIZE bytes of the database, in order from the resume offset.
+ *
+ * Final reply (KRB_SAFE, 8 bytes): the 64-bit database size, sent once the
+ * slave has checked the digest of the whole received file and loaded the
+ * database.
+ *
+ * Either side may send a KRB_ERROR message instead to abort the transfer.
+ */
+static void
+xmit_database_v2(krb5_context context, krb5_auth_context auth_context,
+                 krb5_creds *my_creds, int fd, int database_fd,
+                 off_t database_size)
+{
+    krb5_error_code retval;
+    krb5_data inbuf, outbuf;
+    unsigned char start[KPROP_V2_START_LEN], *buf, *chunk;
+    uint64_t offset, sent_size;
+    uint32_t encs;
+    ssize_t n;
+    char msg[1024];
+    int enc;
+
+    buf = malloc(KPROP_CHUNK_SIZE);
+    chunk = malloc(KPROP_V2_CHUNK_HDR + chunk_bound(KPROP_CHUNK_SIZE));
+    if (buf == NULL || chunk == NULL) {
+        com_err(progname, ENOMEM, _("while allocating chunk buffer"));
+        exit(1);
+    }
+
+    /* Send over the size and digest of the dump. */
+    store_64_be(database_size, start);
+    retval = kprop_dump_digest(database_fd, buf, start + 8);
     if (retval) {
-        com_err(progname, retval, _("while reading response from server"));
+        com_err(progname, retval, _("while computing database digest"));
         exit(1);
     }
-    /*
-     * If we got an error response back from the server, display
-     * the error message
-     */
-    if (krb5_is_krb_error(&inbuf)) {
-        retval = krb5_rd_error(context, &inbuf, &error);
+    store_32_be(kprop_supported_encodings(), start + 8 + K5_SHA256_HASHLEN);
+    inbuf = make_data(start, sizeof(start));
+    retval = krb5_mk_safe(context, auth_context, &inbuf, &outbuf, NULL);
+    if (retval) {
+        com_err(progname, retval, _("while encoding database size"));
+        send_error(context, my_creds, fd, _("while encoding database size"),
+                   retval);
+        exit(1);
+    }
+    retval = krb5_write_message(context, &fd, &outbuf);
+    krb5_free_data_contents(context, &outbuf);
+    if (retval) {
+        com_err(progname, retval, _("while sending database size"));
+        exit(1);
+    }
+
+    /* Find out where to start and how we may encode the chunks. */
+    recv_reply(context, auth_context, fd, &outbuf);
+    if (outbuf.length != KPROP_V2_RESUME_LEN) {
+        com_err(progname, KRB5KRB_ERR_GENERIC,
+                _("while decoding resume offset from server"));
+        exit(1);
+    }
+    offset = load_64_be(outbuf.data);
+    encs = load_32_be(outbuf.data + 8) & kprop_supported_encodings();
+    krb5_free_data_contents(context, &outbuf);
+    if (offset > (uint64_t)database_size ||
+        lseek(database_fd, offset, SEEK_SET) == (off_t)-1) {
+        com_err(progname, 0, _("Server sent bad resume offset %llu"),
+                (unsigned long long)offset);
+        send_error(context, my_creds, fd, "bad resume offset",
+                   KRB5KRB_ERR_GENERIC);
+        exit(1);
+    }
+    if (debug && offset > 0)
+        printf(_("Resuming at offset %llu.\n"), (unsigned long long)offset);
+    enc = (encs & KPROP_ENC_MASK(KPROP_ENC_ZLIB)) ? KPROP_ENC_ZLIB :
+        KPROP_ENC_RAW;
+
+    retval = kprop_init_ivector(context, auth_context);
+    if (retval) {
+        send_error(context, my_creds, fd,
+                   "failed while initializing i_vector", retval);
+        com_err(progname, retval, _("while allocating i_vector"));
+        exit(1);
+    }
+
+    /* Send the rest of the file, chunk by chunk. */
+    sent_size = offset;
+    while ((n = read(database_fd, buf, KPROP_CHUNK_SIZE)) > 0) {
+        inbuf = make_data(chunk, encode_chunk(buf, n, enc, chunk));
+        retval = krb5_mk_priv(context, auth_context, &inbuf, &outbuf, NULL);
         if (retval) {
-            com_err(progname, retval,
-                    _("while decoding error response from server"));
+            snprintf(msg, sizeof(msg),
+                     "while encoding database chunk starting at %llu",
+                     (unsigned long long)sent_size);
+            com_err(progname, retval, "%s", msg);
+            send_error(context, my_creds, fd, msg, retval);
             exit(1);
         }
-        if (error->error == KRB_ERR_GENERIC) {
-            if (error->text.data) {
-                fprintf(stderr, _("Generic remote error: %s\n"),
-                        error->text.data);
-            }
-        } else if (error->error) {
-            com_err(progname,
-                    (krb5_error_code)error->error + ERROR_TABLE_BASE_krb5,
-                    _("signalled from server"));
-            if (error->text.data) {
-                fprintf(stderr, _("Error text from server: %s\n"),
-                        error->text.data);
-            }
+        retval = krb5_write_message(context, &fd, &outbuf);
+        krb5_free_data_contents(context, &outbuf);
+        if (retval) {
+            com_err(progname, retval,
+                    _("while sending database chunk starting at %llu"),
+                    (unsigned long long)sent_size);
+            exit(1);
         }
-        krb5_free_error(context, error);
-        exit(1);
+        sent_size += n;
+        if (debug)
+            printf("%llu bytes sent.\n", (unsigned long long)sent_size);
     }
-
-    retval = krb5_rd_safe(context,auth_context,&inbuf,&outbuf,NULL);
-    if (retval) {
-        com_err(progname, retval,
-                "while decoding final size packet from server");
+    if (n < 0 || sent_size != (uint64_t)database_size) {
+        com_err(progname, 0, _("Premature EOF found for database file!"));
+        send_error(context, my_creds, fd,
+                   "Premature EOF found for database file!",
+                   KRB5KRB_ERR_GENERIC);
         exit(1);
     }
+    free(buf);
+    free(chunk);
 
-    memcpy(&send_size, outbuf.data, sizeof(send_size));
-    send_size = ntohl(send_size);
-    if (send_size != database_size) {
-        com_err(progname, 0, _("Kpropd sent database size %d, expecting %d"),
-                send_size, database_size);
+    /* Wait for the slave to load the database and confirm the size. */
+    recv_reply(context, auth_context, fd, &outbuf);
+    if (outbuf.length != 8 ||
+        load_64_be(outbuf.data) != (uint64_t)database_size) {
+        com_err(progname, 0, _("Kpropd sent wrong database size"));
         exit(1);
     }
-    free(inbuf.data);
-    free(outbuf.data);
+    krb5_free_data_contents(context, &outbuf);
 }
 
 static void
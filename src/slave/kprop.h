@@ -30,9 +30,25 @@
 #define KPROP_PORT 754
 
 #define KPROP_PROT_VERSION "kprop5_01"
+#define KPROP_PROT_VERSION2 "kprop5_02"
 
 #define KPROP_BUFSIZ 32768
 
+/* Protocol version 2 sends the database in chunks of up to this many bytes
+ * before compression. */
+#define KPROP_CHUNK_SIZE (1024 * 1024)
+
+/* Protocol version 2 chunk encodings, and their bits in the encoding masks
+ * exchanged at the start of the transfer. */
+#define KPROP_ENC_RAW   0
+#define KPROP_ENC_ZLIB  1
+#define KPROP_ENC_MASK(enc) (1U << (enc))
+
+/* Header lengths of the protocol version 2 messages. */
+#define KPROP_V2_START_LEN  44  /* size, digest, encodings */
+#define KPROP_V2_RESUME_LEN 12  /* offset, encodings */
+#define KPROP_V2_CHUNK_HDR  5   /* encoding, decoded length */
+
 /* pathnames are in osconf.h, included via k5-int.h */
 
 int sockaddr2krbaddr(krb5_context context, int family, struct sockaddr *sa,
@@ -41,3 +57,11 @@ int sockaddr2krbaddr(krb5_context context, int family, struct sockaddr *sa,
 krb5_error_code
 sn2princ_realm(krb5_context context, const char *hostname, const char *sname,
                const char *realm, krb5_principal *princ_out);
+
+uint32_t kprop_supported_encodings(void);
+
+krb5_error_code
+kprop_init_ivector(krb5_context context, krb5_auth_context auth_context);
+
+krb5_error_code
+kprop_dump_digest(int fd, unsigned char *buf, uint8_t *digest);
@@ -96,3 +96,56 @@ sn2princ_realm(krb5_context context, const char *hostname, const char *sname,
         (*princ_out)->type = KRB5_NT_SRV_HST;
     return ret;
 }
+
+/*
+ * Initialize the cipher state which chains the KRB_PRIV messages of a
+ * database transfer.  krb5_auth_con_initivector() is deprecated, but kprop
+ * and kpropd must keep using it to interoperate with earlier releases.
+ */
+krb5_error_code
+kprop_init_ivector(krb5_context context, krb5_auth_context auth_context)
+{
+    return krb5_auth_con_initivector(context, auth_context);
+}
+
+/* Return a mask of the protocol version 2 chunk encodings this build can
+ * produce and decode. */
+uint32_t
+kprop_supported_encodings(void)
+{
+#ifdef HAVE_ZLIB
+    return KPROP_ENC_MASK(KPROP_ENC_RAW) | KPROP_ENC_MASK(KPROP_ENC_ZLIB);
+#else
+    return KPROP_ENC_MASK(KPROP_ENC_RAW);
+#endif
+}
+
+/*
+ * Compute the digest which identifies a dump in protocol version 2, reading
+ * the file open on fd from its current offset to the end, using buf (of
+ * KPROP_CHUNK_SIZE bytes) for the reads.  Starting from K5_SHA256_HASHLEN
+ * zero bytes, each KPROP_CHUNK_SIZE block of the file replaces the digest
+ * with the SHA-256 hash of the digest followed by the block's SHA-256 hash.
+ */
+krb5_error_code
+kprop_dump_digest(int fd, unsigned char *buf, uint8_t *digest)
+{
+    krb5_error_code ret;
+    krb5_data d;
+    uint8_t state[2 * K5_SHA256_HASHLEN];
+    ssize_t n;
+
+    memset(digest, 0, K5_SHA256_HASHLEN);
+    while ((n = read(fd, buf, KPROP_CHUNK_SIZE)) > 0) {
+        memcpy(state, digest, K5_SHA256_HASHLEN);
+        d = make_data(buf, n);
+        ret = k5_sha256(&d, state + K5_SHA256_HASHLEN);
+        if (ret)
+            return ret;
+        d = make_data(state, sizeof(state));
+        ret = k5_sha256(&d, digest);
+        if (ret)
+            return ret;
+    }
+    return (n < 0) ? errno : 0;
+}
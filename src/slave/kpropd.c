@@ -65,11 +65,15 @@
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/param.h>
 #include <netdb.h>
 #include <syslog.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "kprop.h"
 #include <iprop_hdr.h>
@@ -110,7 +114,8 @@ typedef struct _kadm5_iprop_handle_t {
     struct _kadm5_iprop_handle_t *lhandle;
 } *kadm5_iprop_handle_t;
 
-static char *kprop_version = KPROP_PROT_VERSION;
+/* The kprop protocol version used by the connected client (1 or 2). */
+static int kprop_protocol;
 
 static kadm5_config_params params;
 
@@ -130,6 +135,7 @@ static char *realm = NULL;      /* Our realm */
 static char *def_realm = NULL;  /* Ref pointer for default realm */
 static char *file = KPROPD_DEFAULT_FILE;
 static char *temp_file_name;
+static char *resume_file_name;
 static char *kdb5_util = KPROPD_DEFAULT_KDB5_UTIL;
 static char *kerb_database = NULL;
 static char *acl_file_name = KPROPD_ACL_FILE;
@@ -151,6 +157,8 @@ static void kerberos_authenticate(krb5_context context, int fd,
 static krb5_boolean authorized_principal(krb5_context context,
                                          krb5_principal p,
                                          krb5_enctype auth_etype);
+static void recv_database_v2(krb5_context context, int fd,
+                             krb5_data *confmsg);
 static void recv_database(krb5_context context, int fd, int database_fd,
                           krb5_data *confmsg);
 static void load_database(krb5_context context, char *kdb_util,
@@ -332,16 +340,16 @@ main(int argc, char **argv)
     exit(1);
 }
 
-/* Use getaddrinfo to determine a wildcard listener address, preferring
- * IPv6 if available. */
+/* Use getaddrinfo to determine a wildcard listener address of the given
+ * socket type, preferring IPv6 if available. */
 static int
-get_wildcard_addr(struct addrinfo **res)
+get_wildcard_addr(int socktype, struct addrinfo **res)
 {
     struct addrinfo hints;
     int error;
 
     memset(&hints, 0, sizeof(hints));
-    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_socktype = socktype;
     hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG;
     hints.ai_family = AF_INET6;
     error = getaddrinfo(NULL, port, &hints, res);
@@ -361,7 +369,7 @@ do_standalone()
     pid_t child_pid;
     pid_t wait_pid;
 
-    error = get_wildcard_addr(&res);
+    error = get_wildcard_addr(SOCK_STREAM, &res);
     if (error != 0) {
         fprintf(stderr, _("getaddrinfo: %s\n"), gai_strerror(error));
         exit(1);
@@ -530,13 +538,20 @@ doit(int fd)
                 temp_file_name);
         exit(1);
     }
-    database_fd = open(temp_file_name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-    if (database_fd < 0) {
-        com_err(progname, errno, _("while opening database file, '%s'"),
-                temp_file_name);
-        exit(1);
+    if (kprop_protocol == 2) {
+        recv_database_v2(kpropd_context, fd, &confmsg);
+    } else {
+        /* A version 1 transfer replaces any partial version 2 transfer. */
+        (void)unlink(resume_file_name);
+        database_fd = open(temp_file_name, O_WRONLY | O_CREAT | O_TRUNC,
+                           0600);
+        if (database_fd < 0) {
+            com_err(progname, errno, _("while opening database file, '%s'"),
+                    temp_file_name);
+            exit(1);
+        }
+        recv_database(kpropd_context, fd, database_fd, &confmsg);
     }
-    recv_database(kpropd_context, fd, database_fd, &confmsg);
     if (rename(temp_file_name, file)) {
         com_err(progname, errno, _("while renaming %s to %s"),
                 temp_file_name, file);
@@ -601,6 +616,110 @@ full_resync(CLIENT *clnt)
     return (status == RPC_SUCCESS) ? &clnt_res : NULL;
 }
 
+/* Minimum interval in milliseconds between the start of one poll and a poll
+ * prompted by an update notification. */
+#define NOTIFY_MIN_INTERVAL 1000
+
+/*
+ * Open a datagram socket on the kprop port, on which kadmind announces new
+ * updates to slaves which have polled it.  Return -1 if the socket cannot be
+ * opened; we then rely on the poll interval alone.
+ */
+static int
+open_notify_socket(void)
+{
+    struct addrinfo *res;
+    int fd, error, val;
+
+    error = get_wildcard_addr(SOCK_DGRAM, &res);
+    if (error != 0) {
+        syslog(LOG_WARNING, _("getaddrinfo: %s"), gai_strerror(error));
+        return -1;
+    }
+
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        com_err(progname, errno, _("while obtaining notification socket"));
+        freeaddrinfo(res);
+        return -1;
+    }
+
+#if defined(IPV6_V6ONLY)
+    val = 0;
+    if (res->ai_family == AF_INET6)
+        (void)setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &val, sizeof(val));
+#endif
+
+    if (bind(fd, res->ai_addr, res->ai_addrlen) < 0) {
+        com_err(progname, errno, _("while binding notification socket"));
+        close(fd);
+        freeaddrinfo(res);
+        return -1;
+    }
+    set_cloexec_fd(fd);
+    freeaddrinfo(res);
+    return fd;
+}
+
+/* Return the current time in milliseconds. */
+static int64_t
+now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*
+ * Wait up to secs seconds, or until fd receives a notification from kadmind
+ * of an update past last_sno.  A notification ends the wait no sooner than
+ * NOTIFY_MIN_INTERVAL after the previous poll started at poll_start, so that
+ * a burst of updates produces few polls.  SIGUSR1 also ends the wait.
+ */
+static void
+wait_for_updates(int fd, unsigned int secs, int64_t poll_start,
+                 kdb_sno_t last_sno)
+{
+    unsigned char buf[IPROP_NOTIFY_LEN];
+    struct pollfd pfd;
+    int64_t deadline, earliest, now;
+    ssize_t len;
+    int ret;
+
+    if (fd == -1) {
+        sleep(secs);
+        return;
+    }
+
+    deadline = now_ms() + (int64_t)secs * 1000;
+    earliest = poll_start + NOTIFY_MIN_INTERVAL;
+    for (;;) {
+        now = now_ms();
+        if (now >= deadline)
+            return;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        ret = poll(&pfd, 1, deadline - now);
+        if (ret < 0 && errno != EINTR)
+            sleep((deadline - now + 999) / 1000);
+        if (ret <= 0)
+            return;
+
+        len = recv(fd, buf, sizeof(buf), 0);
+        if (len != IPROP_NOTIFY_LEN ||
+            load_32_be(buf) != IPROP_NOTIFY_MAGIC ||
+            load_32_be(buf + 4) == last_sno)
+            continue;
+        if (debug) {
+            fprintf(stderr, _("Update notification received (sno=%u)\n"),
+                    (unsigned int)load_32_be(buf + 4));
+        }
+        if (earliest < deadline)
+            deadline = earliest;
+    }
+}
+
 /*
  * Beg for incrementals from the KDC.
  *
@@ -615,7 +734,7 @@ do_iprop()
     void *server_handle = NULL;
     char *iprop_svc_princstr = NULL, *master_svc_princstr = NULL;
     unsigned int pollin, backoff_time;
-    int backoff_cnt = 0, reinit_cnt = 0;
+    int backoff_cnt = 0, reinit_cnt = 0, notify_fd;
     struct timeval iprop_start, iprop_end;
     unsigned long usec;
     time_t frrequested = 0, now;
@@ -631,6 +750,8 @@ do_iprop()
     if (pollin == 0)
         pollin = 10;
 
+    notify_fd = open_notify_socket();
+
     if (master_svc_princstr == NULL) {
         retval = kadm5_get_kiprop_host_srv_name(kpropd_context, realm,
                                                 &master_svc_princstr);
@@ -957,7 +1078,11 @@ reinit:
                 fprintf(stderr, _("Waiting for %d seconds before checking "
                                   "for updates again\n"), pollin);
             }
-            sleep(pollin);
+            if (ulog_get_last(kpropd_context, &mylast) != 0)
+                mylast.last_sno = 0;
+            wait_for_updates(notify_fd, pollin,
+                             (int64_t)iprop_start.tv_sec * 1000 +
+                             iprop_start.tv_usec / 1000, mylast.last_sno);
         }
 
     }
@@ -968,6 +1093,8 @@ error:
         fprintf(stderr, _("ERROR returned by master, bailing\n"));
     syslog(LOG_ERR, _("ERROR returned by master KDC, bailing.\n"));
 done:
+    if (notify_fd != -1)
+        close(notify_fd);
     free(iprop_svc_princstr);
     free(master_svc_princstr);
     krb5_free_default_realm(kpropd_context, def_realm);
@@ -1156,8 +1283,9 @@ parse_args(char **argv)
         exit(1);
     }
 
-    /* Construct the name of the temporary file. */
-    if (asprintf(&temp_file_name, "%s.temp", file) < 0) {
+    /* Construct the names of the temporary file and its resume record. */
+    if (asprintf(&temp_file_name, "%s.temp", file) < 0 ||
+        asprintf(&resume_file_name, "%s.resume", temp_file_name) < 0) {
         com_err(progname, ENOMEM,
                 _("while allocating filename for temp file"));
         exit(1);
@@ -1193,6 +1321,7 @@ kerberos_authenticate(krb5_context context, int fd, krb5_principal *clientp,
     struct sockaddr_storage r_sin;
     GETSOCKNAME_ARG3_TYPE sin_length;
     krb5_keytab keytab = NULL;
+    krb5_data version;
     char *name, etypebuf[100];
 
     /* Set recv_addr and send_addr. */
@@ -1214,8 +1343,7 @@ kerberos_authenticate(krb5_context context, int fd, krb5_principal *clientp,
             com_err(progname, retval, _("while unparsing client name"));
             exit(1);
         }
-        fprintf(stderr, "krb5_recvauth(%d, %s, %s, ...)\n", fd, kprop_version,
-                name);
+        fprintf(stderr, "krb5_recvauth(%d, %s, ...)\n", fd, name);
         free(name);
     }
 
@@ -1251,14 +1379,28 @@ kerberos_authenticate(krb5_context context, int fd, krb5_principal *clientp,
         }
     }
 
-    retval = krb5_recvauth(context, &auth_context, &fd, kprop_version, server,
-                           0, keytab, &ticket);
+    retval = krb5_recvauth_version(context, &auth_context, &fd, server, 0,
+                                   keytab, &ticket, &version);
     if (retval) {
         syslog(LOG_ERR, _("Error in krb5_recvauth: %s"),
                error_message(retval));
         exit(1);
     }
 
+    /* The version string is sent with its terminator. */
+    if (version.length == sizeof(KPROP_PROT_VERSION2) &&
+        memcmp(version.data, KPROP_PROT_VERSION2, version.length) == 0) {
+        kprop_protocol = 2;
+    } else if (version.length == sizeof(KPROP_PROT_VERSION) &&
+               memcmp(version.data, KPROP_PROT_VERSION,
+                      version.length) == 0) {
+        kprop_protocol = 1;
+    } else {
+        syslog(LOG_ERR, _("Unknown kprop protocol version"));
+        exit(1);
+    }
+    krb5_free_data_contents(context, &version);
+
     retval = krb5_copy_principal(context, ticket->enc_part2->client, clientp);
     if (retval) {
         syslog(LOG_ERR, _("Error in krb5_copy_prinicpal: %s"),
@@ -1379,7 +1521,7 @@ recv_database(krb5_context context, int fd, int database_fd,
     database_size = ntohl(database_size);
 
     /* Initialize the initial vector. */
-    retval = krb5_auth_con_initivector(context, auth_context);
+    retval = kprop_init_ivector(context, auth_context);
     if (retval) {
         send_error(context, fd, retval,
                    "failed while initializing i_vector");
@@ -1456,6 +1598,230 @@ recv_database(krb5_context context, int fd, int database_fd,
     }
 }
 
+/* Report a failure to receive the database to the client and exit. */
+static void
+recv_fail(krb5_context context, int fd, krb5_error_code retval,
+          const char *msg)
+{
+    com_err(progname, retval, "%s", msg);
+    send_error(context, fd, retval, (char *)msg);
+    exit(1);
+}
+
+/* Write the len bytes at data to database_fd, or fail. */
+static void
+write_chunk(krb5_context context, int fd, int database_fd, const void *data,
+            size_t len, uint64_t offset)
+{
+    char buf[1024];
+    ssize_t n;
+
+    n = write(database_fd, data, len);
+    if (n < 0 || (size_t)n != len) {
+        snprintf(buf, sizeof(buf),
+                 "while writing database chunk starting at offset %llu",
+                 (unsigned long long)offset);
+        recv_fail(context, fd, (n < 0) ? errno : KRB5KRB_ERR_GENERIC, buf);
+    }
+}
+
+/*
+ * Receive the database using protocol version 2 (described in kprop.c).  If
+ * the temporary file holds part of the same dump from an interrupted
+ * transfer, as recorded by size and digest in a ".resume" file next to it,
+ * ask the client to resume after that part.
+ */
+static void
+recv_database_v2(krb5_context context, int fd, krb5_data *confmsg)
+{
+    krb5_error_code retval;
+    krb5_data inbuf, outbuf;
+    unsigned char resume[KPROP_V2_RESUME_LEN], final[8], *buf, *p;
+    uint64_t database_size, offset = 0, received_size, len;
+    unsigned long long rsize;
+    uint32_t encs;
+    char msg[1024], digest[2 * K5_SHA256_HASHLEN + 1];
+    char rdigest[2 * K5_SHA256_HASHLEN + 1];
+    uint8_t sent_digest[K5_SHA256_HASHLEN], file_digest[K5_SHA256_HASHLEN];
+    struct stat st;
+    FILE *fp;
+    int database_fd, enc, i;
+#ifdef HAVE_ZLIB
+    uLongf zlen;
+#endif
+
+    /* Receive and decode the size and digest of the dump. */
+    retval = krb5_read_message(context, &fd, &inbuf);
+    if (retval)
+        recv_fail(context, fd, retval, "while reading database size");
+    if (krb5_is_krb_error(&inbuf))
+        recv_error(context, &inbuf);
+    retval = krb5_rd_safe(context, auth_context, &inbuf, &outbuf, NULL);
+    krb5_free_data_contents(context, &inbuf);
+    if (retval)
+        recv_fail(context, fd, retval, "while decoding database size");
+    if (outbuf.length != KPROP_V2_START_LEN) {
+        recv_fail(context, fd, KRB5KRB_ERR_GENERIC,
+                  "while decoding database size");
+    }
+    p = (unsigned char *)outbuf.data;
+    database_size = load_64_be(p);
+    memcpy(sent_digest, p + 8, K5_SHA256_HASHLEN);
+    for (i = 0; i < K5_SHA256_HASHLEN; i++)
+        snprintf(digest + 2 * i, 3, "%02x", p[8 + i]);
+    encs = load_32_be(p + 8 + K5_SHA256_HASHLEN) &
+        kprop_supported_encodings();
+    krb5_free_data_contents(context, &outbuf);
+
+    /* Look for a partial transfer of the same dump. */
+    fp = fopen(resume_file_name, "r");
+    if (fp != NULL) {
+        if (fscanf(fp, "%llu %64s", &rsize, rdigest) == 2 &&
+            rsize == database_size && strcmp(rdigest, digest) == 0 &&
+            stat(temp_file_name, &st) == 0 &&
+            (uint64_t)st.st_size <= database_size)
+            offset = st.st_size;
+        fclose(fp);
+    }
+
+    database_fd = open(temp_file_name, O_WRONLY | O_CREAT, 0600);
+    if (database_fd < 0 || ftruncate(database_fd, offset) != 0 ||
+        lseek(database_fd, offset, SEEK_SET) == (off_t)-1) {
+        snprintf(msg, sizeof(msg), "while opening database file, '%s'",
+                 temp_file_name);
+        recv_fail(context, fd, errno, msg);
+    }
+
+    /* Record which dump the temporary file holds, once it is empty. */
+    if (offset == 0) {
+        fp = fopen(resume_file_name, "w");
+        if (fp != NULL) {
+            fprintf(fp, "%llu %s\n", (unsigned long long)database_size,
+                    digest);
+            if (fclose(fp) != 0)
+                (void)unlink(resume_file_name);
+        }
+    }
+    if (debug && offset > 0) {
+        fprintf(stderr, _("Resuming full propagation at offset %llu.\n"),
+                (unsigned long long)offset);
+    }
+
+    /* Tell the client where to start and which encodings to use. */
+    store_64_be(offset, resume);
+    store_32_be(encs, resume + 8);
+    inbuf = make_data(resume, sizeof(resume));
+    retval = krb5_mk_safe(context, auth_context, &inbuf, &outbuf, NULL);
+    if (retval)
+        recv_fail(context, fd, retval, "while encoding resume offset");
+    retval = krb5_write_message(context, &fd, &outbuf);
+    krb5_free_data_contents(context, &outbuf);
+    if (retval) {
+        com_err(progname, retval, _("while sending resume offset"));
+        exit(1);
+    }
+
+    retval = kprop_init_ivector(context, auth_context);
+    if (retval)
+        recv_fail(context, fd, retval, "failed while initializing i_vector");
+
+    if (debug)
+        fprintf(stderr, _("Full propagation transfer started.\n"));
+
+    buf = malloc(KPROP_CHUNK_SIZE);
+    if (buf == NULL)
+        recv_fail(context, fd, ENOMEM, "while allocating chunk buffer");
+    received_size = offset;
+    while (received_size < database_size) {
+        retval = krb5_read_message(context, &fd, &inbuf);
+        if (retval) {
+            snprintf(msg, sizeof(msg),
+                     "while reading database chunk starting at offset %llu",
+                     (unsigned long long)received_size);
+            recv_fail(context, fd, retval, msg);
+        }
+        if (krb5_is_krb_error(&inbuf))
+            recv_error(context, &inbuf);
+        retval = krb5_rd_priv(context, auth_context, &inbuf, &outbuf, NULL);
+        krb5_free_data_contents(context, &inbuf);
+        if (retval) {
+            snprintf(msg, sizeof(msg),
+                     "while decoding database chunk starting at offset %llu",
+                     (unsigned long long)received_size);
+            recv_fail(context, fd, retval, msg);
+        }
+
+        p = (unsigned char *)outbuf.data;
+        enc = (outbuf.length >= KPROP_V2_CHUNK_HDR) ? p[0] : -1;
+        len = (enc >= 0) ? load_32_be(p + 1) : 0;
+        if (enc < 0 || !(encs & KPROP_ENC_MASK(enc)) || len == 0 ||
+            len > KPROP_CHUNK_SIZE || len > database_size - received_size) {
+            snprintf(msg, sizeof(msg),
+                     "invalid database chunk starting at offset %llu",
+                     (unsigned long long)received_size);
+            recv_fail(context, fd, KRB5KRB_ERR_GENERIC, msg);
+        }
+        p += KPROP_V2_CHUNK_HDR;
+        if (enc == KPROP_ENC_RAW &&
+            outbuf.length - KPROP_V2_CHUNK_HDR == len) {
+            write_chunk(context, fd, database_fd, p, len, received_size);
+#ifdef HAVE_ZLIB
+        } else if (enc == KPROP_ENC_ZLIB &&
+                   (zlen = len,
+                    uncompress(buf, &zlen, p,
+                               outbuf.length - KPROP_V2_CHUNK_HDR) == Z_OK) &&
+                   zlen == len) {
+            write_chunk(context, fd, database_fd, buf, len, received_size);
+#endif
+        } else {
+            snprintf(msg, sizeof(msg),
+                     "while decoding database chunk starting at offset %llu",
+                     (unsigned long long)received_size);
+            recv_fail(context, fd, KRB5KRB_ERR_GENERIC, msg);
+        }
+        krb5_free_data_contents(context, &outbuf);
+        received_size += len;
+    }
+
+    if (fsync(database_fd) != 0 || close(database_fd) != 0)
+        recv_fail(context, fd, errno, "while writing database file");
+
+    /*
+     * Check the whole file against the digest from the start message.  A
+     * resumed transfer trusts the file's length, which may include data lost
+     * in a crash before the earlier transfer was synced.
+     */
+    database_fd = open(temp_file_name, O_RDONLY);
+    if (database_fd < 0) {
+        snprintf(msg, sizeof(msg), "while opening database file, '%s'",
+                 temp_file_name);
+        recv_fail(context, fd, errno, msg);
+    }
+    retval = kprop_dump_digest(database_fd, buf, file_digest);
+    close(database_fd);
+    free(buf);
+    if (retval)
+        recv_fail(context, fd, retval, "while computing database digest");
+
+    /* The transfer is complete, so the next one must start over. */
+    (void)unlink(resume_file_name);
+    if (memcmp(file_digest, sent_digest, K5_SHA256_HASHLEN) != 0) {
+        (void)unlink(temp_file_name);
+        recv_fail(context, fd, KRB5KRB_ERR_GENERIC,
+                  "received database does not match its digest");
+    }
+
+    if (debug)
+        fprintf(stderr, _("Full propagation transfer finished.\n"));
+
+    /* Create message acknowledging the database size, but don't send it until
+     * kdb5_util returns successfully. */
+    store_64_be(database_size, final);
+    inbuf = make_data(final, sizeof(final));
+    retval = krb5_mk_safe(context, auth_context, &inbuf, confmsg, NULL);
+    if (retval)
+        recv_fail(context, fd, retval, "while encoding # of received bytes");
+}
 
 static void
 send_error(krb5_context context, int fd, krb5_error_code err_code,
@@ -330,8 +330,8 @@ print_attr(kdbe_val_t *val, int vverbose)
  * Print the update entry information
  */
 static void
-print_update(kdb_hlog_t *ulog, uint32_t entry, uint32_t ulogentries,
-             unsigned int verbose)
+print_update(kdb_hlog_t *ulog, size_t mapsize, uint32_t entry,
+             uint32_t ulogentries, unsigned int verbose)
 {
     XDR xdrs;
     uint32_t start_sno, i, j, indx;
@@ -347,12 +347,18 @@ print_update(kdb_hlog_t *ulog, uint32_t entry, uint32_t ulogentries,
     for (i = start_sno; i < ulog->kdb_last_sno; i++) {
         indx = i % ulogentries;
 
-        indx_log = INDEX(ulog, indx);
-
         /*
          * Check for corrupt update entry
          */
-        if (indx_log->kdb_umagic != KDB_ULOG_MAGIC) {
+        if (ULOG_OFFSETS(ulog)[indx] < ulog->kdb_data_off ||
+            ULOG_OFFSETS(ulog)[indx] > mapsize - sizeof(kdb_ent_header_t)) {
+            fprintf(stderr, _("Corrupt update entry\n\n"));
+            exit(1);
+        }
+        indx_log = INDEX(ulog, indx);
+        if (indx_log->kdb_umagic != KDB_ULOG_MAGIC ||
+            indx_log->kdb_entry_size > mapsize - ULOG_OFFSETS(ulog)[indx] -
+            sizeof(kdb_ent_header_t)) {
             fprintf(stderr, _("Corrupt update entry\n\n"));
             exit(1);
         }
@@ -415,10 +421,10 @@ print_update(kdb_hlog_t *ulog, uint32_t entry, uint32_t ulogentries,
     }
 }
 
-/* Return a read-only mmap of the ulog, or NULL on failure.  Assumes fd is
- * released on process exit. */
+/* Return a read-only mmap of the ulog and its size, or NULL on failure.
+ * Assumes fd is released on process exit. */
 static kdb_hlog_t *
-map_ulog(const char *filename)
+map_ulog(const char *filename, size_t *size_out)
 {
     int fd;
     struct stat st;
@@ -427,10 +433,13 @@ map_ulog(const char *filename)
     fd = open(filename, O_RDONLY);
     if (fd == -1)
         return NULL;
-    if (fstat(fd, &st) < 0)
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(kdb_hlog_t))
         return NULL;
     ulog = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    return (ulog == MAP_FAILED) ? NULL : ulog;
+    if (ulog == MAP_FAILED)
+        return NULL;
+    *size_out = st.st_size;
+    return ulog;
 }
 
 int
@@ -443,6 +452,7 @@ main(int argc, char **argv)
     krb5_context context;
     kadm5_config_params params;
     kdb_hlog_t *ulog = NULL;
+    size_t mapsize;
 
     setlocale(LC_ALL, "");
 
@@ -496,7 +506,10 @@ main(int argc, char **argv)
         exit(0);
     }
 
-    ulog = map_ulog(params.iprop_logfile);
+    /* Map the log read-only rather than with ulog_map(), which would
+     * reinitialize a log in another format or layout instead of letting us
+     * report it. */
+    ulog = map_ulog(params.iprop_logfile, &mapsize);
     if (ulog == NULL) {
         fprintf(stderr, _("Unable to map log file %s\n\n"),
                 params.iprop_logfile);
@@ -508,6 +521,26 @@ main(int argc, char **argv)
         exit(1);
     }
 
+    if (ulog->db_version_num != KDB_VERSION) {
+        fprintf(stderr, _("Unsupported update log version %u, exiting\n\n"),
+                ulog->db_version_num);
+        exit(1);
+    }
+
+    /* The index has one slot per entry, so the data area moves if
+     * iprop_master_ulogsize changes. */
+    if (ulog->kdb_data_off != ULOG_DATA_OFFSET(params.iprop_ulogsize)) {
+        fprintf(stderr, _("Update log was not written with "
+                          "iprop_master_ulogsize %u, exiting\n\n"),
+                params.iprop_ulogsize);
+        exit(1);
+    }
+    if (ulog->kdb_data_off > mapsize ||
+        ulog->kdb_data_size > mapsize - ulog->kdb_data_off) {
+        fprintf(stderr, _("Corrupt header log, exiting\n\n"));
+        exit(1);
+    }
+
     printf(_("Update log dump :\n"));
     printf(_("\tLog version # : %u\n"), ulog->db_version_num);
     printf(_("\tLog state : "));
@@ -525,7 +558,7 @@ main(int argc, char **argv)
         printf(_("Unknown state: %d\n"), ulog->kdb_state);
         break;
     }
-    printf(_("\tEntry block size : %u\n"), ulog->kdb_block);
+    printf(_("\tData area size : %u\n"), ulog->kdb_data_size);
     printf(_("\tNumber of entries : %u\n"), ulog->kdb_num);
 
     if (ulog->kdb_last_sno == 0) {
@@ -557,7 +590,7 @@ main(int argc, char **argv)
     }
 
     if (!headeronly && ulog->kdb_num)
-        print_update(ulog, entry, params.iprop_ulogsize, verbose);
+        print_update(ulog, mapsize, entry, params.iprop_ulogsize, verbose);
 
     printf("\n");
 
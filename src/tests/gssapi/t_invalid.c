@@ -130,7 +130,8 @@ make_fake_cfx_context()
         abort();
     kgctx->established = 1;
     kgctx->proto = 1;
-    if (g_seqstate_init(&kgctx->seqstate, 0, 0, 0, 0) != 0)
+    if (g_seqstate_init(&kgctx->seqstate, 0, 0, 0, 0,
+                        G_SEQSTATE_DEFAULT_WINDOW) != 0)
         abort();
     kgctx->mech_used = &mech_krb5;
     kgctx->sealalg = -1;
@@ -164,7 +165,8 @@ make_fake_context(const struct test *test)
     if (kgctx == NULL)
         abort();
     kgctx->established = 1;
-    if (g_seqstate_init(&kgctx->seqstate, 0, 0, 0, 0) != 0)
+    if (g_seqstate_init(&kgctx->seqstate, 0, 0, 0, 0,
+                        G_SEQSTATE_DEFAULT_WINDOW) != 0)
         abort();
     kgctx->mech_used = &mech_krb5;
     kgctx->sealalg = test->sealalg;
@@ -196,6 +196,84 @@ test_standard_wrap(gss_ctx_id_t ctx1, gss_ctx_id_t ctx2, int conf)
     (void)gss_release_iov_buffer(&minor, stiov, 2);
 }
 
+/* Wrap three messages in one batch call using ctx1 and unwrap them in one
+ * batch call using ctx2, first intact and then with the second message's
+ * trailer corrupted. */
+static void
+test_batch(gss_ctx_id_t ctx1, gss_ctx_id_t ctx2, int conf)
+{
+    OM_uint32 major, minor;
+    gss_iov_buffer_desc iov[3][4];
+    gss_iov_msg_desc msgs[3];
+    const char *strings[3] = { "First batch message", "Second message",
+                              "Third and last message" };
+    char data[3][64];
+    unsigned char *trailer;
+    int i, pass;
+
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < 3; i++) {
+            memcpy(data[i], strings[i], strlen(strings[i]) + 1);
+            iov[i][0].type = GSS_IOV_BUFFER_TYPE_HEADER |
+                GSS_IOV_BUFFER_FLAG_ALLOCATE;
+            iov[i][1].type = GSS_IOV_BUFFER_TYPE_DATA;
+            iov[i][1].buffer.value = data[i];
+            iov[i][1].buffer.length = strlen(strings[i]);
+            iov[i][2].type = GSS_IOV_BUFFER_TYPE_PADDING |
+                GSS_IOV_BUFFER_FLAG_ALLOCATE;
+            iov[i][3].type = GSS_IOV_BUFFER_TYPE_TRAILER |
+                GSS_IOV_BUFFER_FLAG_ALLOCATE;
+            msgs[i].iov = iov[i];
+            msgs[i].iov_count = 4;
+        }
+
+        major = gss_wrap_iov_batch(&minor, ctx1, conf, GSS_C_QOP_DEFAULT,
+                                   msgs, 3);
+        check_gsserr("gss_wrap_iov_batch", major, minor);
+        for (i = 0; i < 3; i++) {
+            check_gsserr("gss_wrap_iov_batch(msg)", msgs[i].major_status,
+                         msgs[i].minor_status);
+            if (msgs[i].conf_state != conf)
+                errout("gss_wrap_iov_batch conf");
+            check_encrypted("gss_wrap_iov_batch encryption", conf, data[i],
+                            strings[i]);
+        }
+
+        if (pass == 1) {
+            /* Corrupt the last byte of the second token's checksum. */
+            trailer = iov[1][3].buffer.value;
+            if (iov[1][3].buffer.length == 0)
+                trailer = iov[1][0].buffer.value;
+            else
+                trailer += iov[1][3].buffer.length - 1;
+            *trailer ^= 0xFF;
+        }
+
+        major = gss_unwrap_iov_batch(&minor, ctx2, msgs, 3);
+        if (pass == 0) {
+            check_gsserr("gss_unwrap_iov_batch", major, minor);
+        } else if (major != msgs[1].major_status ||
+                   !GSS_ERROR(msgs[1].major_status)) {
+            errout("gss_unwrap_iov_batch(corrupt) status");
+        }
+        for (i = 0; i < 3; i++) {
+            if (pass == 1 && i == 1)
+                continue;
+            check_gsserr("gss_unwrap_iov_batch(msg)", msgs[i].major_status,
+                         msgs[i].minor_status);
+            if (msgs[i].conf_state != conf ||
+                msgs[i].qop_state != GSS_C_QOP_DEFAULT)
+                errout("gss_unwrap_iov_batch conf/qop");
+            if (iov[i][1].buffer.length != strlen(strings[i]) ||
+                memcmp(data[i], strings[i], strlen(strings[i])) != 0)
+                errout("gss_unwrap_iov_batch decryption");
+        }
+
+        for (i = 0; i < 3; i++)
+            (void)gss_release_iov_buffer(&minor, iov[i], 4);
+    }
+}
+
 /*
  * Wrap an AEAD token (HEADER | SIGN_ONLY | DATA | PADDING | TRAILER) using the
  * caller-provided array iov, which must have space for five elements, and the
@@ -519,6 +597,12 @@ main(int argc, char *argv[])
     test_standard_wrap(actx, ictx, 0);
     test_standard_wrap(actx, ictx, 1);
 
+    /* Test batch wrapping and unwrapping. */
+    test_batch(ictx, actx, 0);
+    test_batch(ictx, actx, 1);
+    test_batch(actx, ictx, 0);
+    test_batch(actx, ictx, 1);
+
     /* Test AEAD wrapping. */
     test_aead(ictx, actx, 0);
     test_aead(ictx, actx, 1);
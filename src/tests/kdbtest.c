@@ -390,6 +390,21 @@ main()
     count = 0;
     CHECK(krb5_db_iterate(ctx, "xy*", iter_princ_handler, &count, 0));
     CHECK_COND(count == 1);
+    count = 0;
+    CHECK(krb5_db_iterate(ctx, "xy*(z)", iter_princ_handler, &count,
+                          KRB5_DB_ITER_NAMES_ONLY));
+    CHECK_COND(count == 1);
+    count = 0;
+    CHECK(krb5_db_iterate(ctx, "xz*", iter_princ_handler, &count, 0));
+    CHECK_COND(count == 0);
+    /* Quoted metacharacters are part of the literal prefix. */
+    count = 0;
+    CHECK(krb5_db_iterate(ctx, "xy\\**", iter_princ_handler, &count, 0));
+    CHECK_COND(count == 1);
+    count = 0;
+    CHECK(krb5_db_iterate(ctx, "x\\y\\*(*", iter_princ_handler, &count,
+                          KRB5_DB_ITER_PREFIX));
+    CHECK_COND(count == 1);
 
     CHECK(krb5_db_fini(ctx));
     CHECK_COND(krb5_db_inited(ctx) != 0);
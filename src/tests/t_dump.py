@@ -107,4 +107,99 @@ out = realm.run([kadminl, 'getprinc', 'user'])
 if 'Policy: testpol' not in out:
     fail('Loading ov dump did not add user policy reference')
 
+# Dump in binary format, serially and with parallel workers, and check
+# that loading each binary dump reproduces the same database.  The
+# records of a parallel dump are in a different order, but there
+# should be exactly as many of them, so the dumps have the same size.
+refdump = os.path.join(realm.testdir, 'dump.ref')
+bindump = os.path.join(realm.testdir, 'dump.bin')
+realm.run([kdb5_util, 'dump', refdump])
+binsizes = []
+for opt in ([], ['-j', '3']):
+    realm.run([kdb5_util, 'dump', '-binary'] + opt + [bindump])
+    binsizes.append(os.stat(bindump).st_size)
+    realm.run([kdb5_util, 'destroy', '-f'])
+    realm.run([kdb5_util, 'load', bindump])
+    dump_compare(realm, [], refdump)
+if binsizes[0] != binsizes[1]:
+    fail('Parallel binary dump size differs from serial dump')
+
+# Stream a binary dump through standard output and input.
+out = realm.run([kdb5_util, 'dump', '-binary', '-j', '2'])
+realm.run([kdb5_util, 'load', '-'], input=out)
+dump_compare(realm, [], refdump)
+
+# Check that corrupted and truncated binary dumps are rejected.
+f = open(bindump, 'rb')
+bindata = f.read()
+f.close()
+baddump = os.path.join(realm.testdir, 'dump.bad')
+pos = len(bindata) // 2
+f = open(baddump, 'wb')
+f.write(bindata[:pos] + chr(ord(bindata[pos]) ^ 1) + bindata[pos + 1:])
+f.close()
+out = realm.run([kdb5_util, 'load', baddump], expected_code=1)
+if 'checksum mismatch' not in out:
+    fail('Corrupted binary dump not detected')
+f = open(baddump, 'wb')
+f.write(bindata[:-9])
+f.close()
+out = realm.run([kdb5_util, 'load', baddump], expected_code=1)
+if 'end record' not in out:
+    fail('Truncated binary dump not detected')
+dump_compare(realm, [], refdump)
+
+# A hash-format database cannot be iterated by name prefix, so a
+# parallel dump would read the whole database once per leading byte.
+# Check that -j is refused there.
+realm.run([kdb5_util, 'destroy', '-f'])
+realm.run([kdb5_util, '-x', 'hash=true', 'load', srcdump])
+out = realm.run([kdb5_util, 'dump', '-binary', '-j', '2', bindump],
+                expected_code=1)
+if 'not supported for hash databases' not in out:
+    fail('Parallel dump of hash database not refused')
+realm.run([kdb5_util, 'dump', '-binary', bindump])
+realm.run([kdb5_util, 'destroy', '-f'])
+realm.run([kdb5_util, 'load', bindump])
+dump_compare(realm, [], srcdump)
+
+# Load a dump with more principals than one load batch holds, with a
+# principal repeated on either side of the batch boundary, and check
+# that every principal is stored and the later duplicate wins.
+f = open(srcdump)
+lines = f.readlines()
+f.close()
+fields = [l for l in lines if '\tuser@KRBTEST.COM\t' in l][0].split('\t')
+def princ_line(name, maxlife):
+    fields[2] = str(len(name))
+    fields[6] = name
+    fields[8] = str(maxlife)
+    return '\t'.join(fields)
+bigdump = os.path.join(realm.testdir, 'dump.big')
+f = open(bigdump, 'w')
+f.writelines(lines)
+f.write(princ_line('dup@KRBTEST.COM', 3600))
+for i in range(16400):
+    f.write(princ_line('bulk%05d@KRBTEST.COM' % i, 86400))
+f.write(princ_line('dup@KRBTEST.COM', 7200))
+f.close()
+realm.run([kdb5_util, 'load', bigdump])
+out = realm.run([kadminl, 'getprincs', 'bulk*'])
+if len(out.splitlines()) != 16400 or 'bulk16399@' not in out:
+    fail('Missing principals after large load')
+out = realm.run([kadminl, 'getprinc', 'dup'])
+if 'Maximum ticket life: 0 days 02:00:00' not in out:
+    fail('Later duplicate principal did not replace earlier one')
+
+# Load into a database with a non-default page size and cache size, and
+# check that the loaded database uses the page size and dumps the same
+# when read through mapped pages.
+conf = {'dbmodules': {'db': {'page_size': '16384', 'cache_size': '1048576',
+                             'mmap_reads': 'true'}}}
+realm = K5Realm(start_kdc=False, kdc_conf=conf)
+realm.run([kdb5_util, 'load', srcdump])
+if os.path.getsize(os.path.join(realm.testdir, 'db')) % 16384 != 0:
+    fail('Loaded database does not use configured page size')
+dump_compare(realm, [], srcdump)
+
 success('Dump/load tests')
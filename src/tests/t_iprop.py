@@ -1,7 +1,10 @@
 #!/usr/bin/python
 
+import fcntl
 import os
 import re
+import struct
+import time
 
 from k5test import *
 
@@ -211,6 +214,29 @@ check_ulog(1, 6, 6, [None], slave1)
 # Make a change and check that it propagates incrementally.
 realm.run([kadminl, 'modprinc', '-allow_tix', pr2])
 check_ulog(7, 1, 7, [None, pr1, pr3, pr2, pr2, pr2, pr2])
+
+# kproplog refuses a log written with a different iprop_master_ulogsize
+# or in the previous format, and leaves the log alone.
+conf_ulogsize = {'realms': {'$realm': {'iprop_master_ulogsize': '500'}}}
+ulogsize_env = realm.special_env('ulogsize', True, kdc_conf=conf_ulogsize)
+out = realm.run([kproplog], env=ulogsize_env, expected_code=1)
+if 'not written with iprop_master_ulogsize 500' not in out:
+    fail('kproplog did not refuse log with a different size')
+oldulog = os.path.join(realm.testdir, 'db.ulog.old')
+ulogdata = open(ulog, 'rb').read()
+olddata = ulogdata[:4] + struct.pack('=H', 1) + ulogdata[6:]
+f = open(oldulog, 'wb')
+f.write(olddata)
+f.close()
+conf_oldulog = {'realms': {'$realm': {'iprop_logfile': oldulog}}}
+oldulog_env = realm.special_env('oldulog', True, kdc_conf=conf_oldulog)
+out = realm.run([kproplog], env=oldulog_env, expected_code=1)
+if 'Unsupported update log version 1' not in out:
+    fail('kproplog did not refuse log in the previous format')
+if open(oldulog, 'rb').read() != olddata:
+    fail('kproplog modified log in the previous format')
+check_ulog(7, 1, 7, [None, pr1, pr3, pr2, pr2, pr2, pr2])
+
 kpropd1.send_signal(signal.SIGUSR1)
 wait_for_prop(kpropd1, False, 6, 7)
 check_ulog(2, 6, 7, [None, pr2], slave1)
@@ -239,7 +265,9 @@ if pr1 not in out or pr2 not in out or pr3 not in out:
     fail('slave3 does not have all principals from slave1')
 check_ulog(1, 7, 7, [None], env=slave3)
 
-# Test an incremental propagation for the kpropd -r case.
+# Test an incremental propagation for the kpropd -r case.  kadmind
+# -proponly on slave1 notifies slave3 of the update once slave1 has
+# it, so only kpropd1 needs a signal.
 realm.run([kadminl, 'modprinc', '-maxlife', '20 minutes', pr1])
 check_ulog(8, 1, 8, [None, pr1, pr3, pr2, pr2, pr2, pr2, pr1])
 kpropd1.send_signal(signal.SIGUSR1)
@@ -248,7 +276,6 @@ check_ulog(3, 6, 8, [None, pr2, pr1], slave1)
 out = realm.run([kadminl, 'getprinc', pr1], env=slave1)
 if 'Maximum ticket life: 0 days 00:20:00' not in out:
     fail('slave1 does not have modification from master')
-kpropd3.send_signal(signal.SIGUSR1)
 wait_for_prop(kpropd3, False, 7, 8)
 check_ulog(2, 7, 8, [None, pr1], slave3)
 out = realm.run([kadminl, '-r', realm.realm, 'getprinc', pr1], env=slave3)
@@ -281,7 +308,8 @@ if pr1 not in out or pr2 not in out or pr3 not in out:
     fail('slave2 does not have all principals from slave1')
 
 # Make another change and check that it propagates incrementally to
-# both slaves.
+# both slaves.  Here and below, slave2 is notified of incremental
+# updates by kadmind -proponly on slave1.
 realm.run([kadminl, 'modprinc', '-maxrenewlife', '22 hours', pr1])
 check_ulog(9, 1, 9, [None, pr1, pr3, pr2, pr2, pr2, pr2, pr1, pr1])
 kpropd1.send_signal(signal.SIGUSR1)
@@ -290,7 +318,6 @@ check_ulog(4, 6, 9, [None, pr2, pr1, pr1], slave1)
 out = realm.run([kadminl, 'getprinc', pr1], env=slave1)
 if 'Maximum renewable life: 0 days 22:00:00\n' not in out:
     fail('slave1 does not have modification from master')
-kpropd2.send_signal(signal.SIGUSR1)
 wait_for_prop(kpropd2, False, 8, 9)
 check_ulog(3, 7, 9, [None, pr1, pr1], slave2)
 out = realm.run([kadminl, 'getprinc', pr1], env=slave2)
@@ -320,7 +347,6 @@ check_ulog(5, 6, 10, [None, pr2, pr1, pr1, pr2], slave1)
 out = realm.run([kadminl, 'getprinc', pr2], env=slave1)
 if 'Attributes:\n' not in out:
     fail('slave1 does not have modification from master')
-kpropd2.send_signal(signal.SIGUSR1)
 wait_for_prop(kpropd2, False, 9, 10)
 check_ulog(4, 7, 10, [None, pr1, pr1, pr2], slave2)
 out = realm.run([kadminl, 'getprinc', pr2], env=slave2)
@@ -384,7 +410,6 @@ check_ulog(2, 1, 2, [None, pr1], slave1)
 out = realm.run([kadminl, 'getprinc', pr1], env=slave1)
 if 'Maximum ticket life: 0 days 00:10:00' not in out:
     fail('slave1 does not have modification from master')
-kpropd2.send_signal(signal.SIGUSR1)
 wait_for_prop(kpropd2, False, 1, 2)
 check_ulog(2, 1, 2, [None, pr1], slave2)
 out = realm.run([kadminl, 'getprinc', pr1], env=slave2)
@@ -400,7 +425,6 @@ check_ulog(3, 1, 3, [None, pr1, pr3], slave1)
 out = realm.run([kadminl, 'getprinc', pr3], env=slave1, expected_code=1)
 if 'Principal does not exist' not in out:
     fail('slave1 does not have principal deletion from master')
-kpropd2.send_signal(signal.SIGUSR1)
 wait_for_prop(kpropd2, False, 2, 3)
 check_ulog(3, 1, 3, [None, pr1, pr3], slave2)
 out = realm.run([kadminl, 'getprinc', pr3], env=slave2, expected_code=1)
@@ -418,7 +442,6 @@ out = realm.run([kadminl, 'getprinc', pr1], env=slave1, expected_code=1)
 if 'Principal does not exist' not in out:
     fail('slave1 does not have principal deletion from master')
 realm.run([kadminl, 'getprinc', renpr], env=slave1)
-kpropd2.send_signal(signal.SIGUSR1)
 wait_for_prop(kpropd2, False, 3, 6)
 check_ulog(6, 1, 6, [None, pr1, pr3, renpr, pr1, renpr], slave2)
 out = realm.run([kadminl, 'getprinc', pr1], env=slave2, expected_code=1)
@@ -471,4 +494,66 @@ out = realm.run([kadminl, 'getpol', 'testpol'], env=slave1)
 if 'Minimum number of password character classes: 3' not in out:
     fail('slave1 does not have policy from master after kpropd -t')
 
+# Changes made through kadmind are announced to kpropd, which fetches
+# them without waiting for its poll interval or a signal.
+realm.addprinc(realm.admin_princ, password('admin'))
+realm.prep_kadmin()
+kpropd1 = realm.start_kpropd(slave1, ['-d'])
+wait_for_prop(kpropd1, False, 1, 2)
+realm.run_kadmin(['modprinc', '-maxlife', '10 minutes', pr1])
+wait_for_prop(kpropd1, False, 2, 3)
+check_ulog(3, 1, 3, [None, realm.admin_princ, pr1], slave1)
+out = realm.run([kadminl, 'getprinc', pr1], env=slave1)
+if 'Maximum ticket life: 0 days 00:10:00' not in out:
+    fail('slave1 was not notified of modification made through kadmind')
+
+# A conditional iprop dump reuses an existing dump which the ulog still
+# covers, and rewrites a dump whose header cannot be read.
+cdump = os.path.join(realm.testdir, 'dump.cond')
+realm.run([kdb5_util, 'dump', '-i', '-c', cdump])
+size = os.stat(cdump).st_size
+os.utime(cdump, (1000000000, 1000000000))
+realm.run([kdb5_util, 'dump', '-i', '-c', cdump])
+if os.stat(cdump).st_mtime != 1000000000:
+    fail('Conditional dump rewrote a current dump')
+for data in ('', open(cdump).read()[:10]):
+    f = open(cdump, 'w')
+    f.write(data)
+    f.close()
+    os.utime(cdump, (1000000000, 1000000000))
+    realm.run([kdb5_util, 'dump', '-i', '-c', cdump])
+    st = os.stat(cdump)
+    if st.st_mtime == 1000000000 or st.st_size != size:
+        fail('Conditional dump did not rewrite a damaged dump')
+
+# A conditional dump which finds another dump in progress waits for
+# the dump_ok lock, and then reuses the dump left behind instead of
+# writing it again.  Hold the lock while two conditional dumps start,
+# and stand in for the first dump by writing a current dump before
+# releasing it.
+f = open(cdump)
+gooddump = f.read()
+f.close()
+open(cdump, 'w').close()
+lockfile = open(cdump + '.dump_ok', 'w')
+fcntl.lockf(lockfile, fcntl.LOCK_EX)
+procs = [subprocess.Popen([kdb5_util, 'dump', '-i', '-c', cdump],
+                          env=realm.env, stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT) for i in range(2)]
+time.sleep(1)
+if any(p.poll() is not None for p in procs) or os.stat(cdump).st_size != 0:
+    fail('Conditional dump did not wait for the dump_ok lock')
+f = open(cdump, 'w')
+f.write(gooddump)
+f.close()
+os.utime(cdump, (1000000000, 1000000000))
+fcntl.lockf(lockfile, fcntl.LOCK_UN)
+lockfile.close()
+for p in procs:
+    p.communicate()
+    if p.returncode != 0:
+        fail('Conditional dump failed after waiting for the dump_ok lock')
+if os.stat(cdump).st_mtime != 1000000000:
+    fail('Conditional dump rewrote the dump it waited for')
+
 success('iprop tests')
@@ -40,6 +40,7 @@ admin = make_client('user/admin')
 none = make_client('none')
 restrictions = make_client('restrictions')
 onetwothreefour = make_client('one/two/three/four')
+ordered = make_client('ordered/two')
 
 realm.run([kadminl, 'addpol', '-minlife', '1 day', 'minlife'])
 
@@ -71,6 +72,8 @@ one/*/*/five       l
 */two/*/*          d   *3/*1/*2
 */admin            a
 wctarget           a   wild/*
+ordered/*          i
+ordered/two        a
 restrictions       a   type1     -policy minlife
 restrictions       a   type2     -clearpolicy
 restrictions       a   type3     -maxlife 1h -maxrenewlife 2h
@@ -291,6 +294,13 @@ out = kadmin_as(wctarget, ['addprinc', '-pw', 'pw', 'wild/card/extra'],
                 expected_code=1)
 if 'Operation requires' not in out:
     fail('addprinc failure (target wildcard extra component)')
+# Only the first matching line applies, even when a later line names
+# the client exactly.
+kadmin_as(ordered, ['getprinc', 'none'])
+out = kadmin_as(ordered, ['addprinc', '-nokey', 'orderedtarget'],
+                expected_code=1)
+if 'Operation requires ``add\'\' privilege' not in out:
+    fail('addprinc failure (earlier wildcard line)')
 realm.addprinc('admin/user', 'pw')
 kadmin_as(admin, ['delprinc', 'admin/user'])
 out = kadmin_as(admin, ['delprinc', 'none'], expected_code=1)
@@ -358,4 +368,32 @@ kadmin_as(all_extract, ['ktadd', '-norandkey', 'extractkeys'])
 realm.kinit('extractkeys', flags=['-k'])
 os.remove(realm.keytab)
 
+# Check that read-only requests processed by worker threads are subject
+# to the same ACL checks, and see writes made by the main thread.
+realm.stop_kadmind()
+realm.start_kadmind(args=['-w', '2'])
+kadmin_as(all_add, ['addprinc', '-nokey', 'workerprinc'])
+out = kadmin_as(all_inquire, ['getprinc', 'workerprinc'])
+if 'Principal: workerprinc@KRBTEST.COM' not in out:
+    fail('getprinc success (worker)')
+out = kadmin_as(some_inquire, ['getprinc', 'workerprinc'], expected_code=1)
+if 'Operation requires ``get\'\' privilege' not in out:
+    fail('getprinc failure (worker)')
+out = kadmin_as(all_list, ['listprincs'])
+if 'workerprinc@KRBTEST.COM' not in out:
+    fail('listprincs success (worker)')
+out = kadmin_as(none, ['listprincs'], expected_code=1)
+if 'Operation requires ``list\'\' privilege' not in out:
+    fail('listprincs failure (worker)')
+kadmin_as(all_modify, ['setstr', 'workerprinc', 'key', 'value'])
+out = kadmin_as(all_inquire, ['getstrs', 'workerprinc'])
+if 'key: value' not in out:
+    fail('getstrs success (worker)')
+out = kadmin_as(all_inquire, ['getpol', 'minlife'])
+if 'Policy: minlife' not in out:
+    fail('getpol success (worker)')
+out = kadmin_as(none, ['getpol', 'minlife'], expected_code=1)
+if 'Operation requires ``get\'\' privilege' not in out:
+    fail('getpol failure (worker)')
+
 success('kadmin ACL enforcement')
@@ -32,4 +32,26 @@ output = realm.run([kadminl, 'modprinc', '-allow_tix', p])
 if 'Cannot lock database' in output:
     fail('krb5kdc still holds a lock on the principal db')
 
+realm.stop()
+
+# With snapshot reads, principal lookups should succeed while another
+# process holds the database lock, and should see changes once they are
+# published.
+import fcntl
+conf = {'dbmodules': {'db': {'snapshot_reads': 'true',
+                             'disable_last_success': 'true',
+                             'disable_lockout': 'true'}}}
+realm = K5Realm(create_user=False, kdc_conf=conf)
+realm.addprinc(p, p)
+lockfile = open(os.path.join(realm.testdir, 'db.ok'), 'r+')
+fcntl.lockf(lockfile, fcntl.LOCK_EX)
+realm.kinit(p, p)
+fcntl.lockf(lockfile, fcntl.LOCK_UN)
+lockfile.close()
+realm.run([kadminl, 'cpw', '-pw', 'bar', p])
+realm.kinit(p, 'bar')
+realm.kinit(p, p, expected_code=1)
+if os.path.exists(os.path.join(realm.testdir, 'db.new')):
+    fail('snapshot working copy left behind')
+
 success('KDB locking tests')
@@ -1,5 +1,7 @@
 #!/usr/bin/python
 from k5test import *
+import binascii
+import hashlib
 
 conf_slave = {'dbmodules': {'db': {'database_name': '$testdir/db.slave'}}}
 
@@ -94,4 +96,86 @@ out = realm.run([kadminl, 'listprincs'], slave3)
 if 'wakawaka' not in out:
     fail('Slave does not have all principals from master')
 
+# kprop identifies a dump to kpropd by its size and a digest of its
+# contents: the SHA-256 hash of the hashes of each 1MB block.
+def dump_digest(data):
+    digest = '\0' * 32
+    for i in range(0, len(data), 1024 * 1024):
+        block = hashlib.sha256(data[i:i + 1024 * 1024]).digest()
+        digest = hashlib.sha256(digest + block).digest()
+    return binascii.hexlify(digest)
+
+# Leave the first half of a new dump in kpropd's temporary file, as an
+# interrupted transfer would, and check that kprop resumes after it.
+realm.addprinc('resumed')
+realm.run([kdb5_util, 'dump', dumpfile])
+incoming = os.path.join(realm.testdir, 'incoming-slave-datatrans')
+data = open(dumpfile).read()
+f = open(incoming + '.temp', 'w')
+f.write(data[:len(data) // 2])
+f.close()
+f = open(incoming + '.temp.resume', 'w')
+f.write('%d %s\n' % (len(data), dump_digest(data)))
+f.close()
+out = realm.run([kprop, '-d', '-f', dumpfile, '-P', str(realm.kprop_port()),
+                 hostname])
+if 'Resuming at offset %d.' % (len(data) // 2) not in out:
+    fail('kprop did not resume interrupted transfer')
+check_output(kpropd)
+out = realm.run([kadminl, 'listprincs'], slave3)
+if 'resumed' not in out:
+    fail('Slave does not have all principals from master after resume')
+if os.path.exists(incoming + '.temp.resume'):
+    fail('kpropd did not remove resume record after transfer')
+
+# Leave the first half of the dump with a damaged byte in the temporary
+# file, as a crash before the data reached the disk might, and check that
+# kpropd detects the damage after resuming and discards the file.
+realm.run([kadminl, 'modprinc', '-maxlife', '1 hour', 'resumed'])
+realm.run([kdb5_util, 'dump', dumpfile])
+data = open(dumpfile).read()
+half = len(data) // 2
+f = open(incoming + '.temp', 'w')
+f.write(data[:half - 1] + chr(ord(data[half - 1]) ^ 1))
+f.close()
+f = open(incoming + '.temp.resume', 'w')
+f.write('%d %s\n' % (len(data), dump_digest(data)))
+f.close()
+out = realm.run([kprop, '-d', '-f', dumpfile, '-P', str(realm.kprop_port()),
+                 hostname], expected_code=1)
+if 'does not match its digest' not in out:
+    fail('kpropd did not reject a damaged resumed transfer')
+if (os.path.exists(incoming + '.temp') or
+    os.path.exists(incoming + '.temp.resume')):
+    fail('kpropd did not discard a damaged resumed transfer')
+out = realm.run([kprop, '-d', '-f', dumpfile, '-P', str(realm.kprop_port()),
+                 hostname])
+if 'Resuming' in out:
+    fail('kprop resumed after a damaged transfer')
+check_output(kpropd)
+out = realm.run([kadminl, 'getprinc', 'resumed'], slave3)
+if 'Maximum ticket life: 0 days 01:00:00' not in out:
+    fail('Slave does not match master after damaged transfer')
+
+# Leave part of a different dump of the same size in the temporary file,
+# and check that kprop starts over instead of splicing the two dumps.
+realm.run([kadminl, 'renprinc', '-force', 'resumed', 'spliced'])
+realm.run([kdb5_util, 'dump', dumpfile])
+data = open(dumpfile).read()
+olddata = data.replace('spliced', 'resumed')
+f = open(incoming + '.temp', 'w')
+f.write(olddata[:len(olddata) // 2])
+f.close()
+f = open(incoming + '.temp.resume', 'w')
+f.write('%d %s\n' % (len(olddata), dump_digest(olddata)))
+f.close()
+out = realm.run([kprop, '-d', '-f', dumpfile, '-P', str(realm.kprop_port()),
+                 hostname])
+if 'Resuming' in out:
+    fail('kprop resumed a transfer of a different dump')
+check_output(kpropd)
+out = realm.run([kadminl, 'listprincs'], slave3)
+if 'spliced' not in out or 'resumed@' in out:
+    fail('Slave does not match master after restarted transfer')
+
 success('kprop tests')
@@ -42,6 +42,23 @@ out = realm.run([kadminl, 'addprinc', '-pw', 'birdsoranges', 'p6'],
 if 'Password may not be a pair of dictionary words' not in out:
     fail('Expected error not seen from combo module')
 
+# Compiled dictionaries are checked the same way, with or without a
+# bloom filter, ignoring case.  The last word has no trailing newline.
+wordfile = os.path.join(os.getcwd(), 'testdir', 'words')
+f = open(wordfile, 'w')
+f.write('birds\nbees\napples\nBananas')
+f.close()
+for i, args in enumerate([[], ['-b', '10'], ['-b', '10', '-n']]):
+    realm.run([kdb5_util, 'compile_dict'] + args + [wordfile])
+    for pw in ('bees', 'bananas'):
+        out = realm.run([kadminl, 'addprinc', '-pw', pw, '-policy', 'pol',
+                         'p7'], expected_code=1)
+        if 'Password is in the password dictionary' not in out:
+            fail('Expected error not seen from compiled dictionary')
+    realm.run([kadminl, 'addprinc', '-pw', 'oranges', '-policy', 'pol',
+               'p7_%d' % i])
+realm.run([kdb5_util, 'compile_dict', '-n', wordfile], expected_code=1)
+
 # These plugin ordering tests aren't specifically related to the
 # password quality interface, but are convenient to put here.
 
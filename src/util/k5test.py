@@ -937,7 +937,7 @@ class K5Realm(object):
         stop_daemon(self._kdc_proc)
         self._kdc_proc = None
 
-    def start_kadmind(self, env=None):
+    def start_kadmind(self, env=None, args=[]):
         global krb5kdc
         if env is None:
             env = self.env
@@ -945,7 +945,7 @@ class K5Realm(object):
         dump_path = os.path.join(self.testdir, 'dump')
         self._kadmind_proc = _start_daemon([kadmind, '-nofork', '-W',
                                             '-p', kdb5_util, '-K', kprop,
-                                            '-F', dump_path], env,
+                                            '-F', dump_path] + args, env,
                                            'starting...')
 
     def stop_kadmind(self):
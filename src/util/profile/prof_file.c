@@ -301,6 +301,39 @@ errcode_t profile_open_file(const_profile_filespec_t filespec,
     return 0;
 }
 
+/*
+ * Create a new file handle referring to the same data as old.  Only
+ * unmodified shared data can be referenced; data private to old (because it
+ * was modified through old's profile) is reread from the file instead, so
+ * that changes through either handle do not affect the other.
+ */
+errcode_t profile_copy_file(prf_file_t old, prf_file_t *ret_prof)
+{
+    prf_file_t      prf;
+    prf_data_t      data = old->data;
+
+    k5_mutex_lock(&g_shared_trees_mutex);
+    if (!(data->flags & PROFILE_FILE_SHARED) ||
+        (data->flags & PROFILE_FILE_DIRTY)) {
+        k5_mutex_unlock(&g_shared_trees_mutex);
+        return profile_open_file(data->filespec, ret_prof, NULL);
+    }
+    data->refcount++;
+    k5_mutex_unlock(&g_shared_trees_mutex);
+
+    prf = malloc(sizeof(struct _prf_file_t));
+    if (!prf) {
+        profile_dereference_data(data);
+        return ENOMEM;
+    }
+    memset(prf, 0, sizeof(struct _prf_file_t));
+    prf->magic = PROF_MAGIC_FILE;
+    prf->data = data;
+
+    *ret_prof = prf;
+    return 0;
+}
+
 errcode_t profile_update_file_data_locked(prf_data_t data, char **ret_modspec)
 {
     errcode_t retval;
@@ -220,33 +220,13 @@ get_value_vt(profile_t profile, const char *const *names, char **ret_value)
 errcode_t profile_get_value(profile_t profile, const char **names,
                             char **ret_value)
 {
-    errcode_t               retval;
-    void                    *state;
-    char                    *value;
-
     *ret_value = NULL;
     if (!profile)
         return PROF_NO_PROFILE;
     if (profile->vt)
         return get_value_vt(profile, names, ret_value);
 
-    retval = profile_iterator_create(profile, names,
-                                     PROFILE_ITER_RELATIONS_ONLY, &state);
-    if (retval)
-        return retval;
-
-    retval = profile_iterator(&state, NULL, &value);
-    if (retval)
-        goto cleanup;
-
-    if (value)
-        *ret_value = value;
-    else
-        retval = PROF_NO_RELATION;
-
-cleanup:
-    profile_iterator_free(&state);
-    return retval;
+    return profile_node_get_value(profile, names, ret_value);
 }
 
 errcode_t KRB5_CALLCONV
@@ -279,40 +279,43 @@ copy_vtable_profile(profile_t profile, profile_t *ret_new_profile)
     return 0;
 }
 
-#define COUNT_LINKED_LIST(COUNT, PTYPE, START, FIELD)   \
-    {                                                   \
-        size_t cll_counter = 0;                         \
-        PTYPE cll_ptr = (START);                        \
-        while (cll_ptr != NULL) {                       \
-            cll_counter++;                              \
-            cll_ptr = cll_ptr->FIELD;                   \
-        }                                               \
-        (COUNT) = cll_counter;                          \
-    }
-
 errcode_t KRB5_CALLCONV
 profile_copy(profile_t old_profile, profile_t *new_profile)
 {
-    size_t size, i;
-    const_profile_filespec_t *files;
-    prf_file_t file;
+    profile_t profile;
+    prf_file_t file, new_file, last = NULL;
     errcode_t err;
 
+    *new_profile = NULL;
     if (old_profile->vt)
         return copy_vtable_profile(old_profile, new_profile);
 
-    /* The fields we care about are read-only after creation, so
-       no locking is needed.  */
-    COUNT_LINKED_LIST (size, prf_file_t, old_profile->first_file, next);
-    files = malloc ((size+1) * sizeof(*files));
-    if (files == NULL)
+    profile = malloc(sizeof(struct _profile_t));
+    if (!profile)
         return ENOMEM;
-    for (i = 0, file = old_profile->first_file; i < size; i++, file = file->next)
-        files[i] = file->data->filespec;
-    files[size] = NULL;
-    err = profile_init (files, new_profile);
-    free (files);
-    return err;
+    memset(profile, 0, sizeof(struct _profile_t));
+    profile->magic = PROF_MAGIC_PROFILE;
+
+    /*
+     * Share the file data of old_profile instead of reopening the files.
+     * The file list is read-only after creation, so no locking is needed to
+     * walk it.  The data is refreshed from the files as it is used.
+     */
+    for (file = old_profile->first_file; file; file = file->next) {
+        err = profile_copy_file(file, &new_file);
+        if (err) {
+            profile_abandon(profile);
+            return err;
+        }
+        if (last)
+            last->next = new_file;
+        else
+            profile->first_file = new_file;
+        last = new_file;
+    }
+
+    *new_profile = profile;
+    return 0;
 }
 
 errcode_t KRB5_CALLCONV
@@ -200,6 +200,10 @@ errcode_t profile_node_iterator
 	(void	**iter_p, struct profile_node **ret_node,
 		   char **ret_name, char **ret_value);
 
+errcode_t profile_node_get_value
+	(profile_t profile, const char *const *names,
+		   char **ret_value);
+
 errcode_t profile_remove_node
 	(struct profile_node *node);
 
@@ -217,6 +221,9 @@ errcode_t profile_open_file
 	(const_profile_filespec_t file, prf_file_t *ret_prof,
 	 char **ret_modspec);
 
+errcode_t profile_copy_file
+	(prf_file_t old, prf_file_t *ret_prof);
+
 #define profile_update_file(P, M) profile_update_file_data((P)->data, M)
 errcode_t profile_update_file_data
 	(prf_data_t profile, char **ret_modspec);
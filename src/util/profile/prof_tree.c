@@ -15,6 +15,11 @@
  * A relation has as its value a pointer to allocated memory
  * containing a string.  Its first_child pointer must be null.
  *
+ * The children of a section are kept sorted by name, so children with
+ * the same name are adjacent.  Sections with many children also carry a
+ * hash index mapping each child name to the first child with that name,
+ * so that lookups do not have to walk the whole child list.
+ *
  */
 
 
@@ -28,6 +33,13 @@
 #include <errno.h>
 #include <ctype.h>
 
+/* Open-addressed hash table of the first child node with each name. */
+struct node_index {
+    size_t size;                    /* number of slots, a power of two */
+    size_t count;                   /* number of occupied slots */
+    struct profile_node **slots;
+};
+
 struct profile_node {
     errcode_t       magic;
     char *name;
@@ -38,12 +50,156 @@ struct profile_node {
     struct profile_node *first_child;
     struct profile_node *parent;
     struct profile_node *next, *prev;
+    unsigned int num_children;
+    struct node_index *index;       /* Index of children, or NULL */
 };
 
 #define CHECK_MAGIC(node)                       \
     if ((node)->magic != PROF_MAGIC_NODE)       \
         return PROF_MAGIC_NODE;
 
+/* Index sections once they have at least this many children. */
+#define INDEX_MIN_CHILDREN 8
+
+static unsigned int
+hash_name(const char *name)
+{
+    const unsigned char *p;
+    unsigned int h = 2166136261U;
+
+    for (p = (const unsigned char *)name; *p != '\0'; p++)
+        h = (h ^ *p) * 16777619U;
+    return h;
+}
+
+/* Return the slot for name in idx, which is either empty or holds the first
+ * child with that name. */
+static struct profile_node **
+index_slot(struct node_index *idx, const char *name)
+{
+    size_t i = hash_name(name) & (idx->size - 1);
+
+    while (idx->slots[i] != NULL && strcmp(idx->slots[i]->name, name) != 0)
+        i = (i + 1) & (idx->size - 1);
+    return &idx->slots[i];
+}
+
+static void
+free_index(struct node_index *idx)
+{
+    if (idx == NULL)
+        return;
+    free(idx->slots);
+    free(idx);
+}
+
+/* Resize idx to have newsize slots. */
+static errcode_t
+resize_index(struct node_index *idx, size_t newsize)
+{
+    struct profile_node **oldslots = idx->slots;
+    size_t i, oldsize = idx->size;
+
+    idx->slots = calloc(newsize, sizeof(*idx->slots));
+    if (idx->slots == NULL) {
+        idx->slots = oldslots;
+        return ENOMEM;
+    }
+    idx->size = newsize;
+    for (i = 0; i < oldsize; i++) {
+        if (oldslots[i] != NULL)
+            *index_slot(idx, oldslots[i]->name) = oldslots[i];
+    }
+    free(oldslots);
+    return 0;
+}
+
+/* Record node in idx if it is the first child with its name. */
+static errcode_t
+index_add(struct node_index *idx, struct profile_node *node)
+{
+    struct profile_node **slot;
+    errcode_t retval;
+
+    /* Keep the table at most half full. */
+    if ((idx->count + 1) * 2 > idx->size) {
+        retval = resize_index(idx, idx->size * 2);
+        if (retval)
+            return retval;
+    }
+    slot = index_slot(idx, node->name);
+    if (*slot == NULL) {
+        *slot = node;
+        idx->count++;
+    }
+    return 0;
+}
+
+/* (Re)build the child index of section.  If memory runs out, leave section
+ * without an index; lookups fall back to walking the child list. */
+static void
+build_index(struct profile_node *section)
+{
+    struct node_index *idx;
+    struct profile_node *p;
+
+    free_index(section->index);
+    section->index = NULL;
+
+    idx = malloc(sizeof(*idx));
+    if (idx == NULL)
+        return;
+    idx->size = 16;
+    idx->count = 0;
+    idx->slots = calloc(idx->size, sizeof(*idx->slots));
+    if (idx->slots == NULL) {
+        free(idx);
+        return;
+    }
+    for (p = section->first_child; p != NULL; p = p->next) {
+        if (index_add(idx, p) != 0) {
+            free_index(idx);
+            return;
+        }
+    }
+    section->index = idx;
+}
+
+/* Return the first child of section named name, or NULL if there is none. */
+static struct profile_node *
+find_first_child(struct profile_node *section, const char *name)
+{
+    struct profile_node *p;
+    int cmp;
+
+    if (section->index != NULL)
+        return *index_slot(section->index, name);
+
+    for (p = section->first_child; p != NULL; p = p->next) {
+        cmp = strcmp(p->name, name);
+        if (cmp == 0)
+            return p;
+        if (cmp > 0)
+            break;
+    }
+    return NULL;
+}
+
+/* Return the first undeleted subsection of section named name, or NULL. */
+static struct profile_node *
+find_subsection(struct profile_node *section, const char *name)
+{
+    struct profile_node *p;
+
+    for (p = find_first_child(section, name); p != NULL; p = p->next) {
+        if (strcmp(p->name, name) != 0)
+            break;
+        if (!p->value && !p->deleted)
+            return p;
+    }
+    return NULL;
+}
+
 /*
  * Free a node, and any children
  */
@@ -63,6 +219,7 @@ void profile_free_node(struct profile_node *node)
         next = child->next;
         profile_free_node(child);
     }
+    free_index(node->index);
     node->magic = 0;
 
     free(node);
@@ -183,6 +340,15 @@ errcode_t profile_add_node(struct profile_node *section, const char *name,
         last->next = new;
     else
         section->first_child = new;
+    section->num_children++;
+    if (section->index != NULL) {
+        if (index_add(section->index, new) != 0) {
+            free_index(section->index);
+            section->index = NULL;
+        }
+    } else if (section->num_children >= INDEX_MIN_CHILDREN) {
+        build_index(section);
+    }
     if (ret_node)
         *ret_node = new;
     return 0;
@@ -251,12 +417,17 @@ errcode_t profile_find_node(struct profile_node *section, const char *name,
     p = *state;
     if (p) {
         CHECK_MAGIC(p);
-    } else
+    } else if (name)
+        p = find_first_child(section, name);
+    else
         p = section->first_child;
 
     for (; p; p = p->next) {
-        if (name && (strcmp(p->name, name)))
-            continue;
+        /* Children with the same name are adjacent. */
+        if (name && (strcmp(p->name, name))) {
+            p = 0;
+            break;
+        }
         if (section_flag) {
             if (p->value)
                 continue;
@@ -283,8 +454,10 @@ errcode_t profile_find_node(struct profile_node *section, const char *name,
      * there's guaranteed to be another match that's returned.
      */
     for (p = p->next; p; p = p->next) {
-        if (name && (strcmp(p->name, name)))
-            continue;
+        if (name && (strcmp(p->name, name))) {
+            p = 0;
+            break;
+        }
         if (section_flag) {
             if (p->value)
                 continue;
@@ -520,10 +693,7 @@ get_new_file:
         section = iter->file->data->root;
         assert(section != NULL);
         for (cpp = iter->names; cpp[iter->done_idx]; cpp++) {
-            for (p=section->first_child; p; p = p->next) {
-                if (!strcmp(p->name, *cpp) && !p->value && !p->deleted)
-                    break;
-            }
+            p = find_subsection(section, *cpp);
             if (!p) {
                 section = 0;
                 break;
@@ -541,15 +711,21 @@ get_new_file:
             goto get_new_file;
         }
         iter->name = *cpp;
-        iter->node = section->first_child;
+        if (iter->name)
+            iter->node = find_first_child(section, iter->name);
+        else
+            iter->node = section->first_child;
     }
     /*
      * OK, now we know iter->node is set up correctly.  Let's do
      * the search.
      */
     for (p = iter->node; p; p = p->next) {
-        if (iter->name && strcmp(p->name, iter->name))
-            continue;
+        /* Children with the same name are adjacent. */
+        if (iter->name && strcmp(p->name, iter->name)) {
+            p = 0;
+            break;
+        }
         if ((iter->flags & PROFILE_ITER_SECTIONS_ONLY) &&
             p->value)
             continue;
@@ -586,6 +762,69 @@ get_new_file:
     return 0;
 }
 
+/*
+ * Return a copy of the first relation value matching names, searching the
+ * files of profile in the same way as the node iterator.  This is cheaper than
+ * creating an iterator for callers which only want one value, and copies the
+ * value while the file data is locked.
+ */
+errcode_t profile_node_get_value(profile_t profile, const char *const *names,
+                                 char **ret_value)
+{
+    prf_file_t              file;
+    prf_data_t              data;
+    struct profile_node     *section, *p;
+    const char              *const *cpp;
+    errcode_t               retval;
+    int                     final_seen = 0;
+
+    *ret_value = NULL;
+    if (profile == 0)
+        return PROF_NO_PROFILE;
+    if (profile->magic != PROF_MAGIC_PROFILE)
+        return PROF_MAGIC_PROFILE;
+    if (!names || !names[0])
+        return PROF_BAD_NAMESET;
+
+    for (file = profile->first_file; file && !final_seen; file = file->next) {
+        if (file->magic != PROF_MAGIC_FILE)
+            return PROF_MAGIC_FILE;
+        data = file->data;
+        if (data->magic != PROF_MAGIC_FILE_DATA)
+            return PROF_MAGIC_FILE_DATA;
+
+        k5_mutex_lock(&data->lock);
+        retval = profile_update_file_data_locked(data, NULL);
+        if (retval) {
+            k5_mutex_unlock(&data->lock);
+            if (retval == ENOENT || retval == EACCES)
+                continue;
+            return retval;
+        }
+
+        section = data->root;
+        assert(section != NULL);
+        for (cpp = names; section && cpp[1]; cpp++) {
+            section = find_subsection(section, *cpp);
+            if (section && section->final)
+                final_seen = 1;
+        }
+        if (section) {
+            for (p = find_first_child(section, *cpp); p; p = p->next) {
+                if (strcmp(p->name, *cpp))
+                    break;
+                if (!p->value || p->deleted)
+                    continue;
+                *ret_value = strdup(p->value);
+                k5_mutex_unlock(&data->lock);
+                return (*ret_value == NULL) ? ENOMEM : 0;
+            }
+        }
+        k5_mutex_unlock(&data->lock);
+    }
+    return PROF_NO_RELATION;
+}
+
 /*
  * Remove a particular node.
  *
@@ -689,5 +928,7 @@ errcode_t profile_rename_node(struct profile_node *node, const char *new_name)
 
     free(node->name);
     node->name = new_string;
+    if (node->parent->index != NULL)
+        build_index(node->parent);
     return 0;
 }
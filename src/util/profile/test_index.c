@@ -0,0 +1,146 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* util/profile/test_index.c - Test lookups in indexed profile sections */
+/*
+ * Copyright (C) 2017 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This test program creates a profile with sections large enough to be
+ * indexed, and checks that lookups give the same results as a walk of the
+ * child list would, before and after the tree is modified.
+ */
+
+#include "k5-platform.h"
+#include "profile.h"
+#include "prof_int.h"
+
+#define NKEYS 40
+
+static const char *filename = "./testidx.ini";
+
+static void
+check_string(profile_t p, const char *name, const char *subname,
+             const char *subsubname, const char *expected)
+{
+    char *val;
+
+    assert(profile_get_string(p, name, subname, subsubname, NULL,
+                              &val) == 0);
+    if (expected == NULL) {
+        assert(val == NULL);
+    } else {
+        assert(val != NULL && strcmp(val, expected) == 0);
+        profile_release_string(val);
+    }
+}
+
+int
+main()
+{
+    profile_t p, p2;
+    const char *files[] = { NULL, NULL };
+    const char *dup_names[] = { "sec", "dup", NULL };
+    const char *sub_names[] = { "sec", "sub", NULL };
+    const char *new_names[] = { "sec", "new", NULL };
+    char **values, key[16], val[16];
+    FILE *fp;
+    int i;
+
+    /* Write a profile with a large section containing a repeated relation
+     * and a subsection. */
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "[sec]\n");
+    for (i = NKEYS - 1; i >= 0; i--)
+        fprintf(fp, "\tk%02d = v%02d\n", i, i);
+    fprintf(fp, "\tdup = 1\n\tsub = {\n\t\tx = y\n\t}\n\tdup = 2\n");
+    fprintf(fp, "\tdup = 3\n[other]\n\tk00 = other\n");
+    fclose(fp);
+
+    files[0] = filename;
+    assert(profile_init(files, &p) == 0);
+
+    for (i = 0; i < NKEYS; i++) {
+        snprintf(key, sizeof(key), "k%02d", i);
+        snprintf(val, sizeof(val), "v%02d", i);
+        check_string(p, "sec", key, NULL, val);
+    }
+    check_string(p, "other", "k00", NULL, "other");
+    check_string(p, "sec", "missing", NULL, NULL);
+    check_string(p, "sec", "sub", "x", "y");
+
+    assert(profile_get_values(p, dup_names, &values) == 0);
+    assert(strcmp(values[0], "1") == 0 && strcmp(values[1], "2") == 0 &&
+           strcmp(values[2], "3") == 0 && values[3] == NULL);
+    profile_free_list(values);
+
+    /* A copy shares the parsed file data with the original. */
+    assert(profile_copy(p, &p2) == 0);
+    check_string(p2, "sec", "k05", NULL, "v05");
+    check_string(p2, "sec", "sub", "x", "y");
+
+    /* Modifying the copy gives it private data and leaves the original
+     * alone. */
+    assert(profile_add_relation(p2, new_names, "copy") == 0);
+    check_string(p2, "sec", "new", NULL, "copy");
+    check_string(p, "sec", "new", NULL, NULL);
+    profile_abandon(p2);
+
+    /* Modify the tree and check that lookups see the changes. */
+    assert(profile_rename_section(p, sub_names, "a-sub") == 0);
+    check_string(p, "sec", "sub", "x", NULL);
+    check_string(p, "sec", "a-sub", "x", "y");
+    assert(profile_add_relation(p, new_names, "added") == 0);
+    check_string(p, "sec", "new", NULL, "added");
+    assert(profile_clear_relation(p, dup_names) == 0);
+    check_string(p, "sec", "dup", NULL, NULL);
+    for (i = 0; i < NKEYS; i++) {
+        snprintf(key, sizeof(key), "k%02d", i);
+        snprintf(val, sizeof(val), "v%02d", i);
+        check_string(p, "sec", key, NULL, val);
+    }
+
+    /* A copy of the modified profile has its own tree; changes made through
+     * either profile do not show up in the other. */
+    assert(profile_copy(p, &p2) == 0);
+    check_string(p2, "sec", "k05", NULL, "v05");
+    assert(profile_add_relation(p2, new_names, "copy") == 0);
+    assert(profile_get_values(p, new_names, &values) == 0);
+    assert(strcmp(values[0], "added") == 0 && values[1] == NULL);
+    profile_free_list(values);
+    assert(profile_clear_relation(p, new_names) == 0);
+    assert(profile_get_values(p2, new_names, &values) == 0);
+    assert(values[0] != NULL);
+    profile_free_list(values);
+    profile_abandon(p2);
+
+    profile_abandon(p);
+    (void)unlink(filename);
+    return 0;
+}